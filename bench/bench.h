@@ -0,0 +1,246 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "../lib_cmd/cmd.h"
+
+/// @brief run time options, set from the command line.
+struct bench_config_t {
+
+    /// @brief number of root commands in synthetic trees.
+    uint32_t roots_;
+
+    /// @brief number of children of each synthetic command.
+    uint32_t width_;
+
+    /// @brief number of levels in synthetic trees.
+    uint32_t depth_;
+
+    /// @brief number of timed samples per case.
+    uint32_t samples_;
+
+    /// @brief minimum duration of one sample in nanoseconds.
+    uint64_t sample_ns_;
+
+    /// @brief only run benches whose name contains this string.
+    const char* filter_;
+
+    bench_config_t()
+        : roots_(20)
+        , width_(22)
+        , depth_(3)
+        , samples_(51)
+        , sample_ns_(200000)
+        , filter_(nullptr)
+    {
+    }
+};
+
+struct bench_store_t {
+
+    static std::vector<struct bench_base_t*> benches;
+
+    static bench_config_t config;
+
+    static void add_bench(struct bench_base_t* bench)
+    {
+        benches.push_back(bench);
+    }
+};
+
+/// @brief monotonic nanosecond timer.
+struct bench_timer_t {
+
+    typedef std::chrono::steady_clock clock_t;
+
+    bench_timer_t()
+        : start_(clock_t::now())
+    {
+    }
+
+    uint64_t elapsed_ns() const
+    {
+        const auto diff = clock_t::now() - start_;
+        return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(diff).count());
+    }
+
+protected:
+    clock_t::time_point start_;
+};
+
+/// @brief bench base class.
+///
+/// each case is timed as a number of samples, where a sample repeats the
+/// case enough times to be measurable.  results are written to stdout as
+/// one json object per line so that runs can be compared by script.
+struct bench_base_t {
+
+    const char* name;
+
+    bench_base_t(const char* n)
+        : name(n)
+    {
+    }
+
+    virtual void run() = 0;
+
+    /// @brief time a case and report its per operation latency.
+    ///
+    /// @param label name of the case within this bench.
+    /// @param func callable performing some work, returning the number of
+    ///             operations it performed.
+    /// @param count number of samples to take, zero for the configured count.
+    template <typename func_t>
+    void measure(const std::string& label, func_t func, uint32_t count = 0)
+    {
+        const bench_config_t& config = bench_store_t::config;
+        count = count ? count : config.samples_;
+        // grow the batch size until a batch takes long enough to time
+        uint64_t batch = 1;
+        for (;; batch *= 2) {
+            bench_timer_t timer;
+            for (uint64_t i = 0; i < batch; ++i) {
+                func();
+            }
+            if (timer.elapsed_ns() >= config.sample_ns_ || batch >= (1ull << 30)) {
+                break;
+            }
+        }
+        std::vector<double> samples;
+        uint64_t total_ops = 0, total_ns = 0;
+        for (uint32_t s = 0; s < count; ++s) {
+            uint64_t ops = 0;
+            bench_timer_t timer;
+            for (uint64_t i = 0; i < batch; ++i) {
+                ops += func();
+            }
+            const uint64_t ns = timer.elapsed_ns();
+            samples.push_back(double(ns) / double(ops ? ops : 1));
+            total_ops += ops;
+            total_ns += ns;
+        }
+        report(label, samples, total_ops, total_ns);
+    }
+
+protected:
+    static double percentile(const std::vector<double>& sorted, double p)
+    {
+        const size_t index = size_t(p * double(sorted.size() - 1) + 0.5);
+        return sorted[std::min(index, sorted.size() - 1)];
+    }
+
+    void report(const std::string& label, std::vector<double>& samples, uint64_t ops, uint64_t ns)
+    {
+        std::sort(samples.begin(), samples.end());
+        const double mean = double(ns) / double(ops ? ops : 1);
+        printf("{\"bench\":\"%s\",\"case\":\"%s\",\"samples\":%u,\"ops\":%llu,"
+               "\"mean_ns\":%.2f,\"min_ns\":%.2f,\"p50_ns\":%.2f,\"p90_ns\":%.2f,"
+               "\"p99_ns\":%.2f,\"max_ns\":%.2f,\"ops_per_sec\":%.0f}\n",
+            name, label.c_str(), uint32_t(samples.size()), (unsigned long long)ops,
+            mean, samples.front(), percentile(samples, 0.5), percentile(samples, 0.9),
+            percentile(samples, 0.99), samples.back(), mean > 0.0 ? 1e9 / mean : 0.0);
+        fflush(stdout);
+    }
+};
+
+/// @brief deterministic pseudo random numbers for repeatable inputs.
+struct bench_random_t {
+
+    bench_random_t(uint64_t seed = 0x1234)
+        : state_(seed)
+    {
+    }
+
+    uint32_t next()
+    {
+        state_ = state_ * 6364136223846793005ull + 1442695040888963407ull;
+        return uint32_t(state_ >> 33);
+    }
+
+    uint32_t range(uint32_t lo, uint32_t hi)
+    {
+        return lo + next() % (hi - lo + 1);
+    }
+
+    std::string word(uint32_t min_len, uint32_t max_len)
+    {
+        std::string out;
+        const uint32_t len = range(min_len, max_len);
+        for (uint32_t i = 0; i < len; ++i) {
+            out.push_back(char('a' + next() % 26));
+        }
+        return out;
+    }
+
+protected:
+    uint64_t state_;
+};
+
+/// @brief command whose name is passed in as the user baton.
+struct bench_cmd_t : public cmd_t {
+
+    bench_cmd_t(cmd_parser_t& cli, cmd_t* parent, cmd_baton_t user)
+        : cmd_t((const char*)user, cli, parent, user)
+    {
+    }
+
+    virtual bool on_execute(cmd_tokens_t& tok, cmd_output_t& out, cmd_baton_t user) override
+    {
+        (void)tok, (void)out, (void)user;
+        return true;
+    }
+};
+
+/// @brief synthetic command tree of a given width and depth.
+struct bench_tree_t {
+
+    /// @brief owned command names, deque so pointers remain stable.
+    std::deque<std::string> names_;
+
+    /// @brief full command paths to every leaf.
+    std::vector<std::string> paths_;
+
+    /// @brief number of commands created.
+    size_t nodes_;
+
+    bench_tree_t()
+        : nodes_(0)
+    {
+    }
+
+    void build(cmd_parser_t& parser, uint32_t roots, uint32_t width, uint32_t depth)
+    {
+        bench_random_t rand;
+        for (uint32_t i = 0; i < roots; ++i) {
+            cmd_t* cmd = parser.add_command<bench_cmd_t>(unique_name(rand, i));
+            ++nodes_;
+            build(cmd, rand, width, depth - 1, cmd->name_);
+        }
+    }
+
+protected:
+    cmd_baton_t unique_name(bench_random_t& rand, uint32_t index)
+    {
+        names_.push_back(rand.word(3, 10) + std::to_string(index));
+        return (cmd_baton_t)names_.back().c_str();
+    }
+
+    void build(cmd_t* parent, bench_random_t& rand, uint32_t width, uint32_t depth, const std::string& path)
+    {
+        if (depth == 0) {
+            paths_.push_back(path);
+            return;
+        }
+        for (uint32_t i = 0; i < width; ++i) {
+            cmd_t* cmd = parent->add_sub_command<bench_cmd_t>(unique_name(rand, i));
+            ++nodes_;
+            build(cmd, rand, width, depth - 1, path + " " + cmd->name_);
+        }
+    }
+};
@@ -0,0 +1,62 @@
+#include "bench.h"
+
+namespace {
+
+struct bench_t : public bench_base_t {
+
+    bench_t()
+        : bench_base_t("alias")
+    {
+    }
+
+    virtual void run() override
+    {
+        const bench_config_t& config = bench_store_t::config;
+        cmd_parser_t parser;
+        bench_tree_t tree;
+        tree.build(parser, config.roots_, config.width_, config.depth_);
+        std::unique_ptr<cmd_output_t> out(cmd_output_t::create_output_dummy());
+
+        // alias a sample of the leaf commands
+        bench_random_t rand;
+        std::vector<std::string> names;
+        for (size_t i = 0; i < tree.paths_.size() && i < 1024; ++i) {
+            names.push_back("al_" + rand.word(3, 8) + std::to_string(i));
+        }
+        for (size_t i = 0; i < names.size(); ++i) {
+            cmd_tokens_t tokens(nullptr);
+            tokens.tokenize(tree.paths_[i].c_str());
+            cmd_t* cmd = nullptr;
+            const cmd_index_t* index = &parser.index_;
+            for (const cmd_token_t& token : tokens.tokens.raw_) {
+                cmd = index->find_exact(token.get());
+                index = &cmd->index_;
+            }
+            parser.alias_add(cmd, names[i]);
+        }
+        const std::string shape = std::to_string(names.size()) + " aliases";
+
+        size_t index = 0;
+        measure("find " + shape, [&]() {
+            parser.alias_find(names[index]);
+            index = (index + 1) % names.size();
+            return 1;
+        });
+        for (int frozen = 0; frozen < 2; ++frozen) {
+            if (frozen) {
+                parser.freeze();
+            }
+            measure(std::string(frozen ? "execute frozen " : "execute tree ") + shape, [&]() {
+                parser.execute(names[index], out.get(), nullptr);
+                index = (index + 1) % names.size();
+                return 1;
+            });
+        }
+    }
+};
+} // namespace {}
+
+bench_base_t* init_bench_alias()
+{
+    return new bench_t();
+}
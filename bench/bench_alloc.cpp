@@ -0,0 +1,70 @@
+#include "bench.h"
+
+// count allocations for the whole bench binary, this costs one thread
+// local increment per allocation
+#define CMD_ALLOC_COUNT
+#include "../lib_cmd/cmd_alloc.h"
+
+namespace {
+
+struct bench_t : public bench_base_t {
+
+    bench_t()
+        : bench_base_t("alloc")
+    {
+    }
+
+    // heap allocations per execute once the session is warmed up
+    void measure_allocs(const std::string& label, cmd_parser_t& parser, const std::vector<std::string>& exprs, cmd_output_t* out)
+    {
+        const uint32_t rounds = 100;
+        // fill the history ring and the session pool
+        for (uint32_t i = 0; i < 2; ++i) {
+            for (const std::string& expr : exprs) {
+                parser.execute(expr, out, nullptr);
+            }
+        }
+        cmd_alloc_t::scope_t scope;
+        for (uint32_t i = 0; i < rounds; ++i) {
+            for (const std::string& expr : exprs) {
+                parser.execute(expr, out, nullptr);
+            }
+        }
+        const uint64_t ops = uint64_t(rounds) * exprs.size();
+        printf("{\"bench\":\"%s\",\"case\":\"%s\",\"ops\":%llu,\"allocs\":%llu,\"allocs_per_op\":%.3f}\n",
+            name, label.c_str(), (unsigned long long)ops, (unsigned long long)scope.allocs(),
+            double(scope.allocs()) / double(ops));
+        fflush(stdout);
+    }
+
+    virtual void run() override
+    {
+        const bench_config_t& config = bench_store_t::config;
+        cmd_parser_t parser;
+        bench_tree_t tree;
+        tree.build(parser, config.roots_, config.width_, config.depth_);
+        parser.idents_.set("x", 1234);
+        parser.session_.set_history_limit(64);
+        std::unique_ptr<cmd_output_t> out(cmd_output_t::create_output_dummy());
+
+        std::vector<std::string> args, idents, pairs;
+        for (size_t i = 0; i < tree.paths_.size() && i < 256; ++i) {
+            args.push_back(tree.paths_[i] + " arg0 arg1 1234");
+            idents.push_back(tree.paths_[i] + " $x $x");
+            pairs.push_back(tree.paths_[i] + " -flag -key value;" + tree.paths_[i]);
+        }
+        for (int frozen = 0; frozen < 2; ++frozen) {
+            const std::string prefix = frozen ? "frozen " : "tree ";
+            measure_allocs(prefix + "args", parser, args, out.get());
+            measure_allocs(prefix + "idents", parser, idents, out.get());
+            measure_allocs(prefix + "flags and pairs", parser, pairs, out.get());
+            parser.freeze();
+        }
+    }
+};
+} // namespace {}
+
+bench_base_t* init_bench_alloc()
+{
+    return new bench_t();
+}
@@ -0,0 +1,93 @@
+#include "bench.h"
+
+#include <thread>
+
+namespace {
+
+struct bench_t : public bench_base_t {
+
+    bench_t()
+        : bench_base_t("dispatch")
+    {
+    }
+
+    // execute every leaf path in turn
+    void measure_paths(const std::string& label, cmd_parser_t& parser, const std::vector<std::string>& paths, cmd_output_t* out)
+    {
+        size_t index = 0;
+        measure(label, [&]() {
+            parser.execute(paths[index], out, nullptr);
+            index = (index + 1) % paths.size();
+            return 1;
+        });
+    }
+
+    // several threads each executing in their own session of one parser,
+    // reported per command across all threads
+    void measure_sessions(const std::string& label, cmd_parser_t& parser, const std::vector<std::string>& paths, uint32_t threads)
+    {
+        const uint32_t count = 20000;
+        std::vector<std::unique_ptr<cmd_session_t>> sessions;
+        std::vector<std::unique_ptr<cmd_output_t>> outs;
+        for (uint32_t t = 0; t < threads; ++t) {
+            sessions.emplace_back(new cmd_session_t(parser));
+            outs.emplace_back(cmd_output_t::create_output_dummy());
+        }
+        measure(label, [&]() {
+            std::vector<std::thread> workers;
+            for (uint32_t t = 0; t < threads; ++t) {
+                workers.emplace_back([&, t]() {
+                    cmd_session_t& session = *sessions[t];
+                    for (uint32_t i = 0; i < count; ++i) {
+                        session.execute(paths[(i + t) % paths.size()], outs[t].get(), nullptr);
+                    }
+                });
+            }
+            for (auto& worker : workers) {
+                worker.join();
+            }
+            return uint64_t(count) * threads;
+        });
+    }
+
+    virtual void run() override
+    {
+        const bench_config_t& config = bench_store_t::config;
+        cmd_parser_t parser;
+        bench_tree_t tree;
+        tree.build(parser, config.roots_, config.width_, config.depth_);
+        std::unique_ptr<cmd_output_t> out(cmd_output_t::create_output_dummy());
+
+        const std::string shape = "nodes " + std::to_string(tree.nodes_);
+        measure_paths("tree " + shape, parser, tree.paths_, out.get());
+        parser.freeze();
+        measure_paths("frozen " + shape, parser, tree.paths_, out.get());
+
+        // leaf commands receiving trailing arguments
+        std::vector<std::string> args;
+        for (const std::string& path : tree.paths_) {
+            args.push_back(path + " arg0 -flag key=value 1234");
+        }
+        measure_paths("frozen with args " + shape, parser, args, out.get());
+
+        // one shared tree executed from several sessions at once
+        for (uint32_t threads : { 1, 2, 4, 8 }) {
+            measure_sessions("frozen sessions " + std::to_string(threads) + " threads " + shape, parser, tree.paths_, threads);
+        }
+
+        // a typo at the root forces the suggestion path
+        std::vector<std::string> typos;
+        for (size_t i = 0; i < tree.paths_.size() && i < 64; ++i) {
+            std::string typo = tree.paths_[i];
+            typo[0] = '_';
+            typos.push_back(typo);
+        }
+        measure_paths("invalid " + shape, parser, typos, out.get());
+    }
+};
+} // namespace {}
+
+bench_base_t* init_bench_dispatch()
+{
+    return new bench_t();
+}
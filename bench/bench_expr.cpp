@@ -0,0 +1,64 @@
+#include "bench.h"
+
+#include "../lib_cmd/cmd_expr.h"
+
+namespace {
+
+struct bench_t : public bench_base_t {
+
+    bench_t()
+        : bench_base_t("expr")
+    {
+    }
+
+    virtual void run() override
+    {
+        cmd_parser_t parser;
+        parser.add_command<cmd_expr_t>();
+        parser.freeze();
+        std::unique_ptr<cmd_output_t> out(cmd_output_t::create_output_dummy());
+        parser.execute("expr set x 7", out.get(), nullptr);
+
+        // expressions of increasing size mixing values and identifiers
+        static const char ops[] = { '+', '-', '*', '&', '|' };
+        bench_random_t rand;
+        for (uint32_t terms : { 1u, 4u, 16u, 64u, 256u }) {
+            std::string line = "expr eval ";
+            for (uint32_t i = 0; i < terms; ++i) {
+                if (i) {
+                    line.append(1, ops[rand.next() % sizeof(ops)]);
+                }
+                line.append(rand.next() % 4 ? std::to_string(rand.range(1, 100)) : "x");
+            }
+            measure(std::to_string(terms) + " terms", [&]() {
+                parser.execute(line, out.get(), nullptr);
+                return 1;
+            });
+        }
+
+        // listing a large identifier table as text and as records
+        const uint32_t idents = 500000;
+        for (uint32_t i = 0; i < idents; ++i) {
+            parser.idents_.set("ident_" + std::to_string(i), rand.next());
+        }
+        std::unique_ptr<cmd_output_buffer_t> buffer(cmd_output_t::create_output_buffer());
+        const cmd_output_t::record_format_t formats[] = {
+            cmd_output_t::e_text, cmd_output_t::e_jsonl, cmd_output_t::e_binary
+        };
+        const char* names[] = { "list text", "list jsonl", "list binary" };
+        for (size_t i = 0; i < 3; ++i) {
+            buffer->set_record_format(formats[i]);
+            measure(names[i], [&]() {
+                buffer->reset();
+                parser.execute("expr list", buffer.get(), nullptr);
+                return idents;
+            }, 5);
+        }
+    }
+};
+} // namespace {}
+
+bench_base_t* init_bench_expr()
+{
+    return new bench_t();
+}
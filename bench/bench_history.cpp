@@ -0,0 +1,75 @@
+#include "bench.h"
+
+#include "../lib_cmd/cmd_history.h"
+
+namespace {
+
+struct bench_t : public bench_base_t {
+
+    bench_t()
+        : bench_base_t("history")
+    {
+    }
+
+    // searches a 300k line history for its ten most recent matches
+    virtual void run() override
+    {
+        const uint32_t count = 300000;
+        bench_random_t rand;
+        std::vector<std::string> words;
+        for (uint32_t i = 0; i < 2000; ++i) {
+            words.push_back(rand.word(3, 10));
+        }
+        cmd_history_list_t list(std::pmr::get_default_resource(), count, 64 << 20);
+        for (uint32_t i = 0; i < count; ++i) {
+            list.push("expr set " + words[rand.next() % words.size()] + " " + std::to_string(i));
+        }
+
+        measure("index 300k lines", [&]() {
+            cmd_history_index_t index;
+            index.update(list);
+            return size_t(count);
+        }, 3);
+
+        cmd_history_index_t index;
+        std::vector<uint64_t> found;
+        size_t which = 0;
+        // the way a search is done without the index, checking each line
+        measure("scan " + std::to_string(count) + " lines", [&]() {
+            const std::string& sub = words[which++ % words.size()];
+            found.clear();
+            for (uint64_t num = list.next_number(); num-- > list.first_number() && found.size() < 10;) {
+                if (list[size_t(num - list.first_number())].find(sub) != std::string_view::npos) {
+                    found.push_back(num);
+                }
+            }
+            return 1;
+        });
+        measure("search word", [&]() {
+            index.search(list, words[which++ % words.size()], ~0ull, 10, found);
+            return 1;
+        });
+        measure("search rare", [&]() {
+            index.search(list, " " + std::to_string(which++ % count), ~0ull, 10, found);
+            return 1;
+        });
+        measure("search missing", [&]() {
+            index.search(list, "qqqqq", ~0ull, 10, found);
+            return 1;
+        });
+
+        // lines keep arriving, dropping the oldest, between searches
+        uint32_t next = count;
+        measure("push and search", [&]() {
+            list.push("expr set " + words[rand.next() % words.size()] + " " + std::to_string(next++));
+            index.search(list, words[which++ % words.size()], ~0ull, 10, found);
+            return 1;
+        });
+    }
+};
+} // namespace {}
+
+bench_base_t* init_bench_history()
+{
+    return new bench_t();
+}
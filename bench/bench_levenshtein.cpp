@@ -0,0 +1,86 @@
+#include "bench.h"
+
+namespace {
+
+// the original full matrix implementation, kept as the baseline
+uint32_t levenshtein_dp(const char* s1, const char* s2)
+{
+#define MIN3(a, b, c) ((a) < (b) ? ((a) < (c) ? (a) : (c)) : ((b) < (c) ? (b) : (c)))
+    uint32_t x, y, lastdiag, olddiag;
+    const size_t s1len = strlen(s1);
+    const size_t s2len = strlen(s2);
+    std::vector<uint32_t> column(s1len + 1);
+    for (y = 1; y <= s1len; y++) {
+        column[y] = y;
+    }
+    for (x = 1; x <= s2len; x++) {
+        column[0] = x;
+        for (y = 1, lastdiag = x - 1; y <= s1len; y++) {
+            olddiag = column[y];
+            column[y] = MIN3(column[y] + 1,
+                column[y - 1] + 1,
+                lastdiag + (s1[y - 1] == s2[x - 1] ? 0 : 1));
+            lastdiag = olddiag;
+        }
+    }
+    return column[s1len];
+#undef MIN3
+}
+
+struct bench_t : public bench_base_t {
+
+    bench_t()
+        : bench_base_t("levenshtein")
+    {
+    }
+
+    // time a suggestion pass of one typo over a sibling set
+    template <typename func_t>
+    void measure_names(const std::string& label, const std::vector<std::string>& names, const std::string& typo, func_t func)
+    {
+        uint32_t hits = 0;
+        measure(label, [&]() {
+            for (const std::string& name : names) {
+                hits += func(name.c_str(), typo.c_str()) < 3 ? 1 : 0;
+            }
+            return names.size();
+        });
+        // keep the results alive
+        if (hits == 1) {
+            printf("\n");
+        }
+    }
+
+    void run_case(uint32_t count, uint32_t min_len, uint32_t max_len)
+    {
+        bench_random_t rand;
+        std::vector<std::string> names;
+        for (uint32_t i = 0; i < count; ++i) {
+            names.push_back(rand.word(min_len, max_len));
+        }
+        // a typo of an existing name
+        std::string typo = names[count / 2];
+        typo[typo.size() / 2] = '_';
+
+        const std::string shape = std::to_string(count) + " names length "
+            + std::to_string(min_len) + "-" + std::to_string(max_len);
+        measure_names("dp " + shape, names, typo, levenshtein_dp);
+        measure_names("bit parallel " + shape, names, typo,
+            [](const char* a, const char* b) { return cmd_util_t::levenshtein(a, b); });
+        measure_names("bounded " + shape, names, typo,
+            [](const char* a, const char* b) { return cmd_util_t::levenshtein(a, b, 2); });
+    }
+
+    virtual void run() override
+    {
+        run_case(1000, 4, 12);
+        run_case(1000, 30, 60);
+        run_case(100, 100, 200);
+    }
+};
+} // namespace {}
+
+bench_base_t* init_bench_levenshtein()
+{
+    return new bench_t();
+}
@@ -0,0 +1,91 @@
+#include "bench.h"
+
+#include <cstdlib>
+
+std::vector<bench_base_t*> bench_store_t::benches;
+bench_config_t bench_store_t::config;
+
+#define BENCH(NAME) { \
+        bench_base_t* NAME(void); \
+        bench_store_t::add_bench(NAME()); \
+    }
+
+void init() {
+    BENCH(init_bench_tokenize);
+    BENCH(init_bench_dispatch);
+    BENCH(init_bench_strtoll);
+    BENCH(init_bench_levenshtein);
+    BENCH(init_bench_alias);
+    BENCH(init_bench_expr);
+    BENCH(init_bench_output);
+    BENCH(init_bench_alloc);
+    BENCH(init_bench_history);
+#if defined(__linux__)
+    BENCH(init_bench_store);
+#endif
+}
+
+void usage()
+{
+    fprintf(stderr,
+        "usage: bench_cmd [options]\n"
+        "  --roots N      root commands in synthetic trees\n"
+        "  --width N      children per synthetic command\n"
+        "  --depth N      levels in synthetic trees\n"
+        "  --samples N    timed samples per case\n"
+        "  --sample-us N  minimum duration of a sample\n"
+        "  --filter NAME  only run benches containing NAME\n");
+}
+
+bool parse(int argc, char** args, bench_config_t& config)
+{
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = args[i];
+        if (strcmp(arg, "--filter") == 0 && i + 1 < argc) {
+            config.filter_ = args[++i];
+            continue;
+        }
+        if (i + 1 >= argc) {
+            return false;
+        }
+        const uint32_t value = uint32_t(strtoul(args[++i], nullptr, 10));
+        if (value == 0) {
+            return false;
+        }
+        if (strcmp(arg, "--roots") == 0) {
+            config.roots_ = value;
+        } else if (strcmp(arg, "--width") == 0) {
+            config.width_ = value;
+        } else if (strcmp(arg, "--depth") == 0) {
+            config.depth_ = value;
+        } else if (strcmp(arg, "--samples") == 0) {
+            config.samples_ = value;
+        } else if (strcmp(arg, "--sample-us") == 0) {
+            config.sample_ns_ = uint64_t(value) * 1000;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** args)
+{
+    bench_config_t& config = bench_store_t::config;
+    if (!parse(argc, args, config)) {
+        return usage(), 1;
+    }
+    init();
+
+    printf("{\"bench\":\"config\",\"roots\":%u,\"width\":%u,\"depth\":%u,"
+           "\"samples\":%u,\"sample_ns\":%llu,\"cmd_stats\":%d}\n",
+        config.roots_, config.width_, config.depth_, config.samples_,
+        (unsigned long long)config.sample_ns_, CMD_STATS);
+    for (bench_base_t* bench : bench_store_t::benches) {
+        if (config.filter_ && !strstr(bench->name, config.filter_)) {
+            continue;
+        }
+        bench->run();
+    }
+    return 0;
+}
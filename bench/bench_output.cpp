@@ -0,0 +1,149 @@
+#include "bench.h"
+
+namespace {
+
+// the original unbuffered stdio output, kept as the baseline
+struct output_unbuffered_t : public cmd_output_t {
+
+    output_unbuffered_t(FILE* fd)
+        : fd_(fd)
+    {
+    }
+
+    virtual void lock() override
+    {
+    }
+
+    virtual void unlock() override
+    {
+    }
+
+    virtual void print(bool ind, const char* fmt, va_list& args) override
+    {
+        ind ? indent_apply() : (void)0;
+        vfprintf(fd_, fmt, args);
+    }
+
+    virtual void println(bool ind, const char* fmt, va_list& args) override
+    {
+        ind ? indent_apply() : (void)0;
+        vfprintf(fd_, fmt, args);
+        eol();
+    }
+
+    virtual void eol() override
+    {
+        fputc('\n', fd_);
+    }
+
+    virtual void flush() override
+    {
+        fflush(fd_);
+    }
+
+protected:
+    FILE* fd_;
+
+    void indent_apply()
+    {
+        for (uint32_t i = 0; i < indent_; ++i) {
+            fputc(' ', fd_);
+        }
+    }
+};
+
+struct bench_t : public bench_base_t {
+
+    bench_t()
+        : bench_base_t("output")
+    {
+    }
+
+    // a 1M line listing in the style of 'expr list' or 'help tree'
+    void measure_listing(const std::string& label, cmd_output_t& out, const char* fmt)
+    {
+        const uint32_t lines = 1000000;
+        measure(label, [&]() {
+            auto indent = out.indent(2);
+            for (uint32_t i = 0; i < lines; ++i) {
+                out.println(fmt, "identifier_name", i);
+            }
+            out.flush();
+            return lines;
+        }, 5);
+    }
+
+    // a 1M line numeric listing in the style of 'expr list', either printf
+    // formatted or using the typed line() formatting
+    void measure_numeric(const std::string& label, cmd_output_t& out, bool typed)
+    {
+        const uint32_t lines = 1000000;
+        measure(label, [&]() {
+            auto indent = out.indent(2);
+            uint64_t value = 0x9e3779b97f4a7c15ull;
+            for (uint32_t i = 0; i < lines; ++i) {
+                value = value * 6364136223846793005ull + 1442695040888963407ull;
+                if (typed) {
+                    out.line(cmd_format_t::pad("ident", 8), " ", cmd_format_t::hex(value));
+                } else {
+                    out.println("%8s 0x%llx", "ident", (unsigned long long)value);
+                }
+            }
+            out.flush();
+            return lines;
+        }, 5);
+    }
+
+    virtual void run() override
+    {
+        // line buffering is what a terminal gets, one write per line
+        for (int mode : { _IOLBF, _IOFBF }) {
+            FILE* fd = fopen("/dev/null", "w");
+            if (!fd) {
+                return;
+            }
+            setvbuf(fd, nullptr, mode, BUFSIZ);
+            const std::string stream = (mode == _IOLBF) ? "line buffered" : "fully buffered";
+            output_unbuffered_t unbuffered(fd);
+            std::unique_ptr<cmd_output_t> out(cmd_output_t::create_output_stdio(fd));
+            measure_listing("unbuffered format " + stream, unbuffered, "%s %d");
+            measure_listing("buffered format " + stream, *out, "%s %d");
+            measure_listing("unbuffered string " + stream, unbuffered, "%s");
+            measure_listing("buffered string " + stream, *out, "%s");
+            measure_numeric("unbuffered numeric printf " + stream, unbuffered, false);
+            measure_numeric("buffered numeric printf " + stream, *out, false);
+            measure_numeric("buffered numeric typed " + stream, *out, true);
+            out.reset();
+            fclose(fd);
+        }
+        // capture into memory, reset between listings
+        std::unique_ptr<cmd_output_buffer_t> buffer(cmd_output_t::create_output_buffer());
+        measure("capture format", [&]() {
+            const uint32_t lines = 1000000;
+            buffer->reset();
+            for (uint32_t i = 0; i < lines; ++i) {
+                buffer->println("%s %d", "identifier_name", i);
+            }
+            return lines;
+        }, 5);
+        buffer->reset();
+        measure_numeric("capture numeric printf", *buffer, false);
+        buffer->reset();
+        measure_numeric("capture numeric typed", *buffer, true);
+        // producer side cost of the asynchronous output
+        FILE* fd = fopen("/dev/null", "w");
+        if (fd) {
+            std::unique_ptr<cmd_output_t> out(cmd_output_t::create_output_async(fd, 4096));
+            measure_listing("async format", *out, "%s %d");
+            measure_listing("async string", *out, "%s");
+            out.reset();
+            fclose(fd);
+        }
+    }
+};
+} // namespace {}
+
+bench_base_t* init_bench_output()
+{
+    return new bench_t();
+}
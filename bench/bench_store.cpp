@@ -0,0 +1,83 @@
+#include "bench.h"
+
+#include "../lib_cmd/cmd_expr.h"
+#include "../lib_cmd/cmd_store.h"
+
+#if defined(__linux__)
+
+#include <unistd.h>
+
+namespace {
+
+struct bench_t : public bench_base_t {
+
+    bench_t()
+        : bench_base_t("store")
+    {
+    }
+
+    // restores 1M identifiers into a fresh parser by each method
+    virtual void run() override
+    {
+        const uint32_t count = 1000000;
+        const std::string snapshot = "/tmp/cmd_bench_" + std::to_string(getpid()) + ".snapshot";
+        const std::string journal = "/tmp/cmd_bench_" + std::to_string(getpid()) + ".journal";
+        unlink(snapshot.c_str());
+        unlink(journal.c_str());
+
+        std::vector<std::string> lines;
+        for (uint32_t i = 0; i < count; ++i) {
+            lines.push_back("expr set ident" + std::to_string(i) + " " + std::to_string(i));
+        }
+        std::unique_ptr<cmd_output_t> out(cmd_output_t::create_output_dummy());
+        {
+            cmd_parser_t parser;
+            parser.add_command<cmd_expr_t>();
+            cmd_store_t store(parser.session_);
+            store.open(journal.c_str());
+            for (const std::string& line : lines) {
+                parser.execute(line, out.get(), nullptr);
+            }
+            store.sync();
+            store.close();
+            store.open(snapshot.c_str());
+        }
+
+        // the way state was restored before, replaying commands
+        measure("replay 1M idents", [&]() {
+            cmd_parser_t parser;
+            parser.add_command<cmd_expr_t>();
+            for (const std::string& line : lines) {
+                parser.execute(line, out.get(), nullptr);
+            }
+            return size_t(count);
+        }, 3);
+
+        measure("open 1M idents journal", [&]() {
+            cmd_parser_t parser;
+            parser.add_command<cmd_expr_t>();
+            cmd_store_t store(parser.session_);
+            store.open(journal.c_str());
+            return parser.idents_.size();
+        }, 3);
+
+        measure("open 1M idents snapshot", [&]() {
+            cmd_parser_t parser;
+            parser.add_command<cmd_expr_t>();
+            cmd_store_t store(parser.session_);
+            store.open(snapshot.c_str());
+            return parser.idents_.size();
+        }, 5);
+
+        unlink(snapshot.c_str());
+        unlink(journal.c_str());
+    }
+};
+} // namespace {}
+
+bench_base_t* init_bench_store()
+{
+    return new bench_t();
+}
+
+#endif // defined(__linux__)
@@ -0,0 +1,53 @@
+#include "bench.h"
+
+namespace {
+
+struct bench_t : public bench_base_t {
+
+    bench_t()
+        : bench_base_t("strtoll")
+    {
+    }
+
+    void measure_set(const std::string& label, const std::vector<std::string>& inputs)
+    {
+        uint64_t sink = 0;
+        measure(label, [&]() {
+            for (const std::string& in : inputs) {
+                uint64_t value = 0;
+                bool neg = false;
+                cmd_util_t::strtoll(in.c_str(), value, neg);
+                sink += value;
+            }
+            return inputs.size();
+        });
+        // keep the results alive
+        if (sink == 1) {
+            printf("\n");
+        }
+    }
+
+    virtual void run() override
+    {
+        bench_random_t rand;
+        std::vector<std::string> small, large, hex, neg;
+        for (uint32_t i = 0; i < 256; ++i) {
+            small.push_back(std::to_string(rand.range(0, 999)));
+            large.push_back(std::to_string((uint64_t(rand.next()) << 32) | rand.next()));
+            char buffer[32];
+            snprintf(buffer, sizeof(buffer), "0x%x", rand.next());
+            hex.push_back(buffer);
+            neg.push_back("-" + std::to_string(rand.next()));
+        }
+        measure_set("decimal small", small);
+        measure_set("decimal large", large);
+        measure_set("hex", hex);
+        measure_set("negative", neg);
+    }
+};
+} // namespace {}
+
+bench_base_t* init_bench_strtoll()
+{
+    return new bench_t();
+}
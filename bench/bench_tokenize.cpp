@@ -0,0 +1,48 @@
+#include "bench.h"
+
+namespace {
+
+struct bench_t : public bench_base_t {
+
+    bench_t()
+        : bench_base_t("tokenize")
+    {
+    }
+
+    void measure_line(const std::string& label, const std::string& line, cmd_idents_t* idents)
+    {
+        measure(label, [&]() {
+            cmd_tokens_t tokens(idents);
+            tokens.tokenize(line.c_str());
+            return 1;
+        });
+    }
+
+    virtual void run() override
+    {
+        cmd_idents_t idents;
+        idents.set("x", 1234);
+        idents.set("value", 0xffff);
+
+        measure_line("short", "echo hello", nullptr);
+        measure_line("flags and pairs", "echo -v -n key=value other=12 a b c", nullptr);
+        measure_line("idents", "echo $x $value $x $value", &idents);
+
+        // lines of increasing token count
+        bench_random_t rand;
+        for (uint32_t count : { 8u, 32u, 128u }) {
+            std::string line;
+            for (uint32_t i = 0; i < count; ++i) {
+                line.append(i ? " " : "");
+                line.append(rand.word(2, 10));
+            }
+            measure_line(std::to_string(count) + " tokens", line, nullptr);
+        }
+    }
+};
+} // namespace {}
+
+bench_base_t* init_bench_tokenize()
+{
+    return new bench_t();
+}
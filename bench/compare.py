@@ -0,0 +1,50 @@
+#!/usr/bin/env python
+# compare two bench_cmd result files
+#
+# usage: compare.py before.jsonl after.jsonl [threshold percent]
+#
+# prints the change in median latency for every case present in both files
+# and exits with 1 if any case slowed down by more than the threshold.
+import json
+import sys
+
+
+def load(path):
+    results = {}
+    with open(path) as fd:
+        for line in fd:
+            line = line.strip()
+            if not line.startswith('{'):
+                continue
+            record = json.loads(line)
+            # allocation counts are not timed so are not compared
+            if 'case' in record and 'p50_ns' in record:
+                results[(record['bench'], record['case'])] = record
+    return results
+
+
+def main():
+    if len(sys.argv) < 3:
+        print('usage: compare.py before.jsonl after.jsonl [threshold]')
+        return 2
+    before = load(sys.argv[1])
+    after = load(sys.argv[2])
+    threshold = float(sys.argv[3]) if len(sys.argv) > 3 else 10.0
+    worse = 0
+    for key in sorted(before.keys()):
+        if key not in after:
+            continue
+        old = before[key]['p50_ns']
+        new = after[key]['p50_ns']
+        change = (new - old) * 100.0 / old if old else 0.0
+        flag = ''
+        if change > threshold:
+            flag = '  <-- regression'
+            worse += 1
+        print('%-12s %-44s %12.1f %12.1f %+8.1f%%%s' % (
+            key[0], key[1], old, new, change, flag))
+    return 1 if worse else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
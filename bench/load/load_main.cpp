@@ -0,0 +1,332 @@
+#include "../bench.h"
+
+#include "../../lib_cmd/cmd_expr.h"
+#include "../../lib_cmd/cmd_server.h"
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstdlib>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+/// @brief run time options, set from the command line.
+struct load_config_t {
+
+    /// @brief number of simulated clients.
+    uint32_t clients_;
+
+    /// @brief number of server event loop threads.
+    uint32_t threads_;
+
+    /// @brief commands each client keeps in flight.
+    uint32_t pipeline_;
+
+    /// @brief duration of the timed run in milliseconds.
+    uint32_t duration_ms_;
+
+    /// @brief connect over loopback tcp rather than a unix socket.
+    bool tcp_;
+
+    load_config_t()
+        : clients_(1000)
+        , threads_(2)
+        , pipeline_(1)
+        , duration_ms_(3000)
+        , tcp_(false)
+    {
+    }
+};
+
+// sent by the server after every command, never part of command output
+const char prompt = '\x1e';
+
+/// @brief one simulated client connection.
+struct client_t {
+
+    int fd_;
+    /// @brief send times of the commands in flight, oldest first.
+    std::deque<uint64_t> sent_;
+    /// @brief index of the next command to send.
+    uint32_t next_;
+    /// @brief the prompt sent on connection has been received.
+    bool ready_;
+};
+
+struct load_t {
+
+    load_t(const load_config_t& config)
+        : config_(config)
+        , epoll_(-1)
+        , completed_(0)
+    {
+    }
+
+    ~load_t()
+    {
+        for (client_t& client : clients_) {
+            (client.fd_ >= 0) ? (void)close(client.fd_) : (void)0;
+        }
+        (epoll_ >= 0) ? (void)close(epoll_) : (void)0;
+    }
+
+    bool connect_all(const std::string& path, uint16_t port)
+    {
+        epoll_ = epoll_create1(EPOLL_CLOEXEC);
+        if (epoll_ < 0) {
+            return false;
+        }
+        clients_.resize(config_.clients_);
+        for (uint32_t i = 0; i < config_.clients_; ++i) {
+            client_t& client = clients_[i];
+            client.fd_ = config_.tcp_ ? connect_tcp(port) : connect_unix(path);
+            client.next_ = i;
+            client.ready_ = false;
+            if (client.fd_ < 0) {
+                return false;
+            }
+            epoll_event ev;
+            ev.events = EPOLLIN;
+            ev.data.ptr = &client;
+            if (epoll_ctl(epoll_, EPOLL_CTL_ADD, client.fd_, &ev) != 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// @brief drive every client until the duration has elapsed.
+    bool run(const std::vector<std::string>& commands)
+    {
+        commands_ = &commands;
+        const uint64_t end_ns = config_.duration_ms_ * 1000000ull;
+        std::vector<epoll_event> events(256);
+        char temp[4096];
+        while (timer_.elapsed_ns() < end_ns) {
+            const int count = epoll_wait(epoll_, events.data(), int(events.size()), 100);
+            if (count < 0 && errno != EINTR) {
+                return false;
+            }
+            for (int i = 0; i < count; ++i) {
+                client_t& client = *static_cast<client_t*>(events[i].data.ptr);
+                const ssize_t got = read(client.fd_, temp, sizeof(temp));
+                if (got <= 0) {
+                    if (got < 0 && (errno == EAGAIN || errno == EINTR)) {
+                        continue;
+                    }
+                    return false;
+                }
+                const uint64_t now = timer_.elapsed_ns();
+                for (ssize_t j = 0; j < got; ++j) {
+                    if (temp[j] != prompt) {
+                        continue;
+                    }
+                    if (!client.ready_) {
+                        client.ready_ = true;
+                    } else if (!client.sent_.empty()) {
+                        latency_.push_back(double(now - client.sent_.front()));
+                        client.sent_.pop_front();
+                        ++completed_;
+                    }
+                }
+                if (!fill(client)) {
+                    return false;
+                }
+            }
+        }
+        elapsed_ns_ = timer_.elapsed_ns();
+        return true;
+    }
+
+    void report()
+    {
+        std::sort(latency_.begin(), latency_.end());
+        if (latency_.empty()) {
+            latency_.push_back(0.0);
+        }
+        double sum = 0.0;
+        for (double l : latency_) {
+            sum += l;
+        }
+        const double secs = double(elapsed_ns_) / 1e9;
+        printf("{\"bench\":\"load\",\"case\":\"%s\",\"clients\":%u,\"threads\":%u,"
+               "\"pipeline\":%u,\"commands\":%llu,\"commands_per_sec\":%.0f,"
+               "\"mean_ns\":%.0f,\"p50_ns\":%.0f,\"p90_ns\":%.0f,\"p99_ns\":%.0f,"
+               "\"p999_ns\":%.0f,\"max_ns\":%.0f}\n",
+            config_.tcp_ ? "tcp" : "unix", config_.clients_, config_.threads_,
+            config_.pipeline_, (unsigned long long)completed_,
+            secs > 0.0 ? double(completed_) / secs : 0.0,
+            sum / double(latency_.size()), percentile(0.5), percentile(0.9),
+            percentile(0.99), percentile(0.999), latency_.back());
+        fflush(stdout);
+    }
+
+protected:
+    double percentile(double p) const
+    {
+        const size_t index = size_t(p * double(latency_.size() - 1) + 0.5);
+        return latency_[std::min(index, latency_.size() - 1)];
+    }
+
+    // top up the commands a client has in flight
+    bool fill(client_t& client)
+    {
+        if (!client.ready_) {
+            return true;
+        }
+        std::string batch;
+        const std::vector<std::string>& commands = *commands_;
+        while (client.sent_.size() < config_.pipeline_) {
+            batch.append(commands[client.next_ % commands.size()]).push_back('\n');
+            client.sent_.push_back(timer_.elapsed_ns());
+            ++client.next_;
+        }
+        // requests are small, a short write means the server is wedged
+        return batch.empty() || write(client.fd_, batch.data(), batch.size()) == ssize_t(batch.size());
+    }
+
+    int connect_unix(const std::string& path)
+    {
+        const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        memcpy(addr.sun_path, path.data(), path.size());
+        if (fd >= 0 && connect(fd, (const sockaddr*)&addr, sizeof(addr)) != 0) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    int connect_tcp(uint16_t port)
+    {
+        const int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (fd >= 0 && connect(fd, (const sockaddr*)&addr, sizeof(addr)) != 0) {
+            close(fd);
+            return -1;
+        }
+        if (fd >= 0) {
+            const int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        }
+        return fd;
+    }
+
+    const load_config_t& config_;
+    const std::vector<std::string>* commands_;
+    int epoll_;
+    std::vector<client_t> clients_;
+    std::vector<double> latency_;
+    uint64_t completed_;
+    uint64_t elapsed_ns_;
+    bench_timer_t timer_;
+};
+
+void usage()
+{
+    fprintf(stderr,
+        "usage: load_cmd [options]\n"
+        "  --clients N    simulated client connections\n"
+        "  --threads N    server event loop threads\n"
+        "  --pipeline N   commands in flight per client\n"
+        "  --ms N         duration of the run\n"
+        "  --tcp          use loopback tcp rather than a unix socket\n");
+}
+
+bool parse(int argc, char** args, load_config_t& config)
+{
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = args[i];
+        if (strcmp(arg, "--tcp") == 0) {
+            config.tcp_ = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            return false;
+        }
+        const uint32_t value = uint32_t(strtoul(args[++i], nullptr, 10));
+        if (value == 0) {
+            return false;
+        }
+        if (strcmp(arg, "--clients") == 0) {
+            config.clients_ = value;
+        } else if (strcmp(arg, "--threads") == 0) {
+            config.threads_ = value;
+        } else if (strcmp(arg, "--pipeline") == 0) {
+            config.pipeline_ = value;
+        } else if (strcmp(arg, "--ms") == 0) {
+            config.duration_ms_ = value;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+// each client needs a socket at both ends
+void raise_fd_limit()
+{
+    rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+} // namespace {}
+
+int main(int argc, char** args)
+{
+    load_config_t config;
+    if (!parse(argc, args, config)) {
+        return usage(), 1;
+    }
+    raise_fd_limit();
+
+    cmd_parser_t parser;
+    parser.add_command<cmd_expr_t>();
+    bench_tree_t tree;
+    tree.build(parser, 20, 8, 3);
+    parser.freeze();
+
+    // a mix of plain dispatch and expression evaluation
+    std::vector<std::string> commands;
+    bench_random_t rand;
+    for (uint32_t i = 0; i < 64; ++i) {
+        commands.push_back(tree.paths_[rand.next() % tree.paths_.size()]);
+        commands.push_back("expr eval " + std::to_string(rand.range(1, 999)) + " * 3 + 1");
+    }
+
+    cmd_server_t server(parser);
+    server.set_prompt(std::string(1, prompt));
+    const std::string path = "/tmp/load_cmd_" + std::to_string(getpid()) + ".sock";
+    const bool listening = config.tcp_ ? server.listen_tcp(0) : server.listen_unix(path);
+    if (!listening || !server.start(config.threads_)) {
+        fprintf(stderr, "unable to start server\n");
+        return 1;
+    }
+    load_t load(config);
+    if (!load.connect_all(path, server.port())) {
+        fprintf(stderr, "unable to connect %u clients\n", config.clients_);
+        return 1;
+    }
+    if (!load.run(commands)) {
+        fprintf(stderr, "client connection failed\n");
+        return 1;
+    }
+    load.report();
+    server.stop();
+    return 0;
+}
@@ -1,31 +1,87 @@
+#include <algorithm>
 #include <array>
 #include <cassert>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
 #include <limits.h>
 #include <mutex>
+#include <thread>
 
 #include "cmd.h"
 
-// find a list of commands that match a substring
-static bool find_matches(cmd_list_t& list,
-    const char* sub,
-    std::vector<cmd_t*>& vec)
-{
-    assert(sub);
-    int32_t score = 0;
-    for (auto& item : list) {
-        int32_t val = cmd_util_t::str_match(item->name_, sub);
-        if (val > score) {
-            vec.clear();
-            vec.push_back(item.get());
-            score = val;
-        } else if (val == score) {
-            vec.push_back(item.get());
-        } else {
-            // drop on the floor
+namespace {
+// fnv-1a string hash
+uint32_t name_hash(const std::string_view& str)
+{
+    uint32_t hash = 2166136261u;
+    for (const char ch : str) {
+        hash = (hash ^ uint8_t(ch)) * 16777619u;
+    }
+    return hash;
+}
+
+// mix a parent node into a name hash
+uint32_t child_hash(uint32_t parent, uint32_t hash)
+{
+    return hash ^ ((parent + 1) * 0x9e3779b1u);
+}
+
+// open addressing table size for a number of entries
+size_t table_size(size_t count)
+{
+    size_t size = 16;
+    while (size < count * 2) {
+        size <<= 1;
+    }
+    return size;
+}
+
+#if CMD_STATS
+// measures the time between successive laps
+struct stopwatch_t {
+    typedef std::chrono::steady_clock clock_t;
+
+    stopwatch_t()
+        : mark_(clock_t::now())
+    {
+    }
+
+    // nanoseconds since the last lap
+    uint64_t lap()
+    {
+        const clock_t::time_point now = clock_t::now();
+        const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now - mark_);
+        mark_ = now;
+        return uint64_t(ns.count());
+    }
+
+    clock_t::time_point mark_;
+};
+
+void collect_stats(const cmd_list_t& list, std::vector<const cmd_t*>& out)
+{
+    for (const auto& cmd : list) {
+        if (cmd->metrics_.calls()) {
+            out.push_back(cmd.get());
         }
+        collect_stats(cmd->sub_, out);
+    }
+}
+
+void clear_stats(const cmd_list_t& list)
+{
+    for (const auto& cmd : list) {
+        cmd->metrics_.clear();
+        clear_stats(cmd->sub_);
     }
-    return vec.size() > 0;
 }
+#endif
+} // namespace {}
+
+// suggestions are made for edit distances below this
+static const uint32_t FUZZYNESS = 3;
 
 template <typename type_t, size_t size>
 static bool in_array(const type_t& value, const std::array<type_t, size>& array)
@@ -98,354 +154,2794 @@ bool cmd_util_t::strtoll(const char* in, uint64_t& out, bool& neg)
 
 uint32_t cmd_util_t::levenshtein(const char* s1, const char* s2)
 {
-#define MIN3(a, b, c) ((a) < (b) ? ((a) < (c) ? (a) : (c)) : ((b) < (c) ? (b) : (c)))
-    uint32_t x, y, lastdiag, olddiag;
-    const size_t s1len = strlen(s1);
-    const size_t s2len = strlen(s2);
-    uint32_t* column = (uint32_t*)alloca((s1len + 1) * sizeof(uint32_t));
-    for (y = 1; y <= s1len; y++) {
-        column[y] = y;
-    }
-    for (x = 1; x <= s2len; x++) {
-        column[0] = x;
-        for (y = 1, lastdiag = x - 1; y <= s1len; y++) {
-            olddiag = column[y];
-            column[y] = MIN3(column[y] + 1,
-                column[y - 1] + 1,
-                lastdiag + (s1[y - 1] == s2[x - 1] ? 0 : 1));
-            lastdiag = olddiag;
-        }
-    }
-    return column[s1len];
-#undef MIN3
+    return levenshtein(s1, s2, UINT32_MAX - 1);
 }
 
-// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- cmd_parser_t
-
-bool cmd_parser_t::execute(
-    const std::string& expr,
-    cmd_output_t* cmd_out,
-    cmd_baton_t user)
+namespace {
+// advance one 64 row block of the bit parallel edit distance matrix by a
+// single column, returning the horizontal delta out of the last row.
+//
+// see: Myers, "A fast bit-vector algorithm for approximate string matching
+// based on dynamic programming", 1999.
+int32_t advance_block(uint64_t& pv, uint64_t& mv, uint64_t eq, uint64_t high, int32_t hin)
 {
-    assert(cmd_out);
-    cmd_output_t& out = *cmd_out;
-    // aquire the output guard
-    const auto guard = out.guard();
-    const char delimiter = ';';
-    size_t ix = 0;
-    std::string cmd;
-    for (bool active = true; active;) {
-        cmd.clear();
-        // split by delimiter
-        const size_t next = expr.find(delimiter, ix);
-        if (next == expr.npos) {
-            cmd = expr.substr(ix);
-            active = false;
-        } else {
-            if (next > ix) {
-                cmd = expr.substr(ix, next - ix);
-            }
-            ix = next + 1;
-        }
-        // execute single command
-        if (!cmd.empty()) {
-            if (!execute_imp(cmd, cmd_out, user)) {
-                return cmd_locale_t::command_failed(out, cmd.c_str()), false;
-            }
-        }
+    const uint64_t xv = eq | mv;
+    if (hin < 0) {
+        eq |= 1;
     }
-    return true;
+    const uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+    uint64_t ph = mv | ~(xh | pv);
+    uint64_t mh = pv & xh;
+    const int32_t hout = (ph & high) ? 1 : ((mh & high) ? -1 : 0);
+    ph <<= 1;
+    mh <<= 1;
+    if (hin < 0) {
+        mh |= 1;
+    } else if (hin > 0) {
+        ph |= 1;
+    }
+    pv = mh | ~(xv | ph);
+    mv = ph & xv;
+    return hout;
 }
+} // namespace {}
 
-bool cmd_parser_t::execute_imp(
-    const std::string& expr,
-    cmd_output_t* cmd_out,
-    cmd_baton_t user)
+uint32_t cmd_util_t::levenshtein(const char* s1, const char* s2, uint32_t max)
 {
-    assert(cmd_out);
-    cmd_output_t& out = *cmd_out;
-    const std::string prev_cmd = last_cmd();
-    // add to history buffer
-    history_.push_back(expr);
-    // tokenize command string
-    cmd_tokens_t tokens(&idents_);
-    if (tokens.tokenize(expr.c_str()) == 0) {
-        if (!last_cmd().empty()) {
-            out.println("> %s", prev_cmd.c_str());
-            return execute_imp(prev_cmd, cmd_out, user);
-        } else {
-            // no commands entered
-            return false;
-        }
+    assert(s1 && s2);
+    size_t m = strlen(s1);
+    size_t n = strlen(s2);
+    // the pattern is the shorter string so it more often fits one word
+    if (m > n) {
+        std::swap(s1, s2);
+        std::swap(m, n);
     }
-    cmd_list_t* list = &sub_;
-    std::vector<cmd_t*> cmd_vec;
-    // check for aliases
-    cmd_t* cmd = alias_find(tokens.tokens.front());
-    if (cmd) {
-        tokens.tokens.pop();
-        list = &(cmd->sub_);
+    if (n - m > max) {
+        return max + 1;
     }
-    while (!tokens.tokens.empty()) {
-        // find best matching sub command
-        cmd_vec.clear();
-        find_matches(*list, tokens.tokens.front().c_str(), cmd_vec);
-        if (cmd_vec.size() == 0) {
-            // no sub commands to match
-            break;
-        } else if (cmd_vec.size() == 1) {
-            cmd = cmd_vec.front();
-            list = &cmd->sub_;
-            // remove front item
-            tokens.tokens.pop();
-        } else {
-            // ambiguous matches (show possible matches)
-            cmd = nullptr;
-            cmd_locale_t::possible_completions(out);
-            auto indent = out.indent(4);
-            for (auto c : cmd_vec) {
-                out.println("%s", c->name_);
+    if (m == 0) {
+        return uint32_t(n);
+    }
+    const uint8_t* a = (const uint8_t*)s1;
+    const uint8_t* b = (const uint8_t*)s2;
+    if (m <= 64) {
+        // only the entries read below need to be initialized
+        uint64_t peq[256];
+        for (size_t j = 0; j < n; ++j) {
+            peq[b[j]] = 0;
+        }
+        for (size_t i = 0; i < m; ++i) {
+            peq[a[i]] = 0;
+        }
+        for (size_t i = 0; i < m; ++i) {
+            peq[a[i]] |= uint64_t(1) << i;
+        }
+        const uint64_t high = uint64_t(1) << (m - 1);
+        uint64_t pv = ~uint64_t(0), mv = 0;
+        size_t score = m;
+        for (size_t j = 0; j < n; ++j) {
+            score += advance_block(pv, mv, peq[b[j]], high, 1);
+            // the score can fall by at most one per remaining column
+            if (score > max + (n - j - 1)) {
+                return max + 1;
             }
-            break;
         }
+        return uint32_t(score);
     }
-    if (!cmd) {
-        if (parent_) {
-            //XXX: we need to pass the entire thing to the parent ??
-        }
-//      else {
-            cmd_locale_t::invalid_command(out);
-//      }
-        return false;
+    // multi word blocks for long patterns
+    const size_t words = (m + 63) / 64;
+    std::vector<uint64_t> peq(words * 256, 0);
+    for (size_t i = 0; i < m; ++i) {
+        peq[a[i] * words + i / 64] |= uint64_t(1) << (i % 64);
     }
-    if (!tokens.tokens.empty()) {
-        if (tokens.tokens.back() == "?") {
-            return cmd->on_usage(out, user);
+    std::vector<uint64_t> pv(words, ~uint64_t(0)), mv(words, 0);
+    const uint64_t high = uint64_t(1) << ((m - 1) % 64);
+    const uint64_t word_high = uint64_t(1) << 63;
+    size_t score = m;
+    for (size_t j = 0; j < n; ++j) {
+        const uint64_t* eq = &peq[b[j] * words];
+        int32_t carry = 1;
+        for (size_t w = 0; w < words; ++w) {
+            carry = advance_block(pv[w], mv[w], eq[w], (w + 1 == words) ? high : word_high, carry);
+        }
+        score += carry;
+        if (score > max + (n - j - 1)) {
+            return max + 1;
         }
     }
-    return cmd->on_execute(tokens, out, user);
+    return uint32_t(score);
 }
 
-bool cmd_parser_t::alias_add(cmd_t* cmd, const std::string& alias)
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- cmd_index_t
+
+void cmd_index_t::clear()
 {
-    assert(cmd && !alias.empty());
-    alias_[alias] = cmd;
-    return true;
+    nodes_.clear();
+    entries_.clear();
+    nodes_.emplace_back();
+    nodes_.back().count_ = 0;
+    nodes_.back().first_ = 0;
 }
 
-bool cmd_parser_t::alias_remove(const std::string& alias)
+void cmd_index_t::insert(cmd_t* cmd, const char* name)
 {
-    auto itt = alias_.find(alias);
-    if (itt != alias_.end()) {
-        alias_.erase(itt);
-        return true;
-    } else {
-        return false;
+    assert(cmd && name);
+    const uint32_t ordinal = uint32_t(entries_.size());
+    entries_.push_back(cmd);
+    uint32_t node = 0;
+    for (;; ++name) {
+        // note: ordinals only ever increase so first_ is set on creation
+        node_t& n = nodes_[node];
+        if (n.count_++ == 0) {
+            n.first_ = ordinal;
+        }
+        if (*name == '\0') {
+            n.exact_.push_back(ordinal);
+            return;
+        }
+        const char ch = *name;
+        auto itt = std::lower_bound(n.child_.begin(), n.child_.end(), ch,
+            [](const std::pair<char, uint32_t>& a, char b) { return a.first < b; });
+        if (itt != n.child_.end() && itt->first == ch) {
+            node = itt->second;
+            continue;
+        }
+        const uint32_t next = uint32_t(nodes_.size());
+        n.child_.insert(itt, std::make_pair(ch, next));
+        // n is invalidated by this push
+        nodes_.emplace_back();
+        nodes_.back().count_ = 0;
+        nodes_.back().first_ = ordinal;
+        node = next;
     }
 }
 
-bool cmd_parser_t::alias_remove(const cmd_t* cmd)
+int32_t cmd_index_t::walk(const std::string_view& sub) const
 {
-    for (auto itt = alias_.begin(); itt != alias_.end();) {
-        assert(itt->second);
-        if (itt->second == cmd) {
-            itt = alias_.erase(itt);
-        } else {
-            ++itt;
+    uint32_t node = 0;
+    for (const char ch : sub) {
+        const node_t& n = nodes_[node];
+        auto itt = std::lower_bound(n.child_.begin(), n.child_.end(), ch,
+            [](const std::pair<char, uint32_t>& a, char b) { return a.first < b; });
+        if (itt == n.child_.end() || itt->first != ch) {
+            return -1;
         }
+        node = itt->second;
     }
-    return true;
+    return int32_t(node);
 }
 
-// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- cmd_t
+void cmd_index_t::collect(uint32_t node, std::vector<uint32_t>& out) const
+{
+    const node_t& n = nodes_[node];
+    out.insert(out.end(), n.exact_.begin(), n.exact_.end());
+    for (const auto& child : n.child_) {
+        collect(child.second, out);
+    }
+}
 
-bool cmd_t::on_execute(cmd_tokens_t& tok, cmd_output_t& out, cmd_baton_t user)
+size_t cmd_index_t::find(const std::string_view& sub, std::vector<cmd_t*>& out) const
 {
-    (void)user;
-    static const int FUZZYNESS = 3;
-    const bool have_subcomands = !sub_.empty();
-    if (!have_subcomands) {
-        // an empty terminal cmd is a bit weird
-        return false;
+    const int32_t node = walk(sub);
+    if (node < 0) {
+        return 0;
     }
-    const bool have_tokens = !tok.tokens.empty();
-    if (have_tokens) {
-        const char* tok_front = tok.tokens.front().c_str();
-        std::vector<cmd_t*> list;
-        for (const auto& i : sub_) {
-            if (cmd_util_t::levenshtein(i->name_, tok.tokens.front().c_str()) < FUZZYNESS) {
-                list.push_back(i.get());
-            }
-        }
-        cmd_locale_t::no_subcommand(out, tok_front);
-        if (!list.empty()) {
-            cmd_locale_t::did_you_meen(out);
-            auto indent = out.indent();
-            for (cmd_t* cmd : list) {
-                out.println("%s", cmd->name_);
-            }
+    const node_t& n = nodes_[node];
+    // exact matches take priority over partial matches
+    if (!n.exact_.empty()) {
+        for (const uint32_t ordinal : n.exact_) {
+            out.push_back(entries_[ordinal]);
         }
-    } else {
-        print_sub_commands(out);
+        return n.exact_.size();
     }
-    return true;
-};
+    // unique prefix
+    if (n.count_ == 1) {
+        out.push_back(entries_[n.first_]);
+        return 1;
+    }
+    // ambiguous prefix, report in registration order
+    std::vector<uint32_t> ordinals;
+    ordinals.reserve(n.count_);
+    collect(uint32_t(node), ordinals);
+    std::sort(ordinals.begin(), ordinals.end());
+    for (const uint32_t ordinal : ordinals) {
+        out.push_back(entries_[ordinal]);
+    }
+    return ordinals.size();
+}
 
-bool cmd_t::alias_add(const std::string& name)
+cmd_t* cmd_index_t::find_exact(const std::string_view& name) const
 {
-    return parser_.alias_add(this, name);
+    const int32_t node = walk(name);
+    if (node < 0 || nodes_[node].exact_.empty()) {
+        return nullptr;
+    }
+    return entries_[nodes_[node].exact_.front()];
 }
 
-// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- cmd_output_stdio_t
-
-struct cmd_output_stdio_t : public cmd_output_t {
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- cmd_idents_t
 
-    cmd_output_stdio_t(FILE* fd)
-        : fd_(fd)
-        , cmd_output_t()
-    {
+uint32_t cmd_idents_t::slot(const std::string_view& name) const
+{
+    if (table_.empty()) {
+        return npos;
     }
+    const uint32_t hash = name_hash(name);
+    const size_t mask = table_.size() - 1;
+    for (size_t i = hash & mask; table_[i]; i = (i + 1) & mask) {
+        const slot_t& entry = slots_[table_[i] - 1];
+        if (entry.hash_ == hash && entry.len_ == name.size()) {
+            if (name.compare(0, name.size(), names_.data() + entry.off_, entry.len_) == 0) {
+                return table_[i] - 1;
+            }
+        }
+    }
+    return npos;
+}
 
-    virtual void lock() override
-    {
-
-        mux_.lock();
+uint32_t cmd_idents_t::intern(const std::string_view& name)
+{
+    const uint32_t found = slot(name);
+    if (found != npos) {
+        return found;
     }
+    slot_t entry;
+    entry.off_ = uint32_t(names_.size());
+    entry.len_ = uint32_t(name.size());
+    entry.hash_ = name_hash(name);
+    entry.set_ = false;
+    entry.changed_ = false;
+    entry.value_ = 0;
+    names_.insert(names_.end(), name.begin(), name.end());
+    names_.push_back('\0');
+    slots_.push_back(entry);
+    // keep the load factor below one half
+    if (slots_.size() * 2 > table_.size()) {
+        rehash(table_size(slots_.size()));
+    } else {
+        insert(uint32_t(slots_.size() - 1));
+    }
+    return uint32_t(slots_.size() - 1);
+}
 
-    virtual void unlock() override
-    {
-        mux_.unlock();
+void cmd_idents_t::insert(uint32_t index)
+{
+    const size_t mask = table_.size() - 1;
+    size_t i = slots_[index].hash_ & mask;
+    while (table_[i]) {
+        i = (i + 1) & mask;
     }
+    table_[i] = index + 1;
+}
 
-    virtual void print(bool ind, const char* fmt, va_list& args) override
-    {
-        ind ? indent_apply() : (void)0;
-        vfprintf(fd_, fmt, args);
+void cmd_idents_t::rehash(size_t size)
+{
+    table_.assign(size, 0);
+    for (uint32_t i = 0; i < slots_.size(); ++i) {
+        insert(i);
     }
+}
 
-    virtual void println(bool ind, const char* fmt, va_list& args) override
-    {
-        ind ? indent_apply() : (void)0;
-        vfprintf(fd_, fmt, args);
-        eol();
+bool cmd_idents_t::erase(const std::string_view& name)
+{
+    const uint32_t index = slot(name);
+    if (!is_set(index)) {
+        return false;
+    }
+    slots_[index].set_ = false;
+    --count_;
+    if (track_) {
+        touch(index);
     }
+    // reclaim the space of erased names once they are most of the table,
+    // not counting changed slots which compact() has to keep
+    if (slots_.size() - count_ - std::min(changed_.size(), slots_.size() - count_) > std::max<size_t>(count_, 1024)) {
+        compact();
+    }
+    return true;
+}
 
-    virtual void eol() override
-    {
-        fputc('\n', fd_);
+void cmd_idents_t::compact()
+{
+    std::pmr::vector<uint32_t> moved(slots_.size(), npos, slots_.get_allocator());
+    std::pmr::vector<char> names(names_.get_allocator());
+    names.reserve(names_.size());
+    uint32_t next = 0;
+    for (uint32_t i = 0; i < slots_.size(); ++i) {
+        slot_t entry = slots_[i];
+        // an erase still to be taken by changes() keeps its name
+        if (!entry.set_ && !entry.changed_) {
+            continue;
+        }
+        const std::string_view old = name(i);
+        entry.off_ = uint32_t(names.size());
+        names.insert(names.end(), old.begin(), old.end());
+        names.push_back('\0');
+        slots_[next] = entry;
+        moved[i] = next++;
+    }
+    slots_.resize(next);
+    names_.swap(names);
+    for (uint32_t& slot : changed_) {
+        slot = moved[slot];
     }
+    rehash(table_size(slots_.size()));
+    ++epoch_;
+}
 
-protected:
-    FILE* fd_;
-    std::mutex mux_;
+void cmd_idents_t::clear()
+{
+    slots_.clear();
+    table_.clear();
+    names_.clear();
+    count_ = 0;
+    changed_.clear();
+    cleared_ = track_;
+    ++epoch_;
+}
 
-    void indent_apply()
-    {
-        for (uint32_t i = 0; i < indent_; ++i) {
-            fputc(' ', fd_);
-        }
+bool cmd_idents_t::changes(std::vector<uint32_t>& out)
+{
+    for (const uint32_t slot : changed_) {
+        slots_[slot].changed_ = false;
+        out.push_back(slot);
     }
-};
+    changed_.clear();
+    const bool cleared = cleared_;
+    cleared_ = false;
+    return cleared;
+}
 
-cmd_output_t* cmd_output_t::create_output_stdio(FILE* fd)
+void cmd_idents_t::sorted(std::vector<uint32_t>& out) const
 {
-    return new cmd_output_stdio_t(fd);
+    const size_t start = out.size();
+    for (uint32_t i = 0; i < slots_.size(); ++i) {
+        if (slots_[i].set_) {
+            out.push_back(i);
+        }
+    }
+    std::sort(out.begin() + start, out.end(),
+        [this](uint32_t a, uint32_t b) { return name(a) < name(b); });
 }
 
-// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- cmd_output_dummy_t
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- cmd_frozen_t
 
-struct cmd_output_dummy_t : public cmd_output_t {
 
-    cmd_output_dummy_t()
-        : cmd_output_t()
-    {
+void cmd_frozen_t::build(const cmd_list_t& roots, const cmd_alias_map_t& alias)
+{
+    *this = cmd_frozen_t();
+    // breadth first layout so that children are contiguous
+    std::vector<const cmd_t*> order;
+    for (const auto& cmd : roots) {
+        order.push_back(cmd.get());
+        parent_.push_back(npos);
     }
-
-    virtual void lock() override
-    {
+    root_end_ = uint32_t(order.size());
+    for (uint32_t i = 0; i < order.size(); ++i) {
+        const cmd_t* cmd = order[i];
+        child_begin_.push_back(uint32_t(order.size()));
+        for (const auto& sub : cmd->sub_) {
+            order.push_back(sub.get());
+            parent_.push_back(i);
+        }
+        child_end_.push_back(uint32_t(order.size()));
     }
-
-    virtual void unlock() override
-    {
+    // intern names
+    for (uint32_t i = 0; i < order.size(); ++i) {
+        const cmd_t* cmd = order[i];
+        const std::string_view name(cmd->name_);
+        name_off_.push_back(uint32_t(names_.size()));
+        name_len_.push_back(uint32_t(name.size()));
+        name_hash_.push_back(name_hash(name));
+        names_.insert(names_.end(), name.begin(), name.end());
+        names_.push_back('\0');
+        cmd_.push_back(const_cast<cmd_t*>(cmd));
+        node_of_[cmd] = i;
     }
-
-    virtual void print(bool ind, const char* fmt, va_list& args) override
-    {
+    // sort each sibling range by name
+    dup_.assign(order.size(), 0);
+    sorted_.resize(order.size());
+    for (uint32_t i = 0; i < order.size(); ++i) {
+        sorted_[i] = i;
     }
-
-    virtual void println(bool ind, const char* fmt, va_list& args) override
-    {
+    auto sort_range = [this](uint32_t begin, uint32_t end) {
+        auto less = [this](uint32_t a, uint32_t b) {
+            const int cmp = name(a).compare(name(b));
+            return cmp ? cmp < 0 : a < b;
+        };
+        std::sort(sorted_.begin() + begin, sorted_.begin() + end, less);
+        for (uint32_t j = begin + 1; j < end; ++j) {
+            if (name(sorted_[j]) == name(sorted_[j - 1])) {
+                dup_[sorted_[j]] = dup_[sorted_[j - 1]] = 1;
+            }
+        }
+    };
+    sort_range(0, root_end_);
+    for (uint32_t i = 0; i < order.size(); ++i) {
+        sort_range(child_begin_[i], child_end_[i]);
     }
-
-    virtual void eol() override
-    {
+    // exact (parent, name) lookup table
+    exact_.assign(table_size(order.size()), 0);
+    const size_t mask = exact_.size() - 1;
+    for (uint32_t i = 0; i < order.size(); ++i) {
+        size_t slot = child_hash(parent_[i], name_hash_[i]) & mask;
+        while (exact_[slot]) {
+            slot = (slot + 1) & mask;
+        }
+        exact_[slot] = i + 1;
     }
-};
+    build_alias(alias);
+}
 
-cmd_output_t* cmd_output_t::create_output_dummy()
+void cmd_frozen_t::build_alias(const cmd_alias_map_t& alias)
 {
-    return new cmd_output_dummy_t;
+    alias_off_.clear();
+    alias_len_.clear();
+    alias_hash_.clear();
+    alias_node_.clear();
+    alias_names_.clear();
+    for (const auto& itt : alias) {
+        auto node = node_of_.find(itt.second);
+        if (node == node_of_.end()) {
+            // alias to a command that is not part of this tree
+            continue;
+        }
+        alias_off_.push_back(uint32_t(alias_names_.size()));
+        alias_len_.push_back(uint32_t(itt.first.size()));
+        alias_hash_.push_back(name_hash(itt.first));
+        alias_node_.push_back(node->second);
+        alias_names_.insert(alias_names_.end(), itt.first.begin(), itt.first.end());
+    }
+    alias_slot_.assign(table_size(alias_node_.size()), 0);
+    const size_t mask = alias_slot_.size() - 1;
+    for (uint32_t i = 0; i < alias_node_.size(); ++i) {
+        size_t slot = alias_hash_[i] & mask;
+        while (alias_slot_[slot]) {
+            slot = (slot + 1) & mask;
+        }
+        alias_slot_[slot] = i + 1;
+    }
 }
 
-// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- cmd_tokens_t
-
-void cmd_tokens_t::push(std::string input)
+uint32_t cmd_frozen_t::alias_find(const std::string_view& alias) const
 {
-    const char EXP_DELIM = '$';
-    /* flush when input is empty */
-    if (input.empty()) {
-        if (!stage_pair_.first.empty()) {
-            flags.flags_.insert(stage_pair_.first);
-            stage_pair_.first.clear();
+    const uint32_t hash = name_hash(alias);
+    const size_t mask = alias_slot_.size() - 1;
+    for (size_t slot = hash & mask; alias_slot_[slot]; slot = (slot + 1) & mask) {
+        const uint32_t i = alias_slot_[slot] - 1;
+        if (alias_hash_[i] == hash && alias_len_[i] == alias.size()) {
+            if (alias.compare(0, alias.size(), alias_names_.data() + alias_off_[i], alias_len_[i]) == 0) {
+                return alias_node_[i];
+            }
         }
-        return;
     }
-    /* process identifier substitution */
-    if (idents_) {
-        if (input[0] == EXP_DELIM) {
-            const char* temp = input.c_str() + 1;
-            auto itt = idents_->find(temp);
-            if (itt != idents_->end()) {
-                const uint64_t val = itt->second;
-                // todo: convert to hex string
-                input = std::to_string(val);
-            }
+    return npos;
+}
+
+uint32_t cmd_frozen_t::find_exact(uint32_t parent, const std::string_view& sub, uint32_t hash) const
+{
+    const size_t mask = exact_.size() - 1;
+    for (size_t slot = child_hash(parent, hash) & mask; exact_[slot]; slot = (slot + 1) & mask) {
+        const uint32_t i = exact_[slot] - 1;
+        if (name_hash_[i] == hash && parent_[i] == parent && name(i) == sub) {
+            return i;
         }
     }
-    /* add to raw token set */
-    tokens.raw_.push_back(input);
-    /* if we have a flag or switch */
-    if (input.find("-") == 0) {
-        if (!stage_pair_.first.empty()) {
-            flags.flags_.insert(stage_pair_.first);
+    return npos;
+}
+
+size_t cmd_frozen_t::find(uint32_t parent, const std::string_view& sub, std::vector<uint32_t>& out) const
+{
+    const uint32_t begin = child_begin(parent);
+    const uint32_t end = child_end(parent);
+    if (begin == end) {
+        return 0;
+    }
+    // fast path for an exact unique match
+    const uint32_t exact = find_exact(parent, sub, name_hash(sub));
+    if (exact != npos && !dup_[exact]) {
+        out.push_back(exact);
+        return 1;
+    }
+    // all names prefixed by sub are adjacent in the sorted range
+    auto first = std::lower_bound(sorted_.begin() + begin, sorted_.begin() + end, sub,
+        [this](uint32_t node, const std::string_view& s) { return name(node) < s; });
+    const size_t start = out.size();
+    for (auto itt = first; itt != sorted_.begin() + end; ++itt) {
+        const std::string_view str = name(*itt);
+        if (str.compare(0, sub.size(), sub) != 0) {
+            break;
         }
-        stage_pair_.first = input;
-    } else {
-        if (!stage_pair_.first.empty()) {
-            pairs.pairs_[stage_pair_.first] = input;
-            stage_pair_.first.clear();
-        } else {
-            tokens.tokens_.push_back(input);
+        // exact matches sort first and take priority over partial matches
+        if (exact != npos && str.size() != sub.size()) {
+            break;
+        }
+        out.push_back(*itt);
+    }
+    // report in registration order
+    std::sort(out.begin() + start, out.end());
+    return out.size() - start;
+}
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- cmd_histogram_t
+
+uint64_t cmd_histogram_t::percentile(double p) const
+{
+    const uint64_t num = count();
+    if (num == 0) {
+        return 0;
+    }
+    // rank of the sample we are looking for, counting from 1
+    uint64_t rank = uint64_t(p * double(num) + 0.5);
+    rank = std::max<uint64_t>(1, std::min(rank, num));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets; ++i) {
+        seen += at(i);
+        if (seen >= rank) {
+            return uint64_t(2) << i;
+        }
+    }
+    return uint64_t(2) << (buckets - 1);
+}
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- cmd_fuzzy_t
+
+void cmd_fuzzy_t::build(const cmd_list_t& roots, const cmd_alias_map_t& alias)
+{
+    nodes_.clear();
+    keys_.clear();
+    std::string path;
+    for (const auto& cmd : roots) {
+        path.clear();
+        insert(cmd.get(), path);
+    }
+    for (const auto& itt : alias) {
+        insert(itt.first, itt.second, true);
+    }
+}
+
+void cmd_fuzzy_t::insert(const cmd_t* cmd, std::string& path)
+{
+    const size_t size = path.size();
+    if (size) {
+        path.append(1, ' ');
+    }
+    path.append(cmd->name_);
+    insert(path, const_cast<cmd_t*>(cmd), false);
+    for (const auto& sub : cmd->sub_) {
+        insert(sub.get(), path);
+    }
+    path.resize(size);
+}
+
+void cmd_fuzzy_t::insert(const std::string& str, cmd_t* cmd, bool alias)
+{
+    const uint32_t index = uint32_t(nodes_.size());
+    nodes_.emplace_back();
+    node_t& node = nodes_.back();
+    node.key_off_ = uint32_t(keys_.size());
+    node.key_len_ = uint32_t(str.size());
+    node.cmd_ = cmd;
+    node.alias_ = alias;
+    keys_.insert(keys_.end(), str.begin(), str.end());
+    keys_.push_back('\0');
+    if (index == 0) {
+        return;
+    }
+    // walk down from the root following the edge of equal distance
+    uint32_t parent = 0;
+    for (;;) {
+        const uint32_t dist = cmd_util_t::levenshtein(key(parent), str.c_str());
+        auto& child = nodes_[parent].child_;
+        auto itt = std::find_if(child.begin(), child.end(),
+            [dist](const std::pair<uint32_t, uint32_t>& edge) { return edge.first == dist; });
+        if (itt == child.end()) {
+            child.emplace_back(dist, index);
+            return;
+        }
+        parent = itt->second;
+    }
+}
+
+cmd_fuzzy_t::match_t cmd_fuzzy_t::match(uint32_t node, uint32_t distance) const
+{
+    const node_t& n = nodes_[node];
+    return match_t{ n.cmd_, std::string_view(key(node), n.key_len_), distance, node, n.alias_ };
+}
+
+template <typename visit_t>
+void cmd_fuzzy_t::search(const std::string& str, uint32_t& max, visit_t visit) const
+{
+    if (nodes_.empty()) {
+        return;
+    }
+    std::vector<uint32_t> stack(1, 0);
+    while (!stack.empty()) {
+        const uint32_t node = stack.back();
+        stack.pop_back();
+        const uint32_t dist = cmd_util_t::levenshtein(key(node), str.c_str());
+        if (dist <= max) {
+            visit(node, dist);
+        }
+        // triangle inequality bounds the distance of every key below an edge
+        for (const auto& edge : nodes_[node].child_) {
+            if (edge.first + max >= dist && edge.first <= dist + max) {
+                stack.push_back(edge.second);
+            }
+        }
+    }
+}
+
+size_t cmd_fuzzy_t::find(const std::string_view& str, uint32_t max, std::vector<match_t>& out) const
+{
+    const size_t start = out.size();
+    const std::string key(str);
+    search(key, max, [&](uint32_t node, uint32_t dist) {
+        out.push_back(match(node, dist));
+    });
+    std::sort(out.begin() + start, out.end(),
+        [](const match_t& a, const match_t& b) { return a.ordinal_ < b.ordinal_; });
+    return out.size() - start;
+}
+
+size_t cmd_fuzzy_t::nearest(const std::string_view& str, size_t k, uint32_t max, std::vector<match_t>& out) const
+{
+    if (k == 0) {
+        return 0;
+    }
+    auto closer = [](const match_t& a, const match_t& b) {
+        return a.distance_ != b.distance_ ? a.distance_ < b.distance_ : a.ordinal_ < b.ordinal_;
+    };
+    // keep the best k matches as a max heap, shrinking the radius once full
+    std::vector<match_t> heap;
+    const std::string key(str);
+    search(key, max, [&](uint32_t node, uint32_t dist) {
+        heap.push_back(match(node, dist));
+        std::push_heap(heap.begin(), heap.end(), closer);
+        if (heap.size() > k) {
+            std::pop_heap(heap.begin(), heap.end(), closer);
+            heap.pop_back();
+        }
+        if (heap.size() == k) {
+            max = heap.front().distance_;
+        }
+    });
+    std::sort(heap.begin(), heap.end(), closer);
+    out.insert(out.end(), heap.begin(), heap.end());
+    return heap.size();
+}
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- cmd_pool_t
+
+struct cmd_pool_t::batch_t {
+    /// @brief jobs not yet completed, guarded by mux_.
+    size_t pending_;
+    std::mutex mux_;
+    std::condition_variable done_;
+};
+
+struct cmd_pool_t::job_t {
+    task_t* task_;
+    /// @brief batch of the job, or nullptr if it was submitted and owns task_.
+    batch_t* batch_;
+};
+
+struct cmd_pool_t::queue_t {
+    std::mutex mux_;
+    std::deque<job_t> jobs_;
+};
+
+cmd_pool_t::cmd_pool_t(uint32_t threads)
+    : queued_(0)
+    , next_(0)
+    , stop_(false)
+{
+    threads = std::max(threads, 1u);
+    for (uint32_t i = 0; i < threads; ++i) {
+        queues_.emplace_back(new queue_t);
+    }
+    for (uint32_t i = 0; i < threads; ++i) {
+        threads_.emplace_back([this, i]() { worker(i); });
+    }
+}
+
+cmd_pool_t::~cmd_pool_t()
+{
+    {
+        std::lock_guard<std::mutex> guard(mux_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread& thread : threads_) {
+        thread.join();
+    }
+}
+
+void cmd_pool_t::run(std::vector<task_t>& tasks)
+{
+    if (tasks.empty()) {
+        return;
+    }
+    batch_t batch;
+    batch.pending_ = tasks.size();
+    for (task_t& task : tasks) {
+        queue_t& queue = *queues_[next_++ % queues_.size()];
+        std::lock_guard<std::mutex> guard(queue.mux_);
+        queue.jobs_.push_back(job_t{ &task, &batch });
+        ++queued_;
+    }
+    {
+        // taking the lock orders the push before any worker goes to sleep
+        std::lock_guard<std::mutex> guard(mux_);
+    }
+    wake_.notify_all();
+    // help out rather than blocking until the batch is done
+    const size_t home = next_ % queues_.size();
+    job_t job;
+    for (;;) {
+        if (take(home, job)) {
+            execute(job);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(batch.mux_);
+        batch.done_.wait(lock, [&]() { return batch.pending_ == 0; });
+        break;
+    }
+}
+
+void cmd_pool_t::submit(task_t task)
+{
+    const size_t next = next_++ % queues_.size();
+    {
+        queue_t& queue = *queues_[next];
+        std::lock_guard<std::mutex> guard(queue.mux_);
+        // taken from the back by the owner, so the oldest runs first
+        queue.jobs_.push_front(job_t{ new task_t(std::move(task)), nullptr });
+        ++queued_;
+    }
+    {
+        std::lock_guard<std::mutex> guard(mux_);
+    }
+    wake_.notify_one();
+}
+
+void cmd_pool_t::worker(size_t home)
+{
+    job_t job;
+    for (;;) {
+        if (take(home, job)) {
+            execute(job);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(mux_);
+        wake_.wait(lock, [this]() { return stop_ || queued_ != 0; });
+        if (stop_ && queued_ == 0) {
+            return;
+        }
+    }
+}
+
+bool cmd_pool_t::take(size_t home, job_t& out)
+{
+    const size_t count = queues_.size();
+    for (size_t i = 0; i < count && queued_ != 0; ++i) {
+        queue_t& queue = *queues_[(home + i) % count];
+        std::lock_guard<std::mutex> guard(queue.mux_);
+        if (queue.jobs_.empty()) {
+            continue;
+        }
+        // newest from our own deque, oldest when stealing
+        if (i == 0) {
+            out = queue.jobs_.back();
+            queue.jobs_.pop_back();
+        } else {
+            out = queue.jobs_.front();
+            queue.jobs_.pop_front();
+        }
+        --queued_;
+        return true;
+    }
+    return false;
+}
+
+void cmd_pool_t::execute(job_t& job)
+{
+    (*job.task_)();
+    if (!job.batch_) {
+        delete job.task_;
+        return;
+    }
+    // the batch lives on the stack of run() so is only touched under its lock
+    batch_t& batch = *job.batch_;
+    std::lock_guard<std::mutex> guard(batch.mux_);
+    if (--batch.pending_ == 0) {
+        batch.done_.notify_all();
+    }
+}
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- cmd_job_list_t
+
+cmd_job_t::cmd_job_t(uint32_t id, const std::string& expr, cmd_idents_t* idents, cmd_session_t* session)
+    : id_(id)
+    , expr_(expr)
+    , out_(cmd_output_t::create_output_buffer())
+    , tokens_(idents, session)
+    , state_(e_queued)
+    , ok_(false)
+{
+    tokens_.set_cancel(&cancel_);
+}
+
+void cmd_job_t::cancel()
+{
+    cancel_.cancel();
+    uint32_t queued = e_queued;
+    if (state_.compare_exchange_strong(queued, e_running)) {
+        finish(false);
+    }
+}
+
+bool cmd_job_t::start()
+{
+    uint32_t queued = e_queued;
+    return state_.compare_exchange_strong(queued, e_running);
+}
+
+void cmd_job_t::finish(bool ok)
+{
+    ok_ = ok;
+    // set under the lock so join() can not miss it
+    std::lock_guard<std::mutex> guard(mux_);
+    state_.store(e_done, std::memory_order_release);
+    returned_.notify_all();
+}
+
+void cmd_job_t::join()
+{
+    std::unique_lock<std::mutex> lock(mux_);
+    returned_.wait(lock, [this]() { return done(); });
+}
+
+cmd_job_list_t::~cmd_job_list_t()
+{
+    for (auto& job : jobs_) {
+        job->cancel();
+    }
+    for (auto& job : jobs_) {
+        job->join();
+    }
+}
+
+void cmd_job_list_t::add(std::shared_ptr<cmd_job_t> job)
+{
+    assert(job && job->id_ == next_);
+    ++next_;
+    jobs_.push_back(std::move(job));
+}
+
+cmd_job_t* cmd_job_list_t::find(uint32_t id) const
+{
+    for (const auto& job : jobs_) {
+        if (job->id_ == id) {
+            return job.get();
+        }
+    }
+    return nullptr;
+}
+
+bool cmd_job_list_t::kill(uint32_t id)
+{
+    cmd_job_t* job = find(id);
+    if (job) {
+        job->cancel();
+    }
+    return job != nullptr;
+}
+
+bool cmd_job_list_t::wait(uint32_t id, cmd_output_t& out)
+{
+    auto itt = std::find_if(jobs_.begin(), jobs_.end(), [id](const std::shared_ptr<cmd_job_t>& job) {
+        return job->id_ == id;
+    });
+    if (itt == jobs_.end()) {
+        return false;
+    }
+    std::shared_ptr<cmd_job_t> job = std::move(*itt);
+    jobs_.erase(itt);
+    finish(*job, out);
+    return true;
+}
+
+size_t cmd_job_list_t::reap(cmd_output_t& out)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < jobs_.size();) {
+        if (!jobs_[i]->done()) {
+            ++i;
+            continue;
+        }
+        std::shared_ptr<cmd_job_t> job = std::move(jobs_[i]);
+        jobs_.erase(jobs_.begin() + i);
+        cmd_locale_t::job_state(out, job->id_, true, job->expr_);
+        finish(*job, out);
+        ++count;
+    }
+    return count;
+}
+
+void cmd_job_list_t::finish(cmd_job_t& job, cmd_output_t& out)
+{
+    job.join();
+    const std::string_view text = job.out_->view();
+    if (!text.empty()) {
+        out.write_raw(text.data(), text.size());
+    }
+    if (!job.ok_) {
+        cmd_locale_t::command_failed(out, job.expr_.c_str());
+    }
+}
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- cmd_history_list_t
+
+bool cmd_history_list_t::push(const std::string_view& line)
+{
+    const size_t need = line.size() + 1;
+    if (lines_ == 0 || need > bytes_) {
+        return false;
+    }
+    const uint32_t hash = name_hash(line);
+    if (count_) {
+        const entry_t& last = entry(count_ - 1);
+        if (last.hash_ == hash && std::string_view(text_.data() + last.off_, last.len_) == line) {
+            return false;
+        }
+    }
+    while (count_ >= lines_) {
+        drop();
+    }
+    // the line may be held here already, so old text is kept until copied
+    std::pmr::vector<char> old(text_.get_allocator());
+    if (used_ + need > text_.size() && text_.size() < bytes_) {
+        // grow the text ring, packing the lines in from the front
+        old.swap(text_);
+        text_.resize(std::min(bytes_, std::max({ used_ + need, old.size() * 2, size_t(256) })));
+        size_t off = 0;
+        for (size_t i = 0; i < count_; ++i) {
+            entry_t& e = entries_[(first_ + i) % entries_.size()];
+            memcpy(text_.data() + off, old.data() + e.off_, e.len_ + 1);
+            e.off_ = uint32_t(off);
+            off += e.len_ + 1;
+        }
+        head_ = off;
+    }
+    if (head_ + need > text_.size()) {
+        // wrap, the lines past the write position are the oldest
+        while (count_ && entry(0).off_ >= head_) {
+            drop();
+        }
+        head_ = 0;
+    }
+    // the oldest lines sit just past the write position
+    while (count_ && entry(0).off_ >= head_ && entry(0).off_ < head_ + need) {
+        drop();
+    }
+    if (count_ == entries_.size()) {
+        // grow the entry ring, moving the oldest line to the front
+        std::pmr::vector<entry_t> grown(std::min(lines_, std::max<size_t>(16, count_ * 2)), entries_.get_allocator());
+        for (size_t i = 0; i < count_; ++i) {
+            grown[i] = entry(i);
+        }
+        entries_.swap(grown);
+        first_ = 0;
+    }
+    const size_t off = head_;
+    if (!line.empty()) {
+        memmove(text_.data() + off, line.data(), line.size());
+    }
+    text_[off + line.size()] = '\0';
+    entries_[(first_ + count_) % entries_.size()] = entry_t{ uint32_t(off), uint32_t(line.size()), hash };
+    ++count_;
+    used_ += need;
+    head_ = off + need;
+    ++next_;
+    return true;
+}
+
+void cmd_history_list_t::drop()
+{
+    assert(count_);
+    used_ -= entry(0).len_ + 1;
+    first_ = (first_ + 1) % entries_.size();
+    if (--count_ == 0) {
+        first_ = 0;
+        head_ = 0;
+    }
+}
+
+void cmd_history_list_t::set_limit(size_t lines, size_t bytes)
+{
+    cmd_history_list_t list(text_.get_allocator().resource(), lines, bytes);
+    for (const std::string_view line : *this) {
+        if (line.size() + 1 > list.bytes_) {
+            // too long to keep, so neither is anything older
+            list.clear();
+            continue;
+        }
+        list.push(line);
+    }
+    // numbers follow from the last one
+    list.next_ = next_;
+    *this = std::move(list);
+}
+
+bool cmd_history_list_t::find(uint64_t number, std::string_view& line) const
+{
+    if (number < first_number() || number >= next_) {
+        return false;
+    }
+    line = (*this)[size_t(number - first_number())];
+    return true;
+}
+
+bool cmd_history_list_t::recall(const std::string_view& event, std::string_view& line) const
+{
+    const size_t start = event.find_first_not_of(" \t");
+    if (start == event.npos || event[start] != '!') {
+        return false;
+    }
+    const size_t end = event.find_last_not_of(" \t\r\n");
+    const std::string_view ref = event.substr(start + 1, end - start);
+    if (ref == "!") {
+        line = count_ ? back() : std::string_view();
+        return true;
+    }
+    const bool relative = !ref.empty() && ref[0] == '-';
+    const char* first = ref.data() + (relative ? 1 : 0);
+    const char* last = ref.data() + ref.size();
+    uint64_t value = 0;
+    const std::from_chars_result res = std::from_chars(first, last, value);
+    if (first == last || res.ec != std::errc() || res.ptr != last) {
+        return false;
+    }
+    if (relative) {
+        value = value <= next_ ? next_ - value : 0;
+    }
+    if (!find(value, line)) {
+        line = std::string_view();
+    }
+    return true;
+}
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- cmd_session_t
+
+namespace {
+// split off the next ';' delimited expression, returns false after the last
+bool split_next(const std::string& expr, size_t& ix, std::pmr::string& cmd)
+{
+    const char delimiter = ';';
+    cmd.clear();
+    const size_t next = expr.find(delimiter, ix);
+    if (next == expr.npos) {
+        cmd.assign(expr, ix, expr.npos);
+        return false;
+    }
+    if (next > ix) {
+        cmd.assign(expr, ix, next - ix);
+    }
+    ix = next + 1;
+    return true;
+}
+
+// leaves a level of execute() nesting on scope exit, releasing the arena
+// once the outermost level is left
+struct depth_guard_t {
+
+    depth_guard_t(size_t& depth, std::pmr::monotonic_buffer_resource& arena)
+        : depth_(depth)
+        , arena_(arena)
+    {
+        ++depth_;
+    }
+
+    ~depth_guard_t()
+    {
+        if (--depth_ == 0) {
+            arena_.release();
+        }
+    }
+
+    size_t& depth_;
+    std::pmr::monotonic_buffer_resource& arena_;
+};
+
+// strip a trailing '&' that marks a background job, '&&' is left alone
+bool strip_background(std::pmr::string& expr)
+{
+    const char* whitespace = " \t\r";
+    const size_t end = expr.find_last_not_of(whitespace);
+    if (end == expr.npos || expr[end] != '&' || (end && expr[end - 1] == '&')) {
+        return false;
+    }
+    const size_t last = end ? expr.find_last_not_of(whitespace, end - 1) : expr.npos;
+    expr.erase(last == expr.npos ? 0 : last + 1);
+    return true;
+}
+
+// a command of a '&&' group with its own captured output
+struct group_job_t {
+
+    group_job_t(cmd_idents_t* idents, cmd_session_t* session, const std::string_view& expr)
+        : expr_(expr)
+        , tokens_(idents, session)
+        , cmd_(nullptr)
+        , out_(cmd_output_t::create_output_buffer())
+        , ok_(false)
+        , lap_{ 0 }
+    {
+    }
+
+    std::string expr_;
+    cmd_tokens_t tokens_;
+    cmd_t* cmd_;
+    std::unique_ptr<cmd_output_buffer_t> out_;
+    bool ok_;
+    uint64_t lap_[cmd_metrics_t::e_phases];
+};
+} // namespace {}
+
+cmd_session_t::cmd_session_t(cmd_parser_t& parser)
+    : parser_(parser)
+    // blocks of up to 64k are pooled so arena overflow is recycled as well
+    , pool_(std::pmr::pool_options{ 0, 64 * 1024 }, parser.memory_.upstream_)
+    , arena_(pool_.allocate(std::max<size_t>(parser.memory_.arena_, 64)),
+          std::max<size_t>(parser.memory_.arena_, 64), &pool_)
+    , history_(&pool_, parser.memory_.history_lines_, parser.memory_.history_bytes_)
+    , idents_(&pool_)
+    , depth_(0)
+{
+}
+
+bool cmd_session_t::execute(
+    const std::string& expr,
+    cmd_output_t* cmd_out,
+    cmd_baton_t user)
+{
+    assert(cmd_out);
+    cmd_output_t& out = *cmd_out;
+    // aquire the output guard
+    const auto guard = out.guard();
+    // per command storage comes from the arena, so the guard must outlive it
+    const depth_guard_t depth(depth_, arena_);
+    std::pmr::string cmd(&arena_);
+    cmd_tokens_t tokens(&idents_, this, &arena_);
+    size_t ix = 0;
+    bool ok = true;
+    for (bool active = true; active && ok;) {
+        active = split_next(expr, ix, cmd);
+        // execute single command, a parallel group or a background job
+        if (!cmd.empty()) {
+            const bool background = strip_background(cmd);
+            if (!background && cmd.find("&&") != cmd.npos) {
+                ok = execute_group(cmd, out, user);
+            } else if (!(background ? execute_background(cmd, out, user) : execute_imp(cmd, tokens, cmd_out, user))) {
+                cmd_locale_t::command_failed(out, cmd.c_str());
+                ok = false;
+            }
+        }
+    }
+    // report jobs that finished, as a shell does before its next prompt
+    if (depth_ == 1) {
+        jobs_.reap(out);
+    }
+    // write out everything the command produced in one go
+    out.flush();
+    return ok;
+}
+
+#if CMD_COROUTINES
+cmd_task_t cmd_session_t::execute_async(
+    std::string expr,
+    cmd_output_t* cmd_out,
+    cmd_baton_t user)
+{
+    assert(cmd_out);
+    cmd_output_t& out = *cmd_out;
+    size_t ix = 0;
+    std::pmr::string cmd;
+    bool ok = true;
+    for (bool active = true; active && ok;) {
+        active = split_next(expr, ix, cmd);
+        if (cmd.empty()) {
+            continue;
+        }
+        const bool background = strip_background(cmd);
+        if (!background && cmd.find("&&") != cmd.npos) {
+            ok = execute_group(cmd, out, user);
+            continue;
+        }
+        bool done = false;
+        if (background) {
+            done = execute_background(cmd, out, user);
+        } else {
+            uint64_t lap[cmd_metrics_t::e_phases] = { 0 };
+            cmd_tokens_t tokens(&idents_, this);
+            cmd_t* target = resolve(cmd, tokens, out, lap);
+            if (target) {
+#if CMD_STATS
+                // includes any time spent suspended
+                stopwatch_t watch;
+#endif
+                if (!tokens.tokens.empty() && tokens.tokens.back() == "?") {
+                    done = target->on_usage(out, user);
+                } else {
+                    done = co_await target->on_execute_async(tokens, out, user);
+                }
+#if CMD_STATS
+                lap[cmd_metrics_t::e_execute] = watch.lap();
+                target->metrics_.record(lap, done);
+#endif
+            }
+        }
+        if (!done) {
+            cmd_locale_t::command_failed(out, cmd.c_str());
+            ok = false;
+        }
+    }
+    jobs_.reap(out);
+    out.flush();
+    co_return ok;
+}
+#endif
+
+bool cmd_session_t::execute_imp(
+    const std::string_view& expr,
+    cmd_tokens_t& tokens,
+    cmd_output_t* cmd_out,
+    cmd_baton_t user)
+{
+    assert(cmd_out);
+    cmd_output_t& out = *cmd_out;
+    uint64_t lap[cmd_metrics_t::e_phases] = { 0 };
+    cmd_t* cmd = resolve(expr, tokens, out, lap);
+    return cmd ? invoke(cmd, tokens, out, user, lap) : false;
+}
+
+bool cmd_session_t::execute_background(
+    const std::string_view& view,
+    cmd_output_t& out,
+    cmd_baton_t user)
+{
+    const std::string expr(view);
+    if (expr.find("&&") != expr.npos) {
+        cmd_locale_t::not_background(out, expr.c_str());
+        return false;
+    }
+    std::shared_ptr<cmd_job_t> job(new cmd_job_t(jobs_.next_id(), expr, &idents_, this));
+    uint64_t lap[cmd_metrics_t::e_phases] = { 0 };
+    // resolve here as history and identifiers are not safe to touch from
+    // the job, any failure to find the command is reported immediately
+    cmd_t* cmd = resolve(expr, job->tokens_, out, lap);
+    if (!cmd) {
+        return false;
+    }
+    if (!cmd->parallel_) {
+        cmd_locale_t::not_background(out, expr.c_str());
+        return false;
+    }
+    job->out_->set_record_format(out.record_format());
+    *job->out_->indent_ptr() = *out.indent_ptr();
+    parser_.job_pool().submit([this, job, cmd, user, lap]() mutable {
+        // a job killed while waiting for a worker is already done, and its
+        // session may be gone
+        if (job->start()) {
+            job->finish(invoke(cmd, job->tokens_, *job->out_, user, lap));
+        }
+    });
+    const uint32_t id = job->id_;
+    jobs_.add(std::move(job));
+    cmd_locale_t::job_started(out, id);
+    return true;
+}
+
+bool cmd_session_t::execute_group(
+    const std::string_view& expr,
+    cmd_output_t& out,
+    cmd_baton_t user)
+{
+    const std::string_view delimiter = "&&";
+    std::vector<std::unique_ptr<group_job_t>> jobs;
+    for (size_t ix = 0; ix <= expr.size();) {
+        size_t next = expr.find(delimiter, ix);
+        next = (next == expr.npos) ? expr.size() : next;
+        if (next > ix) {
+            jobs.emplace_back(new group_job_t(&idents_, this, expr.substr(ix, next - ix)));
+        }
+        ix = next + delimiter.size();
+    }
+    bool ok = true;
+    size_t written = 0;
+    std::vector<cmd_pool_t::task_t> tasks;
+    // run the pending parallel commands then write out the output of each
+    // command before end, in the order they were given
+    const auto finish = [&](size_t end) {
+        if (!tasks.empty()) {
+            parser_.pool().run(tasks);
+            tasks.clear();
+        }
+        for (; written < end; ++written) {
+            group_job_t& job = *jobs[written];
+            const std::string_view text = job.out_->view();
+            if (!text.empty()) {
+                out.write_raw(text.data(), text.size());
+            }
+            if (!job.ok_) {
+                cmd_locale_t::command_failed(out, job.expr_.c_str());
+                ok = false;
+            }
+        }
+        return ok;
+    };
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        group_job_t* job = jobs[i].get();
+        job->out_->set_record_format(out.record_format());
+        *job->out_->indent_ptr() = *out.indent_ptr();
+        // resolved on this thread as history and identifiers are not safe to
+        // touch from the workers, and only once the commands that may change
+        // them have run
+        job->cmd_ = resolve(job->expr_, job->tokens_, *job->out_, job->lap_);
+        if (job->cmd_ && job->cmd_->parallel_) {
+            tasks.push_back([this, job, user]() {
+                job->ok_ = invoke(job->cmd_, job->tokens_, *job->out_, user, job->lap_);
+            });
+            continue;
+        }
+        // anything else waits for the commands before it and runs in place,
+        // a failure stops the group as it does a ';' list
+        if (!finish(i)) {
+            return false;
+        }
+        if (job->cmd_) {
+            job->ok_ = invoke(job->cmd_, job->tokens_, *job->out_, user, job->lap_);
+        }
+        if (!finish(i + 1)) {
+            return false;
+        }
+    }
+    return finish(jobs.size());
+}
+
+cmd_t* cmd_session_t::resolve(
+    const std::string_view& expr,
+    cmd_tokens_t& tokens,
+    cmd_output_t& out,
+    uint64_t (&lap)[cmd_metrics_t::e_phases])
+{
+#if CMD_STATS
+    stopwatch_t watch;
+#endif
+    // history events and the empty line repeat are read straight out of
+    // the history, which stays put until the line is recorded below
+    std::string_view line = expr;
+    bool recalled = history_.recall(expr, line);
+    if (recalled && line.empty()) {
+        cmd_locale_t::no_history(out, expr);
+        return nullptr;
+    }
+    // tokenize command string
+    if (!recalled && tokens.tokenize(expr.data(), expr.size()) == 0) {
+        if (history_.empty()) {
+            // no commands entered
+            return nullptr;
+        }
+        // repeat the previous command
+        line = history_.back();
+        recalled = true;
+    }
+    if (recalled) {
+        out.println("> %s", line.data());
+        tokens.tokenize(line.data(), line.size());
+    }
+#if CMD_STATS
+    lap[cmd_metrics_t::e_tokenize] = watch.lap();
+#endif
+    bool ambiguous = false;
+    cmd_t* cmd = nullptr;
+    {
+        // the tree is shared so only aliases can change under us
+        const auto lock = parser_.read_lock();
+        cmd = parser_.frozen_ ? parser_.dispatch_frozen(tokens, out, ambiguous) : parser_.dispatch(tokens, out, ambiguous);
+    }
+#if CMD_STATS
+    lap[cmd_metrics_t::e_dispatch] = watch.lap();
+#endif
+    // add to history buffer
+    history_.push(line);
+    if (!cmd) {
+        if (parser_.parent_) {
+            //XXX: we need to pass the entire thing to the parent ??
+        }
+//      else {
+            cmd_locale_t::invalid_command(out);
+            if (!ambiguous) {
+                parser_.suggest(tokens, out);
+            }
+//      }
+#if CMD_STATS
+        parser_.unmatched_.record(lap, false);
+#endif
+    }
+#if !CMD_STATS
+    (void)lap;
+#endif
+    return cmd;
+}
+
+bool cmd_session_t::invoke(
+    cmd_t* cmd,
+    cmd_tokens_t& tokens,
+    cmd_output_t& out,
+    cmd_baton_t user,
+    uint64_t (&lap)[cmd_metrics_t::e_phases])
+{
+    assert(cmd);
+#if CMD_STATS
+    stopwatch_t watch;
+#endif
+    bool ok;
+    if (!tokens.tokens.empty() && tokens.tokens.back() == "?") {
+        ok = cmd->on_usage(out, user);
+    } else {
+        ok = cmd->on_execute(tokens, out, user);
+    }
+#if CMD_STATS
+    lap[cmd_metrics_t::e_execute] = watch.lap();
+    cmd->metrics_.record(lap, ok);
+#else
+    (void)lap;
+#endif
+    return ok;
+}
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- cmd_parser_t
+
+size_t cmd_parser_t::stats_collect(std::vector<const cmd_t*>& out) const
+{
+#if CMD_STATS
+    const size_t start = out.size();
+    collect_stats(sub_, out);
+    return out.size() - start;
+#else
+    (void)out;
+    return 0;
+#endif
+}
+
+void cmd_parser_t::stats_clear()
+{
+#if CMD_STATS
+    clear_stats(sub_);
+    unmatched_.clear();
+#endif
+}
+
+void cmd_parser_t::suggest(const cmd_tokens_t& tokens, cmd_output_t& out)
+{
+    // commands are at most a few tokens deep so try each leading run of
+    // tokens as a command path, keeping the best distance for each command
+    static const size_t max_tokens = 4;
+    static const size_t max_results = 4;
+    const std::shared_ptr<const cmd_fuzzy_t> shared = fuzzy_shared();
+    const cmd_fuzzy_t& index = *shared;
+    std::vector<cmd_fuzzy_t::match_t> found, best;
+    std::string key;
+    for (size_t i = 0; i < tokens.tokens.size() && i < max_tokens; ++i) {
+        if (i) {
+            key.append(1, ' ');
+        }
+        key.append(tokens.tokens.tokens_[i].get());
+        found.clear();
+        index.nearest(key, max_results, FUZZYNESS - 1, found);
+        for (const auto& match : found) {
+            auto itt = std::find_if(best.begin(), best.end(), [&](const cmd_fuzzy_t::match_t& m) {
+                return m.ordinal_ == match.ordinal_;
+            });
+            if (itt == best.end()) {
+                best.push_back(match);
+            } else if (match.distance_ < itt->distance_) {
+                *itt = match;
+            }
+        }
+    }
+    if (best.empty()) {
+        return;
+    }
+    std::sort(best.begin(), best.end(), [](const cmd_fuzzy_t::match_t& a, const cmd_fuzzy_t::match_t& b) {
+        return a.distance_ != b.distance_ ? a.distance_ < b.distance_ : a.ordinal_ < b.ordinal_;
+    });
+    best.resize(std::min(best.size(), max_results));
+    cmd_locale_t::did_you_meen(out);
+    auto indent = out.indent();
+    for (const auto& match : best) {
+        out.println("%s", match.key_.data());
+    }
+}
+
+std::shared_ptr<const cmd_fuzzy_t> cmd_parser_t::fuzzy_shared()
+{
+    std::lock_guard<std::mutex> guard(fuzzy_mux_);
+    if (!fuzzy_ || fuzzy_generation_ != generation_) {
+        // the generation can not change while the aliases are read locked
+        const auto lock = read_lock();
+        std::shared_ptr<cmd_fuzzy_t> index(new cmd_fuzzy_t);
+        index->build(sub_, alias_);
+        fuzzy_ = std::move(index);
+        fuzzy_generation_ = generation_;
+    }
+    return fuzzy_;
+}
+
+cmd_t* cmd_parser_t::dispatch(cmd_tokens_t& tokens, cmd_output_t& out, bool& ambiguous)
+{
+    const cmd_index_t* index = &index_;
+    // reused between calls so that dispatch does not allocate
+    thread_local std::vector<cmd_t*> cmd_vec;
+    // check for aliases
+    cmd_t* cmd = alias_find(tokens.tokens.front().get());
+    if (cmd) {
+        tokens.tokens.pop();
+        index = &(cmd->index_);
+    }
+    while (!tokens.tokens.empty()) {
+        // find best matching sub command
+        cmd_vec.clear();
+        index->find(tokens.tokens.front().get(), cmd_vec);
+        if (cmd_vec.size() == 0) {
+            // no sub commands to match
+            break;
+        } else if (cmd_vec.size() == 1) {
+            cmd = cmd_vec.front();
+            index = &cmd->index_;
+            // remove front item
+            tokens.tokens.pop();
+        } else {
+            // ambiguous matches (show possible matches)
+            cmd = nullptr;
+            ambiguous = true;
+            cmd_locale_t::possible_completions(out);
+            auto indent = out.indent(4);
+            for (auto c : cmd_vec) {
+                out.println("%s", c->name_);
+            }
+            break;
+        }
+    }
+    return cmd;
+}
+
+cmd_t* cmd_parser_t::dispatch_frozen(cmd_tokens_t& tokens, cmd_output_t& out, bool& ambiguous)
+{
+    assert(frozen_);
+    const cmd_frozen_t& tree = *frozen_;
+    uint32_t node = cmd_frozen_t::npos;
+    // reused between calls so that dispatch does not allocate
+    thread_local std::vector<uint32_t> node_vec;
+    // check for aliases
+    cmd_t* cmd = nullptr;
+    const uint32_t alias = tree.alias_find(tokens.tokens.front().get());
+    if (alias != cmd_frozen_t::npos) {
+        tokens.tokens.pop();
+        node = alias;
+        cmd = tree.cmd(node);
+    }
+    while (!tokens.tokens.empty()) {
+        // find best matching sub command
+        node_vec.clear();
+        tree.find(node, tokens.tokens.front().get(), node_vec);
+        if (node_vec.size() == 0) {
+            // no sub commands to match
+            break;
+        } else if (node_vec.size() == 1) {
+            node = node_vec.front();
+            cmd = tree.cmd(node);
+            // remove front item
+            tokens.tokens.pop();
+        } else {
+            // ambiguous matches (show possible matches)
+            cmd = nullptr;
+            ambiguous = true;
+            cmd_locale_t::possible_completions(out);
+            auto indent = out.indent(4);
+            for (const uint32_t n : node_vec) {
+                out.println("%s", tree.name(n).data());
+            }
+            break;
+        }
+    }
+    return cmd;
+}
+
+cmd_pool_t& cmd_parser_t::pool()
+{
+    std::lock_guard<std::mutex> guard(pool_mux_);
+    if (!pool_) {
+        pool_.reset(new cmd_pool_t(std::thread::hardware_concurrency()));
+    }
+    return *pool_;
+}
+
+cmd_pool_t& cmd_parser_t::job_pool()
+{
+    std::lock_guard<std::mutex> guard(pool_mux_);
+    if (!job_pool_) {
+        job_pool_.reset(new cmd_pool_t(std::thread::hardware_concurrency()));
+    }
+    return *job_pool_;
+}
+
+std::unique_ptr<cmd_prepared_t> cmd_parser_t::prepare(const std::string& expr)
+{
+    std::unique_ptr<cmd_prepared_t> prepared(new cmd_prepared_t(*this, expr));
+    if (!prepared->valid()) {
+        prepared.reset();
+    }
+    return prepared;
+}
+
+void cmd_parser_t::freeze()
+{
+    std::unique_lock<std::shared_mutex> lock(mux_);
+    frozen_.reset(new cmd_frozen_t);
+    frozen_->build(sub_, alias_);
+}
+
+bool cmd_parser_t::alias_add(cmd_t* cmd, const std::string& alias)
+{
+    assert(cmd && !alias.empty());
+    std::unique_lock<std::shared_mutex> lock(mux_);
+    alias_[alias] = cmd;
+    ++generation_;
+    if (frozen_) {
+        frozen_->build_alias(alias_);
+    }
+    return true;
+}
+
+bool cmd_parser_t::alias_remove(const std::string& alias)
+{
+    std::unique_lock<std::shared_mutex> lock(mux_);
+    auto itt = alias_.find(alias);
+    if (itt != alias_.end()) {
+        alias_.erase(itt);
+        ++generation_;
+        if (frozen_) {
+            frozen_->build_alias(alias_);
+        }
+        return true;
+    } else {
+        return false;
+    }
+}
+
+bool cmd_parser_t::alias_remove(const cmd_t* cmd)
+{
+    std::unique_lock<std::shared_mutex> lock(mux_);
+    for (auto itt = alias_.begin(); itt != alias_.end();) {
+        assert(itt->second);
+        if (itt->second == cmd) {
+            itt = alias_.erase(itt);
+            ++generation_;
+        } else {
+            ++itt;
+        }
+    }
+    if (frozen_) {
+        frozen_->build_alias(alias_);
+    }
+    return true;
+}
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- cmd_prepared_t
+
+cmd_prepared_t::cmd_prepared_t(cmd_parser_t& parser, const std::string& expr)
+    : parser_(parser)
+    , expr_(expr)
+    , generation_(0)
+    , cmd_(nullptr)
+    , idents_(nullptr)
+    , epoch_(0)
+    , tokens_(nullptr)
+{
+    resolve();
+}
+
+bool cmd_prepared_t::resolve()
+{
+    cmd_ = nullptr;
+    generation_ = parser_.generation_;
+    args_.clear();
+    slots_.clear();
+    holes_.clear();
+    // tokenize without substitution so identifiers are read on execution
+    cmd_tokens_t tokens(nullptr);
+    if (tokens.tokenize(expr_.c_str(), expr_.size()) == 0) {
+        return false;
+    }
+    // ambiguous matches are not reported while preparing
+    std::unique_ptr<cmd_output_t> dummy(cmd_output_t::create_output_dummy());
+    bool ambiguous = false;
+    cmd_t* cmd = nullptr;
+    {
+        const auto lock = parser_.read_lock();
+        cmd = parser_.frozen_ ? parser_.dispatch_frozen(tokens, *dummy, ambiguous) : parser_.dispatch(tokens, *dummy, ambiguous);
+    }
+    if (!cmd) {
+        return false;
+    }
+    // everything left in the raw token list is an argument
+    for (const cmd_token_t& token : tokens.tokens.raw_) {
+        if (token == "?") {
+            holes_.push_back(args_.size());
+        }
+        args_.emplace_back(token.view());
+    }
+    // slots are looked up again on the next execution
+    idents_ = nullptr;
+    subst_.resize(args_.size());
+    // keep existing bindings when resolving again
+    bound_.resize(holes_.size());
+    is_bound_.resize(holes_.size(), false);
+    cmd_ = cmd;
+    return true;
+}
+
+void cmd_prepared_t::reset_slots(const cmd_idents_t& idents)
+{
+    slots_.assign(args_.size(), cmd_idents_t::npos);
+    idents_ = &idents;
+    epoch_ = idents.epoch();
+}
+
+bool cmd_prepared_t::bind(size_t index, uint64_t value)
+{
+    if (index >= holes_.size()) {
+        return false;
+    }
+    // format into the existing string to reuse its storage
+    std::array<char, 24> temp;
+    const char* end = cmd_format_t::to_chars(temp.data(), value, 10);
+    bound_[index].assign(temp.data(), size_t(end - temp.data()));
+    is_bound_[index] = true;
+    return true;
+}
+
+bool cmd_prepared_t::bind(size_t index, const std::string_view& value)
+{
+    if (index >= holes_.size()) {
+        return false;
+    }
+    bound_[index].assign(value.data(), value.size());
+    is_bound_[index] = true;
+    return true;
+}
+
+bool cmd_prepared_t::execute(cmd_output_t* cmd_out, cmd_baton_t user)
+{
+    return execute(parser_.session_, cmd_out, user);
+}
+
+bool cmd_prepared_t::execute(cmd_session_t& session, cmd_output_t* cmd_out, cmd_baton_t user)
+{
+    assert(cmd_out && &session.parser_ == &parser_);
+    cmd_output_t& out = *cmd_out;
+    // aquire the output guard
+    const auto guard = out.guard();
+#if CMD_STATS
+    stopwatch_t watch;
+#endif
+    if (!valid() && !resolve()) {
+        cmd_locale_t::invalid_command(out);
+        return out.flush(), false;
+    }
+    const cmd_idents_t& idents = session.idents_;
+    if (idents_ != &idents || epoch_ != idents.epoch()) {
+        // another session, or the identifiers were renumbered since
+        reset_slots(idents);
+    }
+    // assemble the argument list
+    views_.clear();
+    size_t hole = 0;
+    uint64_t value = 0;
+    for (size_t i = 0; i < args_.size(); ++i) {
+        if (hole < holes_.size() && holes_[hole] == i) {
+            if (!is_bound_[hole]) {
+                cmd_locale_t::unbound_placeholder(out, uint32_t(hole));
+                return out.flush(), false;
+            }
+            views_.push_back(bound_[hole++]);
+            continue;
+        }
+        if (slots_[i] == cmd_idents_t::npos && args_[i][0] == '$') {
+            // names that are only read are not interned, so look again
+            // until the name is given a slot
+            slots_[i] = idents.slot(std::string_view(args_[i]).substr(1));
+        }
+        if (idents.get(slots_[i], value)) {
+            // substitute the identifier value
+            std::array<char, 24> temp;
+            const char* end = cmd_format_t::to_chars(temp.data(), value, 10);
+            subst_[i].assign(temp.data(), size_t(end - temp.data()));
+            views_.push_back(subst_[i]);
+        } else {
+            views_.push_back(args_[i]);
+        }
+    }
+    tokens_.tokenize(views_);
+    tokens_.set_session(&session);
+    uint64_t lap[cmd_metrics_t::e_phases] = { 0 };
+#if CMD_STATS
+    // dispatch was done when the command was prepared
+    lap[cmd_metrics_t::e_tokenize] = watch.lap();
+#endif
+    const bool ok = session.invoke(cmd_, tokens_, out, user, lap);
+    out.flush();
+    return ok;
+}
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- cmd_t
+
+#if CMD_COROUTINES
+cmd_task_t cmd_t::on_execute_async(cmd_tokens_t& tok, cmd_output_t& out, cmd_baton_t user)
+{
+    co_return on_execute(tok, out, user);
+}
+#endif
+
+bool cmd_t::on_execute(cmd_tokens_t& tok, cmd_output_t& out, cmd_baton_t user)
+{
+    (void)user;
+    const bool have_subcomands = !sub_.empty();
+    if (!have_subcomands) {
+        // an empty terminal cmd is a bit weird
+        return false;
+    }
+    const bool have_tokens = !tok.tokens.empty();
+    if (have_tokens) {
+        const char* tok_front = tok.tokens.front().c_str();
+        // the distance between two paths that share a prefix is the
+        // distance between their final names, so query using our own path
+        std::string key;
+        get_command_path(key);
+        key.append(1, ' ');
+        key.append(tok_front);
+        std::vector<cmd_fuzzy_t::match_t> list;
+        parser_.fuzzy_shared()->find(key, FUZZYNESS - 1, list);
+        // only our own sub commands are of interest
+        list.erase(std::remove_if(list.begin(), list.end(), [this](const cmd_fuzzy_t::match_t& match) {
+            return match.alias_ || match.cmd_->parent_ != this;
+        }),
+            list.end());
+        cmd_locale_t::no_subcommand(out, tok_front);
+        if (!list.empty()) {
+            cmd_locale_t::did_you_meen(out);
+            auto indent = out.indent();
+            for (const auto& match : list) {
+                out.println("%s", match.cmd_->name_);
+            }
+        }
+    } else {
+        print_sub_commands(out);
+    }
+    return true;
+};
+
+void cmd_t::on_tree_changed()
+{
+    parser_.invalidate();
+}
+
+bool cmd_t::alias_add(const std::string& name)
+{
+    return parser_.alias_add(this, name);
+}
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- cmd_output_t
+
+namespace {
+// print through the virtual interface, bypassing record formatting
+void raw_print(cmd_output_t& out, const char* fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    out.print(false, fmt, args);
+    va_end(args);
+}
+} // namespace {}
+
+void cmd_output_t::write_raw(const char* data, size_t size)
+{
+    // %.*s stops at a zero byte so write those separately
+    while (size) {
+        const char* zero = (const char*)memchr(data, '\0', size);
+        const size_t len = zero ? size_t(zero - data) : size;
+        if (len) {
+            raw_print(*this, "%.*s", int(len), data);
+        }
+        if (!zero) {
+            break;
+        }
+        raw_print(*this, "%c", 0);
+        data += len + 1;
+        size -= len + 1;
+    }
+}
+
+void cmd_output_t::text_record(const char* fmt, va_list& args)
+{
+    thread_local std::string text;
+    va_list copy;
+    va_copy(copy, args);
+    const int len = vsnprintf(nullptr, 0, fmt, copy);
+    va_end(copy);
+    text.resize(len > 0 ? size_t(len) + 1 : 1);
+    if (len > 0) {
+        vsnprintf(&text[0], text.size(), fmt, args);
+    }
+    text_record(std::string_view(text.data(), len > 0 ? size_t(len) : 0));
+}
+
+void cmd_output_t::text_record(const std::string_view& text)
+{
+    cmd_record_t(*this, "text").field("text", text);
+}
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- cmd_format_t
+
+char* cmd_format_t::to_chars(char* out, uint64_t value, int base)
+{
+    return std::to_chars(out, out + 24, value, base).ptr;
+}
+
+char* cmd_format_t::to_chars(char* out, int64_t value, int base)
+{
+    return std::to_chars(out, out + 24, value, base).ptr;
+}
+
+void cmd_format_t::append(std::string& out, const hex_t& hex)
+{
+    char temp[24];
+    const char* end = to_chars(temp, hex.value_, 16);
+    const size_t len = size_t(end - temp);
+    out.append("0x");
+    if (len < hex.width_) {
+        out.append(hex.width_ - len, '0');
+    }
+    out.append(temp, len);
+}
+
+void cmd_format_t::append(std::string& out, const dec_t& dec)
+{
+    char temp[24];
+    char* digits = temp;
+    const bool neg = dec.value_ < 0;
+    // zero fill goes between the sign and the digits like printf
+    if (neg && dec.fill_ == '0') {
+        out.push_back('-');
+    }
+    const char* end = (neg && dec.fill_ == '0')
+        ? to_chars(digits, uint64_t(0) - uint64_t(dec.value_), 10)
+        : to_chars(digits, dec.value_, 10);
+    const size_t len = size_t(end - digits) + ((neg && dec.fill_ == '0') ? 1 : 0);
+    if (len < dec.width_) {
+        out.append(dec.width_ - len, dec.fill_);
+    }
+    out.append(digits, size_t(end - digits));
+}
+
+void cmd_format_t::append(std::string& out, const pad_t& pad)
+{
+    const size_t width = size_t(pad.width_ < 0 ? -pad.width_ : pad.width_);
+    const size_t fill = pad.str_.size() < width ? width - pad.str_.size() : 0;
+    if (pad.width_ > 0) {
+        out.append(fill, ' ');
+    }
+    out.append(pad.str_.data(), pad.str_.size());
+    if (pad.width_ < 0) {
+        out.append(fill, ' ');
+    }
+}
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- cmd_record_t
+
+namespace {
+std::string& record_scratch()
+{
+    thread_local std::string scratch;
+    return scratch;
+}
+
+void json_escape(std::string& out, const std::string_view& str)
+{
+    static const char hex[] = "0123456789abcdef";
+    out.push_back('"');
+    for (const char ch : str) {
+        switch (ch) {
+        case '"':
+            out.append("\\\"");
+            break;
+        case '\\':
+            out.append("\\\\");
+            break;
+        case '\n':
+            out.append("\\n");
+            break;
+        case '\t':
+            out.append("\\t");
+            break;
+        default:
+            if (uint8_t(ch) < 0x20) {
+                out.append("\\u00");
+                out.push_back(hex[uint8_t(ch) >> 4]);
+                out.push_back(hex[uint8_t(ch) & 15]);
+            } else {
+                out.push_back(ch);
+            }
+        }
+    }
+    out.push_back('"');
+}
+} // namespace {}
+
+cmd_record_t::cmd_record_t(cmd_output_t& out, const char* type)
+    : out_(out)
+    , buf_(record_scratch())
+    , format_(out.record_format())
+    , first_(true)
+    , in_list_(false)
+    , done_(false)
+    , key_(nullptr)
+{
+    buf_.clear();
+    switch (format_) {
+    case cmd_output_t::e_binary:
+        // space for the payload size
+        buf_.append(4, '\0');
+        put_varint(strlen(type));
+        buf_.append(type);
+        break;
+    default:
+        buf_.append("{\"type\":");
+        json_escape(buf_, type);
+        first_ = false;
+        break;
+    }
+}
+
+void cmd_record_t::key(const char* key)
+{
+    assert(!in_list_);
+    if (format_ == cmd_output_t::e_binary) {
+        key_ = key;
+        return;
+    }
+    separator();
+    json_escape(buf_, key);
+    buf_.push_back(':');
+}
+
+void cmd_record_t::separator()
+{
+    if (format_ != cmd_output_t::e_binary) {
+        if (!first_) {
+            buf_.push_back(',');
+        }
+        first_ = false;
+    }
+}
+
+void cmd_record_t::put_varint(uint64_t value)
+{
+    while (value >= 0x80) {
+        buf_.push_back(char(uint8_t(value) | 0x80));
+        value >>= 7;
+    }
+    buf_.push_back(char(value));
+}
+
+// write a binary entry tag and the key that goes with it
+#define CMD_RECORD_TAG(TAG)                      \
+    if (format_ == cmd_output_t::e_binary) {     \
+        buf_.push_back(char(TAG));               \
+        if (key_) {                              \
+            const size_t len = strlen(key_);     \
+            put_varint(len);                     \
+            buf_.append(key_, len);              \
+            key_ = nullptr;                      \
+        }                                        \
+    }
+
+void cmd_record_t::put_uint(uint64_t value)
+{
+    CMD_RECORD_TAG(e_tag_uint);
+    if (format_ == cmd_output_t::e_binary) {
+        return put_varint(value);
+    }
+    char temp[24];
+    const auto res = std::to_chars(temp, temp + sizeof(temp), value);
+    buf_.append(temp, res.ptr);
+}
+
+void cmd_record_t::put_int(int64_t value)
+{
+    CMD_RECORD_TAG(e_tag_int);
+    if (format_ == cmd_output_t::e_binary) {
+        return put_varint((uint64_t(value) << 1) ^ uint64_t(value >> 63));
+    }
+    char temp[24];
+    const auto res = std::to_chars(temp, temp + sizeof(temp), value);
+    buf_.append(temp, res.ptr);
+}
+
+void cmd_record_t::put_str(const std::string_view& value)
+{
+    CMD_RECORD_TAG(e_tag_str);
+    if (format_ == cmd_output_t::e_binary) {
+        put_varint(value.size());
+        buf_.append(value.data(), value.size());
+        return;
+    }
+    json_escape(buf_, value);
+}
+
+cmd_record_t& cmd_record_t::list(const char* key)
+{
+    this->key(key);
+    CMD_RECORD_TAG(e_tag_list);
+    if (format_ != cmd_output_t::e_binary) {
+        buf_.push_back('[');
+        first_ = true;
+    }
+    in_list_ = true;
+    return *this;
+}
+
+#undef CMD_RECORD_TAG
+
+cmd_record_t& cmd_record_t::list_end()
+{
+    assert(in_list_);
+    if (format_ == cmd_output_t::e_binary) {
+        buf_.push_back(char(e_tag_list_end));
+    } else {
+        buf_.push_back(']');
+        first_ = false;
+    }
+    in_list_ = false;
+    return *this;
+}
+
+void cmd_record_t::end()
+{
+    if (done_) {
+        return;
+    }
+    done_ = true;
+    if (in_list_) {
+        list_end();
+    }
+    if (format_ == cmd_output_t::e_binary) {
+        const uint32_t size = uint32_t(buf_.size() - 4);
+        for (uint32_t i = 0; i < 4; ++i) {
+            buf_[i] = char(uint8_t(size >> (i * 8)));
+        }
+    } else {
+        buf_.append("}\n");
+    }
+    out_.write_raw(buf_.data(), buf_.size());
+}
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- cmd_output_buffer_t
+
+void cmd_output_buffer_t::print(bool ind, const char* fmt, va_list& args)
+{
+    std::lock_guard<std::recursive_mutex> guard(mux_);
+    emit(ind, fmt, args, false);
+}
+
+void cmd_output_buffer_t::println(bool ind, const char* fmt, va_list& args)
+{
+    std::lock_guard<std::recursive_mutex> guard(mux_);
+    emit(ind, fmt, args, true);
+}
+
+void cmd_output_buffer_t::eol()
+{
+    std::lock_guard<std::recursive_mutex> guard(mux_);
+    append('\n');
+}
+
+void cmd_output_buffer_t::append(const char* str, size_t len)
+{
+    reserve(len);
+    memcpy(buffer_.data() + size_, str, len);
+    size_ += len;
+}
+
+void cmd_output_buffer_t::format(const char* fmt, va_list& args)
+{
+    // fast paths for plain strings which make up most listings
+    if (strchr(fmt, '%') == nullptr) {
+        return append(fmt, strlen(fmt));
+    }
+    if (strcmp(fmt, "%s") == 0) {
+        const char* str = va_arg(args, const char*);
+        return append(str, strlen(str));
+    }
+    va_list copy;
+    va_copy(copy, args);
+    const size_t room = buffer_.size() - size_;
+    const int len = vsnprintf(buffer_.data() + size_, room, fmt, copy);
+    va_end(copy);
+    if (len < 0) {
+        return;
+    }
+    if (size_t(len) >= room) {
+        // vsnprintf needs space for the terminator
+        reserve(size_t(len) + 1);
+        vsnprintf(buffer_.data() + size_, size_t(len) + 1, fmt, args);
+    }
+    size_ += size_t(len);
+}
+
+void cmd_output_buffer_t::indent_apply()
+{
+    reserve(indent_);
+    memset(buffer_.data() + size_, ' ', indent_);
+    size_ += indent_;
+}
+
+void cmd_output_buffer_t::write_raw(const char* data, size_t size)
+{
+    std::lock_guard<std::recursive_mutex> guard(mux_);
+    append(data, size);
+}
+
+cmd_output_buffer_t* cmd_output_t::create_output_buffer()
+{
+    return new cmd_output_buffer_t;
+}
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- cmd_output_stdio_t
+
+struct cmd_output_stdio_t : public cmd_output_buffer_t {
+
+    // buffered output is written once this much has accumulated
+    static const size_t capacity = 64 * 1024;
+
+    cmd_output_stdio_t(FILE* fd)
+        : cmd_output_buffer_t(capacity + 1024)
+        , fd_(fd)
+    {
+    }
+
+    virtual ~cmd_output_stdio_t()
+    {
+        flush();
+    }
+
+    virtual void print(bool ind, const char* fmt, va_list& args) override
+    {
+        std::lock_guard<std::recursive_mutex> guard(mux_);
+        emit(ind, fmt, args, false);
+        drain();
+    }
+
+    virtual void println(bool ind, const char* fmt, va_list& args) override
+    {
+        std::lock_guard<std::recursive_mutex> guard(mux_);
+        emit(ind, fmt, args, true);
+        drain();
+    }
+
+    virtual void eol() override
+    {
+        std::lock_guard<std::recursive_mutex> guard(mux_);
+        append('\n');
+        drain();
+    }
+
+    virtual void flush() override
+    {
+        std::lock_guard<std::recursive_mutex> guard(mux_);
+        write();
+        fflush(fd_);
+    }
+
+protected:
+    FILE* fd_;
+
+    virtual void write_raw(const char* data, size_t size) override
+    {
+        std::lock_guard<std::recursive_mutex> guard(mux_);
+        append(data, size);
+        drain();
+    }
+
+    // write out the buffer once it is full
+    void drain()
+    {
+        if (size_ >= capacity) {
+            write();
+        }
+    }
+
+    void write()
+    {
+        if (size_) {
+            fwrite(buffer_.data(), 1, size_, fd_);
+            reset();
+        }
+    }
+};
+
+cmd_output_t* cmd_output_t::create_output_stdio(FILE* fd)
+{
+    return new cmd_output_stdio_t(fd);
+}
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- cmd_output_async_t
+
+struct cmd_output_async_t : public cmd_output_t {
+
+    cmd_output_async_t(FILE* fd, size_t capacity, overflow_t overflow)
+        : cmd_output_t()
+        , fd_(fd)
+        , overflow_(overflow)
+        , id_(next_id())
+        , alive_(std::make_shared<const uint64_t>(id_))
+        , slots_(ring_size(capacity))
+        , mask_(slots_.size() - 1)
+        , head_(0)
+        , tail_(0)
+        , dropped_(0)
+        , sleeping_(false)
+        , stop_(false)
+    {
+        for (size_t i = 0; i < slots_.size(); ++i) {
+            slots_[i].seq_.store(i, std::memory_order_relaxed);
+        }
+        writer_ = std::thread([this]() { run(); });
+    }
+
+    virtual ~cmd_output_async_t()
+    {
+        flush();
+        stop_.store(true, std::memory_order_release);
+        wake(true);
+        writer_.join();
+    }
+
+    virtual void lock() override
+    {
+    }
+
+    virtual void unlock() override
+    {
+    }
+
+    virtual void print(bool ind, const char* fmt, va_list& args) override
+    {
+        state_t& state = local();
+        ind ? indent_apply(state) : (void)0;
+        format(state.line_, fmt, args);
+    }
+
+    virtual void println(bool ind, const char* fmt, va_list& args) override
+    {
+        state_t& state = local();
+        ind ? indent_apply(state) : (void)0;
+        format(state.line_, fmt, args);
+        state.line_.push_back('\n');
+        push(state.line_);
+    }
+
+    virtual void eol() override
+    {
+        state_t& state = local();
+        state.line_.push_back('\n');
+        push(state.line_);
+    }
+
+    virtual void flush() override
+    {
+        state_t& state = local();
+        if (!state.line_.empty()) {
+            push(state.line_);
+        }
+        wake(false);
+    }
+
+protected:
+    // per thread output state, owned by the instance so it goes with it
+    struct state_t {
+        uint32_t indent_;
+        std::string line_;
+    };
+
+    // a threads pointer to its state in one instance
+    struct local_t {
+        uint64_t owner_;
+        // expires with the instance
+        std::weak_ptr<const uint64_t> alive_;
+        state_t* state_;
+    };
+
+    // ring slot, seq_ tracks whether the slot is free or holds a record
+    struct slot_t {
+        std::atomic<size_t> seq_;
+        std::string text_;
+    };
+
+    FILE* fd_;
+    const overflow_t overflow_;
+    // unique id so that per thread state is never confused between instances
+    const uint64_t id_;
+    std::shared_ptr<const uint64_t> alive_;
+    // state of every thread that has written to this instance
+    std::mutex states_mux_;
+    std::vector<std::unique_ptr<state_t>> states_;
+    std::vector<slot_t> slots_;
+    const size_t mask_;
+    alignas(64) std::atomic<size_t> head_;
+    // only touched by the writer thread
+    alignas(64) size_t tail_;
+    std::atomic<uint64_t> dropped_;
+    std::atomic<bool> sleeping_;
+    std::atomic<bool> stop_;
+    std::mutex mux_;
+    std::condition_variable cv_;
+    std::thread writer_;
+
+    static uint64_t next_id()
+    {
+        static std::atomic<uint64_t> id(0);
+        return ++id;
+    }
+
+    static size_t ring_size(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        return size;
+    }
+
+    virtual uint32_t* indent_ptr() override
+    {
+        return &local().indent_;
+    }
+
+    virtual void write_raw(const char* data, size_t size) override
+    {
+        state_t& state = local();
+        state.line_.append(data, size);
+        push(state.line_);
+    }
+
+    // find the calling threads state for this instance
+    state_t& local()
+    {
+        thread_local std::vector<local_t> locals;
+        for (const local_t& local : locals) {
+            if (local.owner_ == id_) {
+                return *local.state_;
+            }
+        }
+        // first use from this thread, so drop the instances that are gone
+        locals.erase(std::remove_if(locals.begin(), locals.end(), [](const local_t& local) {
+            return local.alive_.expired();
+        }), locals.end());
+        std::lock_guard<std::mutex> guard(states_mux_);
+        states_.emplace_back(new state_t{ indent_, std::string() });
+        locals.push_back(local_t{ id_, alive_, states_.back().get() });
+        return *states_.back();
+    }
+
+    void indent_apply(state_t& state)
+    {
+        state.line_.append(state.indent_, ' ');
+    }
+
+    static void format(std::string& out, const char* fmt, va_list& args)
+    {
+        if (strchr(fmt, '%') == nullptr) {
+            out.append(fmt);
+            return;
+        }
+        if (strcmp(fmt, "%s") == 0) {
+            out.append(va_arg(args, const char*));
+            return;
+        }
+        // format into the spare capacity, growing if it was not enough
+        const size_t size = out.size();
+        out.resize(std::max(out.capacity(), size + 128));
+        va_list copy;
+        va_copy(copy, args);
+        const int len = vsnprintf(&out[size], out.size() - size, fmt, copy);
+        va_end(copy);
+        if (len < 0) {
+            out.resize(size);
+            return;
+        }
+        if (size + size_t(len) >= out.size()) {
+            out.resize(size + size_t(len) + 1);
+            vsnprintf(&out[size], size_t(len) + 1, fmt, args);
+        }
+        out.resize(size + size_t(len));
+    }
+
+    // hand a line to the writer, leaving line empty but with spare capacity
+    void push(std::string& line)
+    {
+        size_t pos = head_.load(std::memory_order_relaxed);
+        slot_t* slot;
+        for (;;) {
+            slot = &slots_[pos & mask_];
+            const size_t seq = slot->seq_.load(std::memory_order_acquire);
+            const intptr_t diff = intptr_t(seq) - intptr_t(pos);
+            if (diff == 0) {
+                if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                // the queue is full
+                if (overflow_ == e_drop) {
+                    dropped_.fetch_add(1, std::memory_order_relaxed);
+                    line.clear();
+                    return;
+                }
+                wake(false);
+                std::this_thread::yield();
+                pos = head_.load(std::memory_order_relaxed);
+            } else {
+                pos = head_.load(std::memory_order_relaxed);
+            }
+        }
+        // swap so that buffers are recycled between producers and the ring
+        slot->text_.swap(line);
+        line.clear();
+        slot->seq_.store(pos + 1, std::memory_order_release);
+        // pairs with the fence in run() so that either the writer sees the
+        // record or we see that it is sleeping
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        wake(false);
+    }
+
+    void wake(bool always)
+    {
+        if (always || sleeping_.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> guard(mux_);
+            cv_.notify_one();
+        }
+    }
+
+    // true if the next record is ready
+    bool ready() const
+    {
+        return slots_[tail_ & mask_].seq_.load(std::memory_order_acquire) == tail_ + 1;
+    }
+
+    // take the next record from the ring if there is one
+    bool pop(std::string& out)
+    {
+        slot_t& slot = slots_[tail_ & mask_];
+        const size_t seq = slot.seq_.load(std::memory_order_acquire);
+        if (seq != tail_ + 1) {
+            return false;
+        }
+        out.append(slot.text_);
+        slot.text_.clear();
+        slot.seq_.store(tail_ + mask_ + 1, std::memory_order_release);
+        ++tail_;
+        return true;
+    }
+
+    // writer thread, batches records into large writes
+    void run()
+    {
+        static const size_t batch = 64 * 1024;
+        std::string buffer;
+        buffer.reserve(batch * 2);
+        for (;;) {
+            while (buffer.size() < batch && pop(buffer)) {
+            }
+            const uint64_t dropped = dropped_.exchange(0, std::memory_order_relaxed);
+            if (dropped) {
+                char note[64];
+                snprintf(note, sizeof(note), "... %llu lines dropped\n", (unsigned long long)dropped);
+                buffer.append(note);
+            }
+            if (!buffer.empty()) {
+                fwrite(buffer.data(), 1, buffer.size(), fd_);
+                buffer.clear();
+                continue;
+            }
+            // the queue is empty
+            fflush(fd_);
+            if (stop_.load(std::memory_order_acquire)) {
+                // producers are gone, so one final check is enough
+                if (!pop(buffer)) {
+                    break;
+                }
+                continue;
+            }
+            std::unique_lock<std::mutex> guard(mux_);
+            sleeping_.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            // recheck once sleeping_ is visible so a push can not be missed
+            if (!ready() && !stop_.load(std::memory_order_acquire)) {
+                cv_.wait(guard);
+            }
+            sleeping_.store(false, std::memory_order_relaxed);
+        }
+        fflush(fd_);
+    }
+};
+
+cmd_output_t* cmd_output_t::create_output_async(FILE* fd, size_t capacity, overflow_t overflow)
+{
+    return new cmd_output_async_t(fd, capacity, overflow);
+}
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- cmd_output_dummy_t
+
+struct cmd_output_dummy_t : public cmd_output_t {
+
+    cmd_output_dummy_t()
+        : cmd_output_t()
+    {
+    }
+
+    virtual void lock() override
+    {
+    }
+
+    virtual void unlock() override
+    {
+    }
+
+    virtual void print(bool ind, const char* fmt, va_list& args) override
+    {
+    }
+
+    virtual void println(bool ind, const char* fmt, va_list& args) override
+    {
+    }
+
+    virtual void eol() override
+    {
+    }
+
+protected:
+    virtual void write_raw(const char*, size_t) override
+    {
+    }
+};
+
+cmd_output_t* cmd_output_t::create_output_dummy()
+{
+    return new cmd_output_dummy_t;
+}
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- cmd_tokens_t
+
+void cmd_tokens_t::clear()
+{
+    tokens.tokens_.clear();
+    tokens.raw_.clear();
+    flags.flags_.clear();
+    pairs.pairs_.clear();
+    stage_flag_ = std::string_view();
+}
+
+void cmd_tokens_t::flush()
+{
+    if (!stage_flag_.empty()) {
+        flags.flags_.insert(stage_flag_);
+        stage_flag_ = std::string_view();
+    }
+}
+
+void cmd_tokens_t::push(const char* str, size_t len)
+{
+    const char EXP_DELIM = '$';
+    assert(str && len);
+    cmd_token_t input(str, len);
+    /* process identifier substitution */
+    if (idents_ && str[0] == EXP_DELIM) {
+        uint64_t val = 0;
+        if (idents_->get(std::string_view(str + 1, len - 1), val)) {
+            // digits fit in the small string buffer so this wont allocate
+            std::array<char, 24> temp;
+            const char* end = cmd_format_t::to_chars(temp.data(), val, 10);
+            input = cmd_token_t(std::string(temp.data(), size_t(end - temp.data())));
+        }
+    }
+    /* add to raw token set */
+    tokens.raw_.push_back(input);
+    /* if we have a flag or switch */
+    if (input.get().find("-") == 0) {
+        flush();
+        stage_flag_ = input.get();
+    } else {
+        if (!stage_flag_.empty()) {
+            pairs.pairs_[stage_flag_] = input;
+            stage_flag_ = std::string_view();
+        } else {
+            tokens.tokens_.push_back(input);
         }
     }
 }
 
 size_t cmd_tokens_t::tokenize(const char* in)
+{
+    assert(in);
+    return tokenize(in, strlen(in));
+}
+
+size_t cmd_tokens_t::tokenize(const std::vector<std::string_view>& in)
+{
+    clear();
+    // lay all tokens out in the line buffer before taking views
+    size_t size = 0;
+    for (const std::string_view& token : in) {
+        size += token.size() + 1;
+    }
+    line_.resize(size + 1);
+    char* dst = line_.data();
+    for (const std::string_view& token : in) {
+        memcpy(dst, token.data(), token.size());
+        dst[token.size()] = '\0';
+        dst += token.size() + 1;
+    }
+    *dst = '\0';
+    const char* src = line_.data();
+    for (const std::string_view& token : in) {
+        if (!token.empty()) {
+            push(src, token.size());
+        }
+        src += token.size() + 1;
+    }
+    // flush tokens
+    flush();
+    // return number of tokens
+    return tokens.size();
+}
+
+size_t cmd_tokens_t::tokenize(const char* in, size_t len)
 {
     const std::array<char, 3> whitespace = { ' ', '\r', '\t' };
     assert(in);
-    const char* src = in;
-    const char* start = src;
+    clear();
+    // take a single copy of the input that all tokens will point into
+    line_.assign(in, in + len);
+    line_.push_back('\0');
+    char* src = line_.data();
+    char* start = src;
     // step over the string
     while (*src) {
         // find for next white space
         if (in_array(*src, whitespace)) {
-            // extract this token
-            push(std::string(start, src));
+            // terminate and extract this token
+            char* end = src;
             // skip trailing white space
             for (; in_array(*src, whitespace); ++src) {
                 ;
             }
+            *end = '\0';
+            if (end != start) {
+                push(start, end - start);
+            }
             start = src;
         } else {
             ++src;
@@ -454,10 +2950,10 @@ size_t cmd_tokens_t::tokenize(const char* in)
     // skip any trailing tokens
     if (src != start) {
         // extract this token
-        push(std::string(start, src));
+        push(start, src - start);
     }
     // flush tokens
-    push(std::string{});
+    flush();
     // return number of tokens
     return tokens.size();
 }
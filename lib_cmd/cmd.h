@@ -5,23 +5,287 @@
 /// @end
 
 #pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <cassert>
+#include <condition_variable>
 #include <cstdarg>
 #include <cstdint>
+#include <deque>
+#include <functional>
 #include <map>
 #include <memory>
+#include <memory_resource>
+#include <mutex>
 #include <queue>
 #include <set>
+#include <shared_mutex>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
 #include <vector>
 
+/// @brief CMD_STATS, enable per command latency statistics.
+///
+/// when defined as 0 no statistics are recorded and cmd_t carries no
+/// counters, so the instrumentation has no cost.  off by default, it
+/// changes the layout of cmd_t so code including this header must use the
+/// same value as the library was built with, as the CMake option exports.
+#ifndef CMD_STATS
+#define CMD_STATS 0
+#endif
+
+/// @brief CMD_COROUTINES, enable coroutine command handlers.
+///
+/// requires c++20.  when defined as 1 commands may override
+/// cmd_t::on_execute_async and sessions gain execute_async().  off by
+/// default, it adds a virtual to cmd_t so code including this header must
+/// use the same value as the library was built with.
+#ifndef CMD_COROUTINES
+#define CMD_COROUTINES 0
+#endif
+
+#if CMD_COROUTINES
+#include <coroutine>
+#include <exception>
+#endif
+
 /// @brief cmd_list_t, list of cmd_t instances.
 ///
 typedef std::vector<std::unique_ptr<struct cmd_t>> cmd_list_t;
 
 /// @brief cmd_idents_t, identfier list used for cmd_tokens_t substitutions.
 ///
-typedef std::map<std::string, uint64_t> cmd_idents_t;
+/// identifier names are interned into a single buffer and looked up through
+/// an open addressing hash table.  every name is given a stable integer slot
+/// the first time it is seen, which compiled expressions and other long
+/// lived users can hold onto in place of the name.  erasing an identifier
+/// only marks its slot as unset, slots are never reused for another name.
+/// once unset slots outnumber the set ones the table is compacted instead,
+/// which renumbers the slots and changes the epoch.
+///
+struct cmd_idents_t {
+
+    /// @brief invalid slot index.
+    static constexpr uint32_t npos = ~0u;
+
+    /// @brief constructor.
+    ///
+    /// @param resource memory resource for the names and slots.
+    cmd_idents_t(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : slots_(resource)
+        , table_(resource)
+        , names_(resource)
+        , count_(0)
+        , changed_(resource)
+        , track_(false)
+        , cleared_(false)
+        , epoch_(0)
+    {
+    }
+
+    /// @brief find the slot for an identifier name.
+    ///
+    /// @param name identifier name.
+    /// @return slot index otherwise npos if the name was never interned.
+    uint32_t slot(const std::string_view& name) const;
+
+    /// @brief find or allocate the slot for an identifier name.
+    ///
+    /// a newly allocated slot is unset until a value is assigned.
+    ///
+    /// @param name identifier name.
+    /// @return slot index.
+    uint32_t intern(const std::string_view& name);
+
+    /// @brief get the value of an identifier.
+    ///
+    /// @param slot identifier slot.
+    /// @param out output to receive the value.
+    /// @return true if the identifier is set.
+    bool get(uint32_t slot, uint64_t& out) const
+    {
+        if (slot >= slots_.size() || !slots_[slot].set_) {
+            return false;
+        }
+        return (out = slots_[slot].value_), true;
+    }
+
+    /// @brief get the value of an identifier.
+    ///
+    /// @param name identifier name.
+    /// @param out output to receive the value.
+    /// @return true if the identifier is set.
+    bool get(const std::string_view& name, uint64_t& out) const
+    {
+        return get(slot(name), out);
+    }
+
+    /// @brief assign a value to an identifier.
+    ///
+    /// @param slot identifier slot.
+    /// @param value value to assign.
+    void set(uint32_t slot, uint64_t value)
+    {
+        assert(slot < slots_.size());
+        slot_t& entry = slots_[slot];
+        count_ += entry.set_ ? 0 : 1;
+        entry.set_ = true;
+        entry.value_ = value;
+        if (track_) {
+            touch(slot);
+        }
+    }
+
+    /// @brief assign a value to an identifier.
+    ///
+    /// @param name identifier name.
+    /// @param value value to assign.
+    void set(const std::string_view& name, uint64_t value)
+    {
+        set(intern(name), value);
+    }
+
+    /// @brief access an identifier value, setting it to zero if unset.
+    ///
+    /// @param name identifier name.
+    /// @return reference to the identifier value, valid until the next intern.
+    uint64_t& operator[](const std::string_view& name)
+    {
+        const uint32_t index = intern(name);
+        if (!slots_[index].set_) {
+            set(index, 0);
+        } else if (track_) {
+            // the value may be written through the reference
+            touch(index);
+        }
+        return slots_[index].value_;
+    }
+
+    /// @brief erase an identifier.
+    ///
+    /// may compact the table, see compact().
+    ///
+    /// @param name identifier name.
+    /// @return true if the identifier was set.
+    bool erase(const std::string_view& name);
+
+    /// @brief drop the slots and names of unset identifiers.
+    ///
+    /// slots with changes not yet taken are kept.  every slot handed out
+    /// before is invalid afterwards, see epoch().
+    void compact();
+
+    /// @brief check if a slot holds a value.
+    bool is_set(uint32_t slot) const
+    {
+        return slot < slots_.size() && slots_[slot].set_;
+    }
+
+    /// @brief name of an identifier slot, null terminated.
+    std::string_view name(uint32_t slot) const
+    {
+        assert(slot < slots_.size());
+        return std::string_view(names_.data() + slots_[slot].off_, slots_[slot].len_);
+    }
+
+    /// @brief number of identifiers that are set.
+    size_t size() const
+    {
+        return count_;
+    }
+
+    /// @brief number of slots allocated, set or not.
+    uint32_t slots() const
+    {
+        return uint32_t(slots_.size());
+    }
+
+    /// @brief check if no identifiers are set.
+    bool empty() const
+    {
+        return count_ == 0;
+    }
+
+    /// @brief remove all identifiers and slots.
+    ///
+    /// every slot handed out before is invalid afterwards, see epoch().
+    void clear();
+
+    /// @brief number that changes whenever slots handed out are invalidated.
+    ///
+    /// slots stay valid until clear(), compact() or until cmd_store_t loads
+    /// a snapshot over the table, all of which change the epoch.  users
+    /// holding onto slots must drop them when it does.
+    uint64_t epoch() const
+    {
+        return epoch_;
+    }
+
+    /// @brief list the slots of all set identifiers ordered by name.
+    ///
+    /// @param out output list to receive the slots.
+    void sorted(std::vector<uint32_t>& out) const;
+
+    /// @brief record the slots that are set or erased from now on.
+    ///
+    /// used by cmd_store_t to journal changes, see changes().
+    void track_changes(bool enable)
+    {
+        track_ = enable;
+    }
+
+    /// @brief take the slots changed since the last call.
+    ///
+    /// @param out output list to receive the slots, in the order they first changed.
+    /// @return true if all identifiers were cleared before those changes.
+    bool changes(std::vector<uint32_t>& out);
+
+protected:
+    friend struct cmd_store_t;
+
+    struct slot_t {
+        uint32_t off_;
+        uint32_t len_;
+        uint32_t hash_;
+        bool set_;
+        bool changed_;
+        uint64_t value_;
+    };
+
+    /// @brief note a changed slot.
+    void touch(uint32_t slot)
+    {
+        if (!slots_[slot].changed_) {
+            slots_[slot].changed_ = true;
+            changed_.push_back(slot);
+        }
+    }
+
+    /// @brief insert a slot into the hash table.
+    void insert(uint32_t slot);
+
+    /// @brief grow and rebuild the hash table.
+    void rehash(size_t size);
+
+    /// @brief identifier slots.
+    std::pmr::vector<slot_t> slots_;
+    /// @brief open addressing table, entries are slot + 1.
+    std::pmr::vector<uint32_t> table_;
+    /// @brief interned identifier names.
+    std::pmr::vector<char> names_;
+    /// @brief number of set identifiers.
+    size_t count_;
+    /// @brief slots changed while tracking.
+    std::pmr::vector<uint32_t> changed_;
+    bool track_;
+    /// @brief cleared while tracking.
+    bool cleared_;
+    /// @brief see epoch().
+    uint64_t epoch_;
+};
 
 /// @brief cmd_baton_t, baton used for passing user data to cm_t instances.
 ///
@@ -48,12 +312,91 @@ struct cmd_util_t {
     /// @return edit distance between strings s1 and s2
     static uint32_t levenshtein(const char* a, const char* b);
 
+    /// @brief bounded levenshtein string distance function.
+    ///
+    /// bit parallel (Myers/Hyyro) edit distance that stops as soon as the
+    /// distance is known to exceed max.
+    ///
+    /// @param s1 input string a
+    /// @param s2 input string b
+    /// @param max largest distance of interest
+    ///
+    /// @return edit distance between strings s1 and s2, or max + 1 if it exceeds max
+    static uint32_t levenshtein(const char* a, const char* b, uint32_t max);
+
     /// @brief partial substring match.
     ///
     /// @return number of characters between str and sub that match or -1 if different
     static int32_t str_match(const char* str, const char* sub);
 };
 
+/// @brief cmd_index_t, prefix index over a list of commands.
+///
+/// a character trie kept alongside each cmd_list_t as commands are registered.
+/// it answers exact, unique prefix and ambiguous prefix lookups in time
+/// proportional to the token length rather than the number of siblings.
+///
+struct cmd_index_t {
+
+    /// @brief constructor.
+    cmd_index_t()
+    {
+        clear();
+    }
+
+    /// @brief add a command to the index.
+    ///
+    /// @param cmd the command to add.
+    /// @param name the name the command can be matched by.
+    void insert(struct cmd_t* cmd, const char* name);
+
+    /// @brief find all commands that best match a token.
+    ///
+    /// an exact name match is preferred over any prefix matches, otherwise
+    /// all commands that the token is a prefix of are returned.  matches are
+    /// returned in the order they were inserted.
+    ///
+    /// @param sub token to match against command names.
+    /// @param out output list to receive the matching commands.
+    /// @return number of commands matched.
+    size_t find(const std::string_view& sub, std::vector<struct cmd_t*>& out) const;
+
+    /// @brief find a command with an exact name match.
+    ///
+    /// @param name the exact name of the command.
+    /// @return the first command inserted with this name otherwise nullptr.
+    struct cmd_t* find_exact(const std::string_view& name) const;
+
+    /// @brief remove all commands from the index.
+    void clear();
+
+protected:
+    struct node_t {
+        /// @brief child nodes sorted by character.
+        std::vector<std::pair<char, uint32_t>> child_;
+        /// @brief ordinals of the entries whose name ends at this node.
+        std::vector<uint32_t> exact_;
+        /// @brief number of entries in this subtree.
+        uint32_t count_;
+        /// @brief smallest ordinal in this subtree.
+        uint32_t first_;
+    };
+
+    /// @brief walk the trie to the node for a given prefix.
+    ///
+    /// @return node index otherwise -1 if the prefix is not present.
+    int32_t walk(const std::string_view& sub) const;
+
+    /// @brief append the ordinals of all entries in a subtree.
+    void collect(uint32_t node, std::vector<uint32_t>& out) const;
+
+    /// @brief trie nodes, the root is always the first node.
+    std::vector<node_t> nodes_;
+
+    /// @brief indexed commands by ordinal.
+    std::vector<struct cmd_t*> entries_;
+};
+
 /// @brief cmd_output_t, command output interface base class.
 ///
 /// this class brokers all output text writing from cmd_t classes during command execution.
@@ -63,12 +406,53 @@ struct cmd_util_t {
 ///
 struct cmd_output_t {
 
-    /// @brief Create a cmd_output_t instance that will write directly to a file descriptor.
+    /// @brief Create a cmd_output_t instance that will write to a file descriptor.
+    ///
+    /// output is formatted into a line buffer and written out in large
+    /// blocks, so flush() must be called before waiting on user input.
     ///
     /// @param fd, the file descriptior that all output will be written to.
     /// @return cmd_output_t instance.
     static cmd_output_t* create_output_stdio(FILE* fd);
 
+    /// @brief encoding of structured records.
+    enum record_format_t {
+        /// @brief human readable text, commands print with println.
+        e_text,
+        /// @brief one json object per line.
+        e_jsonl,
+        /// @brief length prefixed binary records, see cmd_record_t.
+        e_binary
+    };
+
+    /// @brief behaviour of an asynchronous output when its queue is full.
+    enum overflow_t {
+        /// @brief producers wait for the writer to make space.
+        e_block,
+        /// @brief records are discarded and a count of them is written later.
+        e_drop
+    };
+
+    /// @brief Create a cmd_output_t instance that writes from a background thread.
+    ///
+    /// formatted lines are pushed onto a bounded lock free queue and written
+    /// to the file descriptor by a dedicated writer thread, so printing never
+    /// waits on I/O.  indentation and partial lines are tracked per thread so
+    /// that any thread may print while a command is executing.  lock() and
+    /// unlock() do nothing and flush() hands partial lines to the writer
+    /// without waiting.  the queue is drained when the instance is destroyed.
+    ///
+    /// @param fd, the file descriptor that all output will be written to.
+    /// @param capacity, maximum number of queued lines, rounded up to a power of two.
+    /// @param overflow, behaviour when the queue is full.
+    /// @return cmd_output_t instance.
+    static cmd_output_t* create_output_async(FILE* fd, size_t capacity = 1024, overflow_t overflow = e_block);
+
+    /// @brief Create a cmd_output_t instance that captures output in memory.
+    ///
+    /// @return cmd_output_buffer_t instance.
+    static struct cmd_output_buffer_t* create_output_buffer();
+
     /// @bried Create a dummy cmd_output_t instance that has no side effects.
     ///
     /// @return cmd_output_t instance.
@@ -133,6 +517,7 @@ struct cmd_output_t {
     /// @brief constructor.
     cmd_output_t()
         : indent_(2)
+        , record_format_(e_text)
     {
     }
 
@@ -150,12 +535,13 @@ struct cmd_output_t {
     /// @return indent helper class.
     indent_t indent(uint32_t next = 2)
     {
-        return indent_t(&indent_, next);
+        return indent_t(indent_ptr(), next);
     }
 
     /// @brief print a format string into this output stream.
     ///
-    /// print to output string without appending a new line.
+    /// print to output string without appending a new line.  if the output
+    /// is structured the text is written as a "text" record instead.
     ///
     /// @param INDENT follow indentation marker from output string.
     /// @param fmt format string.
@@ -165,13 +551,18 @@ struct cmd_output_t {
     {
         va_list args;
         va_start(args, fmt);
-        print(INDENT, fmt, args);
+        if (record_format_ == e_text) {
+            print(INDENT, fmt, args);
+        } else {
+            text_record(fmt, args);
+        }
         va_end(args);
     }
 
     /// @brief print a format string into this output stream.
     ///
-    /// print to output string and append a new line.
+    /// print to output string and append a new line.  if the output is
+    /// structured the text is written as a "text" record instead.
     ///
     /// @param INDENT follow indentation marker from output string.
     /// @param fmt format string.
@@ -181,534 +572,2525 @@ struct cmd_output_t {
     {
         va_list args;
         va_start(args, fmt);
-        println(INDENT, fmt, args);
+        if (record_format_ == e_text) {
+            println(INDENT, fmt, args);
+        } else {
+            text_record(fmt, args);
+        }
         va_end(args);
     }
 
+    /// @brief print a line of typed values into this output stream.
+    ///
+    /// each argument is converted according to its type with no format
+    /// string to parse at runtime, so mismatched arguments are caught at
+    /// compile time.  strings, characters and integers are accepted along
+    /// with the cmd_format_t wrappers for hex, padded and aligned values.
+    ///
+    /// @code
+    ///     out.line(cmd_format_t::pad(name, 8), " ", cmd_format_t::hex(value));
+    /// @endcode
+    ///
+    /// @param INDENT follow indentation marker from output string.
+    /// @param args values to print.
+    template <bool INDENT = true, typename... args_t>
+    void line(const args_t&... args);
+
     virtual void print(bool indent, const char* fmt, va_list& args) = 0;
     virtual void println(bool indent, const char* fmt, va_list& args) = 0;
 
     /// @brief Append an end of line character.
     virtual void eol() = 0;
 
-protected:
-    /// @brief Current indentation level.
-    uint32_t indent_;
-};
+    /// @brief Write any buffered output.
+    virtual void flush() {}
 
-/// @brief cmd_locale_t, command locale text definitions.
-///
-struct cmd_locale_t {
+    /// @brief Select the encoding used for structured records.
+    ///
+    /// @param format e_text for human readable output.
+    void set_record_format(record_format_t format)
+    {
+        record_format_ = format;
+    }
 
-    static void possible_completions(cmd_output_t& out)
+    /// @brief Get the encoding used for structured records.
+    record_format_t record_format() const
     {
-        out.println("possible completions:");
+        return record_format_;
     }
 
-    static void invalid_command(cmd_output_t& out)
+    /// @brief Check if commands should emit records rather than text.
+    ///
+    /// @return true if the record format is not e_text.
+    bool structured() const
     {
-        out.println("invalid command");
+        return record_format_ != e_text;
     }
 
-    static void no_subcommand(cmd_output_t& out, const char* cmd)
+protected:
+    friend struct cmd_record_t;
+    friend struct cmd_session_t;
+    friend struct cmd_job_list_t;
+
+    /// @brief Write a complete record or line of bytes.
+    ///
+    /// the default implementation writes through print(), outputs that can
+    /// append raw bytes should override this.
+    ///
+    /// @param data bytes to write.
+    /// @param size number of bytes.
+    virtual void write_raw(const char* data, size_t size);
+
+    /// @brief Write formatted text as a "text" record.
+    void text_record(const char* fmt, va_list& args);
+
+    /// @brief Write text as a "text" record.
+    void text_record(const std::string_view& text);
+
+    /// @brief Per thread scratch buffer used to assemble typed lines.
+    static std::string& line_scratch()
     {
-        out.println("no subcommand '%s'", cmd);
+        thread_local std::string scratch;
+        return scratch;
     }
 
-    static void did_you_meen(cmd_output_t& out)
+    /// @brief Get the indentation level for the calling thread.
+    virtual uint32_t* indent_ptr()
     {
-        out.println("did you meen:");
+        return &indent_;
     }
 
-    static void not_val_or_ident(cmd_output_t& out)
+    /// @brief Current indentation level.
+    uint32_t indent_;
+
+    /// @brief Encoding used for structured records.
+    record_format_t record_format_;
+};
+
+/// @brief cmd_format_t, typed value formatting for cmd_output_t::line.
+///
+/// integers are converted with std::to_chars straight into the line being
+/// built.  the wrappers returned by hex(), dec() and pad() cover the printf
+/// conversions used by the builtin commands.
+///
+struct cmd_format_t {
+
+    /// @brief hexadecimal integer with a 0x prefix.
+    struct hex_t {
+        uint64_t value_;
+        /// @brief minimum number of digits, zero filled.
+        uint32_t width_;
+    };
+
+    /// @brief decimal integer padded to a minimum width.
+    struct dec_t {
+        int64_t value_;
+        uint32_t width_;
+        char fill_;
+    };
+
+    /// @brief string padded to a minimum width.
+    struct pad_t {
+        std::string_view str_;
+        /// @brief right aligned if positive, left aligned if negative.
+        int32_t width_;
+    };
+
+    /// @brief format as hex, like printf "0x%llx".
+    static hex_t hex(uint64_t value, uint32_t width = 0)
     {
-        out.println("return type not value or identifier");
+        return hex_t{ value, width };
     }
 
-    static void unknown_ident(cmd_output_t& out, const char* ident)
+    /// @brief format as decimal padded to width, like printf "%02d".
+    static dec_t dec(int64_t value, uint32_t width, char fill = ' ')
     {
-        out.println("unknown identifier '%s'", ident);
+        return dec_t{ value, width, fill };
     }
 
-    static void malformed_exp(cmd_output_t& out)
+    /// @brief pad a string to width, like printf "%8s" or "%-8s".
+    static pad_t pad(const std::string_view& str, int32_t width)
     {
-        out.println("malformed expression");
+        return pad_t{ str, width };
     }
 
-    static void error(cmd_output_t& out, const char* err)
+    static void append(std::string& out, const std::string_view& str)
     {
-        out.println("error: %s", err);
+        out.append(str.data(), str.size());
     }
 
-    static void usage(cmd_output_t& out, const char* path, const char* args, const char* desc)
+    static void append(std::string& out, const std::string& str)
     {
-        out.println("usage: %s %s", path, args ? args : "");
-        if (desc) {
-            out.println("desc:  %s", desc);
-        }
+        out.append(str);
     }
 
-    static void subcommands(cmd_output_t& out)
+    static void append(std::string& out, const char* str)
     {
-        out.println("subcomands:");
+        out.append(str ? str : "(null)");
     }
 
-    static void unable_to_find_cmd(cmd_output_t& out, const char* cmd)
+    static void append(std::string& out, char ch)
     {
-        out.println("unable to find command '%s'", cmd);
+        out.push_back(ch);
     }
 
-    static void num_aliases(cmd_output_t& out, uint64_t num)
+    /// @brief append a decimal integer.
+    template <typename type_t>
+    static typename std::enable_if<std::is_integral<type_t>::value>::type
+    append(std::string& out, type_t value)
     {
-        num ? out.println("%d aliases:", (uint32_t)num) : out.println("no alises");
+        char temp[24];
+        out.append(temp, to_chars(temp, value, 10));
     }
 
-    static void command_failed(cmd_output_t& out, const char* cmd)
+    static void append(std::string& out, const hex_t& hex);
+    static void append(std::string& out, const dec_t& dec);
+    static void append(std::string& out, const pad_t& pad);
+
+    /// @brief convert an integer, returning the end of the digits.
+    ///
+    /// @param out buffer of at least 24 characters.
+    /// @param value integer to convert.
+    /// @param base 10 or 16.
+    static char* to_chars(char* out, uint64_t value, int base);
+    static char* to_chars(char* out, int64_t value, int base);
+
+    template <typename type_t>
+    static char* to_chars(char* out, type_t value, int base)
     {
-        out.println("  command failed: '%s'", cmd);
+        return std::is_signed<type_t>::value ? to_chars(out, int64_t(value), base)
+                                             : to_chars(out, uint64_t(value), base);
     }
 };
 
-/// @brief cmd_token_t, command arguement token.
+template <bool INDENT, typename... args_t>
+void cmd_output_t::line(const args_t&... args)
+{
+    std::string& buf = line_scratch();
+    buf.clear();
+    if (record_format_ != e_text) {
+        (cmd_format_t::append(buf, args), ...);
+        return text_record(buf);
+    }
+    if (INDENT) {
+        buf.append(*indent_ptr(), ' ');
+    }
+    (cmd_format_t::append(buf, args), ...);
+    buf.push_back('\n');
+    write_raw(buf.data(), buf.size());
+}
+
+/// @brief cmd_output_buffer_t, output captured into a memory buffer.
 ///
-/// User input is processed, it is parsed to form a list of tokens.  These
-/// tokens are encapsulated as a cmd_token_t.  A list of tokens is defined as
-/// the cmd_tokens_t type.  The cmd_token_t type makes it easier to convert
-/// string tokens between multiple data types.
+/// output is appended to a growable buffer that is kept between uses, so
+/// once it has grown to fit the largest result no further allocations are
+/// made.  the result can be read as a string view and then discarded with
+/// reset(), which keeps the memory for the next command.
 ///
-struct cmd_token_t {
+struct cmd_output_buffer_t : public cmd_output_t {
 
     /// @brief constructor.
-    cmd_token_t() = default;
-
-    /// @brief cmd_token_t constructor.
     ///
-    /// @param string token.
-    cmd_token_t(const std::string& string)
-        : token_(string)
+    /// @param reserve initial buffer size in bytes.
+    cmd_output_buffer_t(size_t reserve = 4096)
+        : cmd_output_t()
+        , buffer_(reserve)
+        , size_(0)
     {
     }
 
-    /// @brief return token as a string.
-    ///
-    /// @return underlying token string.
-    const std::string& get() const
+    virtual void lock() override
     {
-        return token_;
+        mux_.lock();
     }
 
-    /// @brief get token as an integer.
-    ///
-    /// @param output integer to store the conversion.
-    /// @return true if the token represents an integer.
-    template <typename type_t>
-    bool get(type_t& out) const
+    virtual void unlock() override
     {
-        bool neg = false;
-        uint64_t value = 0;
-        if (!cmd_util_t::strtoll(token_.c_str(), value, neg)) {
-            return false;
-        }
-        out = static_cast<type_t>(neg ? 0 - value : value);
-        return true;
+        mux_.unlock();
     }
 
-    /// @brief test for token equality.
+    using cmd_output_t::print;
+    using cmd_output_t::println;
+
+    virtual void print(bool indent, const char* fmt, va_list& args) override;
+    virtual void println(bool indent, const char* fmt, va_list& args) override;
+    virtual void eol() override;
+
+    /// @brief view of everything written since the last reset.
     ///
-    /// @param rhs token to check equality with.
-    /// @return true if tokens are equal.
-    bool operator==(const cmd_token_t& rhs) const
+    /// the view is invalidated by any further output.
+    std::string_view view() const
     {
-        return token_ == rhs.get();
+        return std::string_view(buffer_.data(), size_);
     }
 
-    /// @brief test for token equality.
-    ///
-    /// @param rhs token to check equality with.
-    /// @return true if token is equal to rhs.
-    template <typename type_t>
-    bool operator==(const type_t& rhs) const
+    /// @brief number of bytes written since the last reset.
+    size_t size() const
     {
-        return token_ == rhs;
+        return size_;
     }
 
-    /// @brief std::string cast operator.
-    ///
-    /// @return token as string.
-    operator std::string() const
+    /// @brief discard all output while keeping the allocated memory.
+    void reset()
     {
-        return token_;
+        size_ = 0;
     }
 
-    /// @brief c string cast operator.
-    ///
-    /// @return c string representataion of token.
-    const char* c_str() const
+protected:
+    virtual void write_raw(const char* data, size_t size) override;
+
+    /// @brief make room for a number of bytes past the end of the output.
+    void reserve(size_t extra)
     {
-        return token_.c_str();
+        if (size_ + extra > buffer_.size()) {
+            buffer_.resize(std::max(size_ + extra, buffer_.size() * 2));
+        }
     }
 
-protected:
-    std::string token_;
+    void append(char ch)
+    {
+        reserve(1);
+        buffer_[size_++] = ch;
+    }
+
+    void append(const char* str, size_t len);
+    void format(const char* fmt, va_list& args);
+    void indent_apply();
+
+    /// @brief format a print into the buffer without taking the lock.
+    void emit(bool indent, const char* fmt, va_list& args, bool newline)
+    {
+        indent ? indent_apply() : (void)0;
+        format(fmt, args);
+        newline ? append('\n') : (void)0;
+    }
+
+    /// @brief recursive as execute() holds the lock while commands print.
+    std::recursive_mutex mux_;
+
+    /// @brief output buffer, only the first size_ bytes are valid.
+    std::vector<char> buffer_;
+    size_t size_;
 };
 
-/// @brief cmd_tokens_t, command arguments token list.
+/// @brief cmd_record_t, builder for a structured output record.
 ///
-struct cmd_tokens_t {
+/// a record is a type name followed by named fields holding integers,
+/// strings or lists of them.  fields are encoded directly into a per thread
+/// scratch buffer in the record format of the output, and the finished
+/// record is written when end() is called or the builder goes out of scope.
+/// no printf formatting is involved.
+///
+/// e_jsonl records are written as a single json object per line, with the
+/// record type under the key "type".
+///
+/// e_binary records are a little endian uint32 payload size followed by the
+/// payload.  the payload is the record type as a string followed by a
+/// sequence of entries.  each entry is a tag byte, then a key string for
+/// entries outside of a list, then a value.  strings are a varint length
+/// followed by bytes and integers are varints, zigzag encoded if signed.
+///
+///     tag 1 unsigned integer, tag 2 signed integer, tag 3 string,
+///     tag 4 list begin, tag 5 list end (no key).
+///
+struct cmd_record_t {
+
+    /// @brief binary entry tags.
+    enum tag_t {
+        e_tag_uint = 1,
+        e_tag_int = 2,
+        e_tag_str = 3,
+        e_tag_list = 4,
+        e_tag_list_end = 5
+    };
+
+    /// @brief begin a record.
+    ///
+    /// @param out output stream to write the record to.
+    /// @param type record type name.
+    cmd_record_t(cmd_output_t& out, const char* type);
+
+    ~cmd_record_t()
+    {
+        end();
+    }
+
+    cmd_record_t(const cmd_record_t&) = delete;
+    cmd_record_t& operator=(const cmd_record_t&) = delete;
+
+    /// @brief add an integer field.
+    template <typename type_t>
+    typename std::enable_if<std::is_integral<type_t>::value, cmd_record_t&>::type
+    field(const char* key, type_t value)
+    {
+        this->key(key);
+        std::is_signed<type_t>::value ? put_int(int64_t(value)) : put_uint(uint64_t(value));
+        return *this;
+    }
+
+    /// @brief add a string field.
+    cmd_record_t& field(const char* key, const std::string_view& value)
+    {
+        this->key(key);
+        put_str(value);
+        return *this;
+    }
+
+    cmd_record_t& field(const char* key, const char* value)
+    {
+        return field(key, std::string_view(value ? value : ""));
+    }
+
+    cmd_record_t& field(const char* key, const std::string& value)
+    {
+        return field(key, std::string_view(value));
+    }
+
+    /// @brief begin a list field, items follow until list_end().
+    cmd_record_t& list(const char* key);
+
+    /// @brief add an integer item to the current list.
+    template <typename type_t>
+    typename std::enable_if<std::is_integral<type_t>::value, cmd_record_t&>::type
+    item(type_t value)
+    {
+        separator();
+        std::is_signed<type_t>::value ? put_int(int64_t(value)) : put_uint(uint64_t(value));
+        return *this;
+    }
+
+    /// @brief add a string item to the current list.
+    cmd_record_t& item(const std::string_view& value)
+    {
+        separator();
+        put_str(value);
+        return *this;
+    }
+
+    /// @brief end the current list.
+    cmd_record_t& list_end();
+
+    /// @brief finish the record and write it to the output.
+    void end();
+
+protected:
+    void key(const char* key);
+    void separator();
+    void put_uint(uint64_t value);
+    void put_int(int64_t value);
+    void put_str(const std::string_view& value);
+    void put_varint(uint64_t value);
+
+    cmd_output_t& out_;
+    /// @brief per thread scratch buffer holding the encoded record.
+    std::string& buf_;
+    const cmd_output_t::record_format_t format_;
+    /// @brief true if the next json value is the first in its object or list.
+    bool first_;
+    /// @brief true while inside a list.
+    bool in_list_;
+    bool done_;
+    /// @brief key of the next binary entry, written after its tag.
+    const char* key_;
+};
+
+/// @brief cmd_locale_t, command locale text definitions.
+///
+struct cmd_locale_t {
+
+    static void possible_completions(cmd_output_t& out)
+    {
+        out.println("possible completions:");
+    }
+
+    static void invalid_command(cmd_output_t& out)
+    {
+        out.println("invalid command");
+    }
+
+    static void no_subcommand(cmd_output_t& out, const char* cmd)
+    {
+        out.println("no subcommand '%s'", cmd);
+    }
+
+    static void did_you_meen(cmd_output_t& out)
+    {
+        out.println("did you meen:");
+    }
+
+    static void not_val_or_ident(cmd_output_t& out)
+    {
+        out.println("return type not value or identifier");
+    }
+
+    static void unknown_ident(cmd_output_t& out, const char* ident)
+    {
+        out.println("unknown identifier '%s'", ident);
+    }
+
+    static void malformed_exp(cmd_output_t& out)
+    {
+        out.println("malformed expression");
+    }
+
+    static void error(cmd_output_t& out, const char* err)
+    {
+        out.println("error: %s", err);
+    }
+
+    static void usage(cmd_output_t& out, const char* path, const char* args, const char* desc)
+    {
+        out.println("usage: %s %s", path, args ? args : "");
+        if (desc) {
+            out.println("desc:  %s", desc);
+        }
+    }
+
+    static void subcommands(cmd_output_t& out)
+    {
+        out.println("subcomands:");
+    }
+
+    static void unable_to_find_cmd(cmd_output_t& out, const char* cmd)
+    {
+        out.println("unable to find command '%s'", cmd);
+    }
+
+    static void num_aliases(cmd_output_t& out, uint64_t num)
+    {
+        num ? out.line(num, " aliases:") : out.line("no alises");
+    }
+
+    static void command_failed(cmd_output_t& out, const char* cmd)
+    {
+        out.println("  command failed: '%s'", cmd);
+    }
+
+    static void unbound_placeholder(cmd_output_t& out, uint32_t index)
+    {
+        out.println("placeholder %d is not bound", index);
+    }
+
+    static void job_started(cmd_output_t& out, uint32_t id)
+    {
+        out.line("[", id, "] started");
+    }
+
+    static void job_state(cmd_output_t& out, uint32_t id, bool done, const std::string& cmd)
+    {
+        out.line("[", id, "] ", done ? "done    " : "running ", cmd);
+    }
+
+    static void unknown_job(cmd_output_t& out, uint64_t id)
+    {
+        out.line("no job ", id);
+    }
+
+    static void no_history(cmd_output_t& out, const std::string_view& event)
+    {
+        out.println("'%.*s' is not in the history", int(event.size()), event.data());
+    }
+
+    static void not_background(cmd_output_t& out, const char* cmd)
+    {
+        out.println("'%s' can not run in the background", cmd);
+    }
+
+    static void stats_disabled(cmd_output_t& out)
+    {
+        out.println("statistics are not compiled in");
+    }
+
+    static void no_stats(cmd_output_t& out)
+    {
+        out.println("no statistics recorded");
+    }
+};
+
+/// @brief cmd_token_string_t, token string returned by cmd_token_t::get().
+///
+/// a std::string_view which is known to be null terminated, so it also
+/// offers c_str() and converts to std::string.  code written when get()
+/// returned a const std::string& keeps compiling, binding a reference to it
+/// takes a copy.
+///
+struct cmd_token_string_t : public std::string_view {
+
+    cmd_token_string_t(const std::string_view& view)
+        : std::string_view(view)
+    {
+    }
+
+    /// @brief return the token as a null terminated string.
+    const char* c_str() const
+    {
+        return data() ? data() : "";
+    }
+
+    /// @brief std::string cast operator.
+    operator std::string() const
+    {
+        return std::string(data(), size());
+    }
+};
+
+/// @brief cmd_token_t, command arguement token.
+///
+/// User input is processed, it is parsed to form a list of tokens.  These
+/// tokens are encapsulated as a cmd_token_t.  A list of tokens is defined as
+/// the cmd_tokens_t type.  The cmd_token_t type makes it easier to convert
+/// string tokens between multiple data types.
+///
+struct cmd_token_t {
+
+    /// @brief constructor.
+    cmd_token_t()
+        : view_()
+        , owned_(true)
+    {
+    }
+
+    /// @brief cmd_token_t constructor.
+    ///
+    /// the token will hold its own copy of the string.
+    ///
+    /// @param string token.
+    cmd_token_t(const std::string& string)
+        : own_(string)
+        , view_()
+        , owned_(true)
+    {
+    }
+
+    /// @brief cmd_token_t view constructor.
+    ///
+    /// the token will reference the string without taking a copy, so the
+    /// string must outlive the token and be null terminated at str[len].
+    ///
+    /// @param str start of the token string.
+    /// @param len length of the token string.
+    cmd_token_t(const char* str, size_t len)
+        : view_(str, len)
+        , owned_(false)
+    {
+        assert(str && str[len] == '\0');
+    }
+
+    /// @brief return token as a string.
+    ///
+    /// @return underlying token string, usable as a std::string_view or a
+    ///         null terminated string.
+    cmd_token_string_t get() const
+    {
+        return view();
+    }
+
+    /// @brief return token as a view.
+    ///
+    /// @return view of the underlying token string.
+    std::string_view view() const
+    {
+        return owned_ ? std::string_view(own_) : view_;
+    }
+
+    /// @brief get token as an integer.
+    ///
+    /// @param output integer to store the conversion.
+    /// @return true if the token represents an integer.
+    template <typename type_t>
+    bool get(type_t& out) const
+    {
+        bool neg = false;
+        uint64_t value = 0;
+        if (!cmd_util_t::strtoll(c_str(), value, neg)) {
+            return false;
+        }
+        out = static_cast<type_t>(neg ? 0 - value : value);
+        return true;
+    }
+
+    /// @brief test for token equality.
+    ///
+    /// @param rhs token to check equality with.
+    /// @return true if tokens are equal.
+    bool operator==(const cmd_token_t& rhs) const
+    {
+        return view() == rhs.view();
+    }
+
+    /// @brief test for token equality.
+    ///
+    /// @param rhs token to check equality with.
+    /// @return true if token is equal to rhs.
+    template <typename type_t>
+    bool operator==(const type_t& rhs) const
+    {
+        return view() == rhs;
+    }
+
+    /// @brief std::string cast operator.
+    ///
+    /// @return token as string.
+    operator std::string() const
+    {
+        return std::string(view());
+    }
+
+    /// @brief c string cast operator.
+    ///
+    /// @return c string representataion of token.
+    const char* c_str() const
+    {
+        return owned_ ? own_.c_str() : view_.data();
+    }
+
+    /// @brief check if this token owns its string.
+    ///
+    /// @return true if the token holds its own copy of the string.
+    bool owned() const
+    {
+        return owned_;
+    }
+
+protected:
+    /// @brief token string when owned_ is set.
+    std::string own_;
+    /// @brief token string when owned_ is not set.
+    std::string_view view_;
+    bool owned_;
+};
+
+/// @brief cmd_cancel_t, cooperative cancellation flag.
+///
+/// long running commands should poll cmd_tokens_t::cancelled() and return
+/// early once it is set.
+///
+struct cmd_cancel_t {
+
+    cmd_cancel_t()
+        : flag_(false)
+    {
+    }
+
+    /// @brief request cancellation.
+    void cancel()
+    {
+        flag_.store(true, std::memory_order_relaxed);
+    }
+
+    /// @brief check if cancellation was requested.
+    bool cancelled() const
+    {
+        return flag_.load(std::memory_order_relaxed);
+    }
+
+protected:
+    std::atomic<bool> flag_;
+};
+
+/// @brief cmd_token_queue_t, queue of tokens that keeps its storage.
+///
+/// tokens are popped by advancing a head index rather than freeing them,
+/// so a queue that has been cleared and refilled with the same number of
+/// tokens does not allocate.
+///
+struct cmd_token_queue_t {
+
+    typedef std::pmr::vector<cmd_token_t>::iterator iterator;
+    typedef std::pmr::vector<cmd_token_t>::const_iterator const_iterator;
+
+    explicit cmd_token_queue_t(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : list_(resource)
+        , head_(0)
+    {
+    }
+
+    iterator begin()
+    {
+        return list_.begin() + head_;
+    }
+
+    iterator end()
+    {
+        return list_.end();
+    }
+
+    const_iterator begin() const
+    {
+        return list_.begin() + head_;
+    }
+
+    const_iterator end() const
+    {
+        return list_.end();
+    }
+
+    size_t size() const
+    {
+        return list_.size() - head_;
+    }
+
+    bool empty() const
+    {
+        return head_ == list_.size();
+    }
+
+    cmd_token_t& front()
+    {
+        assert(!empty());
+        return list_[head_];
+    }
+
+    const cmd_token_t& front() const
+    {
+        assert(!empty());
+        return list_[head_];
+    }
+
+    cmd_token_t& back()
+    {
+        assert(!empty());
+        return list_.back();
+    }
+
+    const cmd_token_t& back() const
+    {
+        assert(!empty());
+        return list_.back();
+    }
+
+    cmd_token_t& operator[](size_t index)
+    {
+        return list_[head_ + index];
+    }
+
+    const cmd_token_t& operator[](size_t index) const
+    {
+        return list_[head_ + index];
+    }
+
+    void push_back(const cmd_token_t& token)
+    {
+        list_.push_back(token);
+    }
+
+    void pop_front()
+    {
+        assert(!empty());
+        if (++head_ == list_.size()) {
+            clear();
+        }
+    }
+
+    void clear()
+    {
+        list_.clear();
+        head_ = 0;
+    }
+
+protected:
+    std::pmr::vector<cmd_token_t> list_;
+    /// @brief index of the front token in list_.
+    size_t head_;
+};
+
+/// @brief cmd_flag_set_t, sorted set of flag names.
+///
+/// a flat replacement for std::set, there are only ever a handful of flags
+/// and clearing the set keeps its storage.
+///
+struct cmd_flag_set_t {
+
+    typedef std::pmr::vector<std::string_view>::const_iterator const_iterator;
+
+    explicit cmd_flag_set_t(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : list_(resource)
+    {
+    }
+
+    const_iterator begin() const
+    {
+        return list_.begin();
+    }
+
+    const_iterator end() const
+    {
+        return list_.end();
+    }
+
+    size_t size() const
+    {
+        return list_.size();
+    }
+
+    bool empty() const
+    {
+        return list_.empty();
+    }
+
+    const_iterator find(const std::string_view& name) const
+    {
+        const auto itt = std::lower_bound(list_.begin(), list_.end(), name);
+        return (itt != list_.end() && *itt == name) ? itt : list_.end();
+    }
+
+    void insert(const std::string_view& name)
+    {
+        const auto itt = std::lower_bound(list_.begin(), list_.end(), name);
+        if (itt == list_.end() || *itt != name) {
+            list_.insert(itt, name);
+        }
+    }
+
+    void clear()
+    {
+        list_.clear();
+    }
+
+protected:
+    std::pmr::vector<std::string_view> list_;
+};
+
+/// @brief cmd_pair_map_t, key value arguments sorted by key.
+///
+/// a flat replacement for std::map, see cmd_flag_set_t.
+///
+struct cmd_pair_map_t {
+
+    typedef std::pair<std::string_view, cmd_token_t> value_type;
+    typedef std::pmr::vector<value_type>::const_iterator const_iterator;
+
+    explicit cmd_pair_map_t(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : list_(resource)
+    {
+    }
+
+    const_iterator begin() const
+    {
+        return list_.begin();
+    }
+
+    const_iterator end() const
+    {
+        return list_.end();
+    }
+
+    size_t size() const
+    {
+        return list_.size();
+    }
+
+    bool empty() const
+    {
+        return list_.empty();
+    }
+
+    const_iterator find(const std::string_view& key) const
+    {
+        const auto itt = lower_bound(key);
+        return (itt != list_.end() && itt->first == key) ? const_iterator(itt) : list_.end();
+    }
+
+    /// @brief access the value for a key, inserting an empty one if needed.
+    cmd_token_t& operator[](const std::string_view& key)
+    {
+        auto itt = lower_bound(key);
+        if (itt == list_.end() || itt->first != key) {
+            itt = list_.insert(itt, value_type(key, cmd_token_t()));
+        }
+        return itt->second;
+    }
+
+    void clear()
+    {
+        list_.clear();
+    }
+
+protected:
+    std::pmr::vector<value_type>::iterator lower_bound(const std::string_view& key)
+    {
+        return std::lower_bound(list_.begin(), list_.end(), key,
+            [](const value_type& lhs, const std::string_view& rhs) { return lhs.first < rhs; });
+    }
+
+    std::pmr::vector<value_type>::const_iterator lower_bound(const std::string_view& key) const
+    {
+        return std::lower_bound(list_.begin(), list_.end(), key,
+            [](const value_type& lhs, const std::string_view& rhs) { return lhs.first < rhs; });
+    }
+
+    std::pmr::vector<value_type> list_;
+};
+
+/// @brief cmd_tokens_t, command arguments token list.
+///
+struct cmd_tokens_t {
+
+    struct {
+        /// @brief check if a flag was passed to the token list.
+        ///
+        /// @return true if 'name' flag was passed as an argument.
+        bool get(const std::string_view& name) const
+        {
+            return !(flags_.find(name) == flags_.end());
+        }
+
+        /// @brief check if the flag set is empty.
+        ///
+        /// @return true if the flags set is empty, otherwise false.
+        bool empty() const
+        {
+            return flags_.empty();
+        }
+
+        /// @brief command token flags.
+        cmd_flag_set_t flags_;
+    } flags;
+
+    struct {
+        /// @brief retreive the argument to a passed token pair.
+        ///
+        /// @return true if the pair was in the token list.
+        bool get(const std::string_view& name, cmd_token_t& out) const
+        {
+            auto itt = pairs_.find(name);
+            if (itt == pairs_.end()) {
+                return false;
+            } else {
+                return (out = itt->second), true;
+            }
+        }
+
+        /// @brief check if the pairs map is empty.
+        ///
+        /// @return true if the pairs set is empty, otherwise false.
+        bool empty() const
+        {
+            return pairs_.empty();
+        }
+
+        /// @brief key value pair arguments.
+        cmd_pair_map_t pairs_;
+    } pairs;
+
+    struct {
+        /// @brief return number of tokens in the token list.
+        ///
+        /// @return number of tokens in the token list.
+        size_t size() const
+        {
+            return tokens_.size();
+        }
+
+        /// @brief get the front most token from the token list.
+        ///
+        /// @return true if the front most token could be retrived.
+        bool get(std::string& out)
+        {
+            if (tokens_.empty()) {
+                return false;
+            }
+            out = tokens_.front().view();
+            tokens_.pop_front();
+            return true;
+        }
+
+        /// @brief get the front most token from the token list.
+        ///
+        /// @param output to receive front most token.
+        /// @return true if the front most token could be retrived.
+        bool get(cmd_token_t& out)
+        {
+            if (tokens_.empty()) {
+                return false;
+            }
+            out = tokens_.front();
+            tokens_.pop_front();
+            return true;
+        }
+
+        /// @brief get the front most token from the token list as an integer.
+        ///
+        /// @param output to receive the front most token.
+        /// @return true if the front most token could be interpreted as integer.
+        bool get(uint64_t& out)
+        {
+            if (!tokens_.empty()) {
+                if (front().get(out)) {
+                    tokens_.pop_front();
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /// @brief check if the token list is empty.
+        ///
+        /// @return true if the token list is empty.
+        bool empty() const
+        {
+            return tokens_.empty();
+        }
+
+        /// @brief return a reference to the first token in the queue.
+        ///
+        /// @return reference to first token.
+        const cmd_token_t& front() const
+        {
+            return tokens_.front();
+        }
+
+        /// @brief return a reference to the last token in the queue.
+        ///
+        /// @return reference to last token.
+        const cmd_token_t& back() const
+        {
+            return tokens_.back();
+        }
+
+        /// @brief pop front most argument from token list.
+        ///
+        /// @return true if front argument was popped.
+        bool pop()
+        {
+            if (!tokens_.empty()) {
+                assert(!raw_.empty());
+                if (raw_.front() == tokens_.front()) {
+                    // pop prefixed tokens
+                    raw_.pop_front();
+                    tokens_.pop_front();
+                    return true;
+                }
+            }
+            assert(!"FIXME: failed to pop");
+            return false;
+        }
+
+        /// @brief Find a matching token in the token list.
+        ///
+        /// @param in input string to try and locate in the token list.
+        const bool find(const std::string& in) const
+        {
+            for (const cmd_token_t& tok : tokens_) {
+                if (tok == in) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /// @brief Accessor for the tokens queue.
+        cmd_token_queue_t& operator()()
+        {
+            return tokens_;
+        }
+
+        /// @brief basic token arguments.
+        cmd_token_queue_t tokens_;
+        /// @brief raw tokens.
+        cmd_token_queue_t raw_;
+    } tokens;
+
+    /// @brief constructor.
+    ///
+    /// @param idents list of identifiers to substitute tokens with.
+    /// @param session session the tokens are executed in.
+    /// @param resource memory resource for the token storage.
+    cmd_tokens_t(
+        cmd_idents_t* idents,
+        struct cmd_session_t* session = nullptr,
+        std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : flags{ cmd_flag_set_t(resource) }
+        , pairs{ cmd_pair_map_t(resource) }
+        , tokens{ cmd_token_queue_t(resource), cmd_token_queue_t(resource) }
+        , idents_(idents)
+        , session_(session)
+        , cancel_(nullptr)
+        , line_(resource)
+    {
+    }
+
+    // tokens are views into line_ so a copy would leave them dangling
+    cmd_tokens_t(const cmd_tokens_t&) = delete;
+    cmd_tokens_t(cmd_tokens_t&&) = default;
+
+    /// @brief tokenize and input stream into a cmd_tokens_t instance.
+    ///
+    /// the input is copied once into an internal line buffer and all
+    /// tokens are views into that buffer, so no per token strings are
+    /// allocated.  tokens remain valid for the life of this instance or
+    /// until tokenize is called again.
+    ///
+    /// @param in input stream to tokenize.
+    /// @return number of tokens parsed.
+    size_t tokenize(const char* in);
+
+    /// @brief tokenize an input stream of a known length.
+    ///
+    /// @param in input stream to tokenize.
+    /// @param len length of the input stream.
+    /// @return number of tokens parsed.
+    size_t tokenize(const char* in, size_t len);
+
+    /// @brief tokenize a list of pre split tokens.
+    ///
+    /// each input is taken as a single token without splitting on white
+    /// space.  empty inputs are skipped.
+    ///
+    /// @param in list of tokens.
+    /// @return number of tokens parsed.
+    size_t tokenize(const std::vector<std::string_view>& in);
+
+    /// @brief the session executing these tokens.
+    ///
+    /// commands should keep per user state such as history and identifiers
+    /// in the session rather than the parser, which is shared.
+    struct cmd_session_t& session() const
+    {
+        assert(session_);
+        return *session_;
+    }
+
+    /// @brief check if the command should stop early.
+    ///
+    /// @return true if the command is a background job that was killed.
+    bool cancelled() const
+    {
+        return cancel_ && cancel_->cancelled();
+    }
+
+    /// @brief set the cancellation flag polled by cancelled().
+    void set_cancel(const cmd_cancel_t* cancel)
+    {
+        cancel_ = cancel;
+    }
+
+    /// @brief set the session returned by session().
+    void set_session(struct cmd_session_t* session)
+    {
+        session_ = session;
+    }
+
+protected:
+    /// @brief push a new token into this token list.
+    ///
+    /// @param str null terminated token string within line_.
+    /// @param len length of the token string.
+    void push(const char* str, size_t len);
+
+    /// @brief flush any staged flag into the flag set.
+    void flush();
+
+    /// @brief clear all tokens, flags and pairs.
+    void clear();
+
+    /// @brief list of identifiers that can be substituted for tokens.
+    cmd_idents_t* idents_;
+
+    /// @brief session executing these tokens.
+    struct cmd_session_t* session_;
+
+    /// @brief cancellation flag, null unless running as a background job.
+    const cmd_cancel_t* cancel_;
+
+    /// @brief line buffer that all token views point into.
+    std::pmr::vector<char> line_;
+
+    /// @brief staging area for pairs.
+    std::string_view stage_flag_;
+};
+
+/// @brief cmd_histogram_t, log2 bucketed latency histogram.
+///
+/// bucket i counts samples in the range [2^i, 2^(i+1)) nanoseconds with
+/// bucket 0 also holding zero.  counters are updated with relaxed atomics
+/// so that recording from several threads is safe but only approximately
+/// consistent while being read.
+///
+struct cmd_histogram_t {
+
+    /// @brief number of buckets.
+    static constexpr size_t buckets = 40;
+
+    cmd_histogram_t()
+    {
+        clear();
+    }
+
+    /// @brief record a sample.
+    ///
+    /// @param ns sample duration in nanoseconds.
+    void add(uint64_t ns)
+    {
+        bucket_[bucket(ns)].fetch_add(1, std::memory_order_relaxed);
+        total_.fetch_add(ns, std::memory_order_relaxed);
+    }
+
+    /// @brief number of samples recorded.
+    uint64_t count() const
+    {
+        uint64_t num = 0;
+        for (const auto& b : bucket_) {
+            num += b.load(std::memory_order_relaxed);
+        }
+        return num;
+    }
+
+    /// @brief sum of all samples in nanoseconds.
+    uint64_t total() const
+    {
+        return total_.load(std::memory_order_relaxed);
+    }
+
+    /// @brief samples recorded in a bucket.
+    uint64_t at(size_t index) const
+    {
+        return bucket_[index].load(std::memory_order_relaxed);
+    }
+
+    /// @brief estimate a percentile.
+    ///
+    /// @param p percentile in the range [0, 1].
+    /// @return upper bound of the bucket holding the percentile in nanoseconds.
+    uint64_t percentile(double p) const;
+
+    /// @brief reset all counters to zero.
+    void clear()
+    {
+        for (auto& b : bucket_) {
+            b.store(0, std::memory_order_relaxed);
+        }
+        total_.store(0, std::memory_order_relaxed);
+    }
+
+    /// @brief bucket index for a sample.
+    static size_t bucket(uint64_t ns)
+    {
+        size_t index = 0;
+        while (ns > 1 && index < buckets - 1) {
+            ns >>= 1;
+            ++index;
+        }
+        return index;
+    }
+
+protected:
+    std::array<std::atomic<uint64_t>, buckets> bucket_;
+    std::atomic<uint64_t> total_;
+};
+
+/// @brief cmd_metrics_t, invocation counters for a command.
+///
+/// cmd_parser_t::execute records the time spent tokenizing the input,
+/// dispatching it to a command and running the command handler.
+///
+struct cmd_metrics_t {
+
+    /// @brief phases of command execution.
+    enum phase_t {
+        e_tokenize,
+        e_dispatch,
+        e_execute,
+        e_phases
+    };
+
+    cmd_metrics_t()
+        : calls_(0)
+        , fails_(0)
+    {
+    }
+
+    /// @brief number of times the command was invoked.
+    uint64_t calls() const
+    {
+        return calls_.load(std::memory_order_relaxed);
+    }
+
+    /// @brief number of invocations that returned false.
+    uint64_t fails() const
+    {
+        return fails_.load(std::memory_order_relaxed);
+    }
+
+    /// @brief latency histogram for a phase.
+    const cmd_histogram_t& phase(phase_t phase) const
+    {
+        return phase_[phase];
+    }
+
+    /// @brief latency histogram for whole invocations.
+    const cmd_histogram_t& latency() const
+    {
+        return latency_;
+    }
+
+    /// @brief total nanoseconds spent in all phases.
+    uint64_t total() const
+    {
+        return latency_.total();
+    }
+
+    /// @brief record a single invocation.
+    ///
+    /// @param ns nanoseconds spent in each phase.
+    /// @param ok true if the command succeeded.
+    void record(const uint64_t (&ns)[e_phases], bool ok)
+    {
+        calls_.fetch_add(1, std::memory_order_relaxed);
+        if (!ok) {
+            fails_.fetch_add(1, std::memory_order_relaxed);
+        }
+        uint64_t sum = 0;
+        for (size_t i = 0; i < e_phases; ++i) {
+            phase_[i].add(ns[i]);
+            sum += ns[i];
+        }
+        latency_.add(sum);
+    }
+
+    /// @brief reset all counters to zero.
+    void clear()
+    {
+        calls_.store(0, std::memory_order_relaxed);
+        fails_.store(0, std::memory_order_relaxed);
+        for (auto& p : phase_) {
+            p.clear();
+        }
+        latency_.clear();
+    }
+
+protected:
+    std::atomic<uint64_t> calls_;
+    std::atomic<uint64_t> fails_;
+    cmd_histogram_t phase_[e_phases];
+    cmd_histogram_t latency_;
+};
+
+#if CMD_COROUTINES
+/// @brief cmd_task_t, coroutine returning the result of a command.
+///
+/// a task does nothing until it is awaited, at which point it runs until
+/// it first suspends.  once it completes the awaiting coroutine resumes
+/// with the result.  tasks are started from outside of a coroutine by
+/// cmd_loop_t::spawn.
+///
+struct cmd_task_t {
+
+    struct promise_type;
+    typedef std::coroutine_handle<promise_type> handle_t;
+
+    struct promise_type {
+
+        cmd_task_t get_return_object()
+        {
+            return cmd_task_t(handle_t::from_promise(*this));
+        }
+
+        std::suspend_always initial_suspend() noexcept
+        {
+            return {};
+        }
+
+        /// @brief resume the awaiting coroutine, if any, once complete.
+        struct final_t {
+            bool await_ready() noexcept
+            {
+                return false;
+            }
+
+            std::coroutine_handle<> await_suspend(handle_t self) noexcept
+            {
+                const std::coroutine_handle<> next = self.promise().continuation_;
+                return next ? next : std::noop_coroutine();
+            }
+
+            void await_resume() noexcept {}
+        };
+
+        final_t final_suspend() noexcept
+        {
+            return {};
+        }
+
+        void return_value(bool ok)
+        {
+            result_ = ok;
+        }
+
+        void unhandled_exception()
+        {
+            std::terminate();
+        }
+
+        bool result_ = false;
+        std::coroutine_handle<> continuation_;
+    };
+
+    cmd_task_t(cmd_task_t&& other) noexcept
+        : handle_(other.handle_)
+    {
+        other.handle_ = nullptr;
+    }
+
+    cmd_task_t(const cmd_task_t&) = delete;
+
+    ~cmd_task_t()
+    {
+        if (handle_) {
+            handle_.destroy();
+        }
+    }
+
+    bool await_ready() const noexcept
+    {
+        return handle_.done();
+    }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept
+    {
+        handle_.promise().continuation_ = awaiter;
+        return handle_;
+    }
+
+    bool await_resume() const noexcept
+    {
+        return handle_.promise().result_;
+    }
+
+protected:
+    explicit cmd_task_t(handle_t handle)
+        : handle_(handle)
+    {
+    }
+
+    handle_t handle_;
+};
+#endif
+
+/// @brief cmd_t, the command base class.
+///
+/// this is the base command class that should be extended to handle custom commands.
+/// a cmd_t can be a child of another command or inserted into a cmd_parser_t as a root command.
+/// two key methods can be overriden, on_execute and on_usage which the cmd_parser_t will invoke based on user input.
+///
+struct cmd_t {
+
+    /// @brief command name.
+    const char* const name_;
+
+    /// @brief owning command parser.
+    struct cmd_parser_t& parser_;
+
+    /// @brief opaque user data for this command.
+    cmd_baton_t user_;
+
+    /// @brief the parent if this is a child command.
+    cmd_t* parent_;
+
+    /// @brief list of child commands.
+    cmd_list_t sub_;
+
+    /// @brief prefix index over the child commands.
+    cmd_index_t index_;
+
+    /// @brief command argument string.
+    const char* usage_;
+
+    /// @brief command description string.
+    const char* desc_;
+
+    /// @brief set if the command may run concurrently with other commands.
+    ///
+    /// neighbouring commands in a '&&' delimited group that have this set
+    /// are executed together on the parser worker pool.  on_execute must then be thread safe and
+    /// should not modify session state, as other commands of the group
+    /// may be running in the same session.
+    bool parallel_;
+
+#if CMD_STATS
+    /// @brief invocation statistics for this command.
+    cmd_metrics_t metrics_;
+#endif
+
+    /// @brief cmd_t constructor.
+    ///
+    /// @param const char* name, the name of this command.
+    /// @param cmd_t* parent, the parent cmd_t instance.
+    /// @param cmd_baton_t user, the opaque user data passed to this cmd_t instance.
+    cmd_t(const char* name,
+        cmd_parser_t& parser,
+        cmd_t* parent,
+        cmd_baton_t user = nullptr)
+        : name_(name)
+        , parser_(parser)
+        , user_(user)
+        , parent_(parent)
+        , sub_()
+        , index_()
+        , usage_(nullptr)
+        , desc_(nullptr)
+        , parallel_(false)
+    {
+    }
+
+    /// @brief Add child command to this command.
+    ///
+    /// instanciate and attach a new child command to this parent command
+    /// supplying this commands user_ data during its construction.
+    ///
+    /// @return the new cmd_t instance.
+    template <typename type_t>
+    type_t* add_sub_command()
+    {
+        return add_sub_command<type_t>(user_);
+    }
+
+    /// @brief Add child command to this command.
+    ///
+    /// instanciate and attach a new child command to this parent command.
+    ///
+    /// @param user opaque user data to pass to the new child cmd_t.
+    /// @return the new cmd_t instance.
+    template <typename type_t>
+    type_t* add_sub_command(cmd_baton_t user)
+    {
+        auto temp = std::unique_ptr<type_t>(new type_t(parser_, this, user));
+        sub_.push_back(std::move(temp));
+        cmd_t* cmd = sub_.rbegin()->get();
+        index_.insert(cmd, cmd->name_);
+        on_tree_changed();
+        return (type_t*)cmd;
+    }
+
+    /// @brief Command execution handler.
+    ///
+    /// Virtual function that will be called when the user specifies is full path or an alias to this command.
+    /// If this command is ternimal then any following input tokens will be passed to this handler.
+    /// The caller provided output stream is also passed to the called command execution handler.
+    ///
+    /// @param tok token list of arguments supplied by the user.
+    /// @param out text output stream for writing results to.
+    /// @param user user data passed to the command from cmd_parser_t::execute().
+    /// @return true if the command executed successfully.
+    virtual bool on_execute(cmd_tokens_t& tok, cmd_output_t& out, cmd_baton_t user);
+
+#if CMD_COROUTINES
+    /// @brief Coroutine command execution handler.
+    ///
+    /// called in place of on_execute by cmd_session_t::execute_async, so a
+    /// command can co_await timers and file descriptors of a cmd_loop_t
+    /// without tying up a thread.  the default calls on_execute.  the
+    /// tokens and output remain valid until the task completes.
+    ///
+    /// @param tok token list of arguments supplied by the user.
+    /// @param out text output stream for writing results to.
+    /// @param user user data passed to the command from execute_async().
+    /// @return task completing with true if the command executed successfully.
+    virtual cmd_task_t on_execute_async(cmd_tokens_t& tok, cmd_output_t& out, cmd_baton_t user);
+#endif
+
+    /// @brief Return string with hierarchy of parent commands.
+    ///
+    /// @param out the string to store output hierarchy.
+    void get_command_path(std::string& out) const
+    {
+        if (parent_) {
+            parent_->get_command_path(out);
+            out.append(" ");
+        }
+        out.append(name_);
+    }
+
+    /// @brief Print command usage information to output stream.
+    ///
+    /// @param out output stream to print to
+    /// @return true if usage was written successfully
+    virtual bool on_usage(cmd_output_t& out, cmd_baton_t user) const
+    {
+        (void)user;
+        cmd_output_t::indent_t indent = out.indent(2);
+        std::string path;
+        get_command_path(path);
+        cmd_locale_t::usage(out, path.c_str(), usage_, desc_);
+        if (!sub_.empty()) {
+            cmd_locale_t::subcommands(out);
+            print_sub_commands(out);
+        }
+        return true;
+    }
+
+protected:
+    /// @brief Notify the parser that the command tree has been modified.
+    void on_tree_changed();
+
+    /// @brief Add an alias for this command.
+    ///
+    /// bind a cmt_t instance to a single string token known as an alias.
+    /// during command interpretation if the first token matches any alises then the associated cmd_t instance will be executed.
+    ///
+    /// @param name the string name of the alias to add.
+    /// @return true if the alias was associated successfully.
+    bool alias_add(const std::string& name);
+
+    /// @brief Report an error condition to the output stream.
+    ///
+    /// @param out output stream.
+    /// @param fmt input format string.
+    /// @param ... variable args.
+    /// @return false so it can be propagated via return statements easily.
+    bool error(cmd_output_t& out, const char* fmt, ...)
+    {
+        va_list args;
+        va_start(args, fmt);
+        out.println(fmt, args);
+        va_end(args);
+        return false;
+    }
+
+    /// @brief Print a list of command names to an output stream.
+    ///
+    /// @param list input command list.
+    /// @param out output stream to write command names to.
+    void print_cmd_list(const cmd_list_t& list, cmd_output_t& out) const
+    {
+        cmd_output_t::indent_t indent = out.indent(2);
+        for (const auto& cmd : list) {
+            out.println("%s", cmd->name_);
+        }
+    }
+
+    /// @brief Print a list of child commands to the output stream.
+    ///
+    /// @param out output stream to write command names to.
+    void print_sub_commands(cmd_output_t& out) const
+    {
+        print_cmd_list(sub_, out);
+    }
+};
+
+/// @brief cmd_alias_map_t, map of alias names to command instances.
+///
+typedef std::map<std::string, cmd_t*, std::less<>> cmd_alias_map_t;
+
+/// @brief cmd_frozen_t, flattened read only layout of a command tree.
+///
+/// once an application has finished registering commands the tree can be
+/// frozen into contiguous structure of arrays tables.  nodes are laid out
+/// breadth first so the children of any node occupy a contiguous index
+/// range, names are interned into a single buffer with their lengths and
+/// hashes precomputed, and alias names are held in an open addressing table.
+///
+struct cmd_frozen_t {
+
+    /// @brief invalid node index, also used as the parent of root commands.
+    static constexpr uint32_t npos = ~0u;
+
+    /// @brief flatten a command tree and its aliases.
+    ///
+    /// @param roots list of root commands.
+    /// @param alias map of alias names to command instances.
+    void build(const cmd_list_t& roots, const cmd_alias_map_t& alias);
+
+    /// @brief rebuild only the alias table.
+    ///
+    /// @param alias map of alias names to command instances.
+    void build_alias(const cmd_alias_map_t& alias);
+
+    /// @brief find child nodes that best match a token.
+    ///
+    /// follows the same rules as cmd_index_t::find.
+    ///
+    /// @param parent parent node index or npos for the root commands.
+    /// @param sub token to match against command names.
+    /// @param out output list to receive matching node indices.
+    /// @return number of nodes matched.
+    size_t find(uint32_t parent, const std::string_view& sub, std::vector<uint32_t>& out) const;
+
+    /// @brief find the node an alias refers to.
+    ///
+    /// @param alias name of the alias.
+    /// @return node index otherwise npos.
+    uint32_t alias_find(const std::string_view& alias) const;
+
+    /// @brief number of nodes in the tree.
+    uint32_t size() const
+    {
+        return uint32_t(cmd_.size());
+    }
+
+    /// @brief interned name of a node, null terminated.
+    std::string_view name(uint32_t node) const
+    {
+        return std::string_view(names_.data() + name_off_[node], name_len_[node]);
+    }
+
+    /// @brief command instance for a node.
+    cmd_t* cmd(uint32_t node) const
+    {
+        return cmd_[node];
+    }
+
+    /// @brief first child node index.
+    ///
+    /// @param parent parent node index or npos for the root commands.
+    uint32_t child_begin(uint32_t parent) const
+    {
+        return parent == npos ? 0 : child_begin_[parent];
+    }
+
+    /// @brief one past the last child node index.
+    ///
+    /// @param parent parent node index or npos for the root commands.
+    uint32_t child_end(uint32_t parent) const
+    {
+        return parent == npos ? root_end_ : child_end_[parent];
+    }
+
+protected:
+    // per node tables
+    std::vector<uint32_t> name_off_;
+    std::vector<uint32_t> name_len_;
+    std::vector<uint32_t> name_hash_;
+    std::vector<uint32_t> parent_;
+    std::vector<uint32_t> child_begin_;
+    std::vector<uint32_t> child_end_;
+    std::vector<cmd_t*> cmd_;
+    /// @brief set if a sibling shares the same name.
+    std::vector<uint8_t> dup_;
+    /// @brief node indices sorted by name within each child range.
+    std::vector<uint32_t> sorted_;
+    /// @brief interned node names.
+    std::vector<char> names_;
+    uint32_t root_end_ = 0;
+
+    /// @brief (parent, name) to node open addressing table, entries are node + 1.
+    std::vector<uint32_t> exact_;
+
+    // alias tables
+    std::vector<uint32_t> alias_off_;
+    std::vector<uint32_t> alias_len_;
+    std::vector<uint32_t> alias_hash_;
+    std::vector<uint32_t> alias_node_;
+    /// @brief alias open addressing table, entries are alias index + 1.
+    std::vector<uint32_t> alias_slot_;
+    std::vector<char> alias_names_;
+
+    /// @brief reverse lookup used when resolving aliases.
+    std::map<const cmd_t*, uint32_t> node_of_;
+
+    /// @brief lookup an exact child name using the hash table.
+    uint32_t find_exact(uint32_t parent, const std::string_view& sub, uint32_t hash) const;
+};
+
+/// @brief cmd_fuzzy_t, fuzzy index over every command path and alias.
+///
+/// a BK-tree keyed on levenshtein distance holding the full path of every
+/// command in the tree (eg. "expr eval") along with every alias name.  a
+/// query only visits the branches that can contain keys within the search
+/// radius, so suggestions do not require a scan of the whole tree.
+///
+struct cmd_fuzzy_t {
+
+    /// @brief a single query result.
+    struct match_t {
+        /// @brief command the key refers to.
+        cmd_t* cmd_;
+        /// @brief full command path or alias name, null terminated.
+        std::string_view key_;
+        /// @brief edit distance from the query.
+        uint32_t distance_;
+        /// @brief insertion order, commands are inserted depth first.
+        uint32_t ordinal_;
+        /// @brief true if the key is an alias name.
+        bool alias_;
+    };
+
+    /// @brief rebuild the index from a command tree.
+    ///
+    /// @param roots list of root commands.
+    /// @param alias map of alias names to command instances.
+    void build(const cmd_list_t& roots, const cmd_alias_map_t& alias);
+
+    /// @brief find all keys within a given edit distance.
+    ///
+    /// @param key query string.
+    /// @param max largest edit distance to report.
+    /// @param out output list to receive matches ordered by insertion.
+    /// @return number of matches found.
+    size_t find(const std::string_view& key, uint32_t max, std::vector<match_t>& out) const;
+
+    /// @brief find the closest keys within a given edit distance.
+    ///
+    /// @param key query string.
+    /// @param k maximum number of matches to report.
+    /// @param max largest edit distance to report.
+    /// @param out output list to receive matches ordered by distance.
+    /// @return number of matches found.
+    size_t nearest(const std::string_view& key, size_t k, uint32_t max, std::vector<match_t>& out) const;
+
+    /// @brief number of keys in the index.
+    size_t size() const
+    {
+        return nodes_.size();
+    }
+
+protected:
+    struct node_t {
+        uint32_t key_off_;
+        uint32_t key_len_;
+        cmd_t* cmd_;
+        bool alias_;
+        /// @brief (edge distance, node index) pairs.
+        std::vector<std::pair<uint32_t, uint32_t>> child_;
+    };
+
+    /// @brief add a key to the tree.
+    void insert(const std::string& key, cmd_t* cmd, bool alias);
+
+    /// @brief add a command and all of its children.
+    void insert(const cmd_t* cmd, std::string& path);
+
+    /// @brief key string of a node.
+    const char* key(uint32_t node) const
+    {
+        return keys_.data() + nodes_[node].key_off_;
+    }
+
+    /// @brief make a match result for a node.
+    match_t match(uint32_t node, uint32_t distance) const;
+
+    /// @brief visit all nodes within a radius of a query key.
+    ///
+    /// the radius may be tightened by the visitor as results are found.
+    template <typename visit_t>
+    void search(const std::string& key, uint32_t& max, visit_t visit) const;
+
+    std::vector<node_t> nodes_;
+    /// @brief interned keys, null terminated.
+    std::vector<char> keys_;
+};
+
+/// @brief cmd_pool_t, work stealing thread pool.
+///
+/// each worker thread owns a deque of jobs.  a batch is spread over the
+/// worker deques, a worker takes jobs from the back of its own deque and
+/// once that is empty steals from the front of the others.  the thread
+/// that submitted a batch also runs jobs until the batch completes, so a
+/// job may itself submit a batch without starving the pool.  tasks can also
+/// be submitted without waiting for them, they are then run only by the
+/// workers, roughly in the order submitted, as each becomes free.
+///
+struct cmd_pool_t {
+
+    typedef std::function<void()> task_t;
+
+    /// @brief constructor.
+    ///
+    /// @param threads number of worker threads, at least one.
+    cmd_pool_t(uint32_t threads);
+
+    ~cmd_pool_t();
+
+    cmd_pool_t(const cmd_pool_t&) = delete;
+
+    /// @brief run a batch of tasks and wait for all of them to complete.
+    ///
+    /// @param tasks tasks to run, in no particular order.
+    void run(std::vector<task_t>& tasks);
+
+    /// @brief queue a task to run on a worker without waiting for it.
+    ///
+    /// tasks still queued when the pool is destroyed are run first.
+    ///
+    /// @param task task to run.
+    void submit(task_t task);
+
+    /// @brief number of worker threads.
+    uint32_t size() const
+    {
+        return uint32_t(threads_.size());
+    }
+
+protected:
+    struct batch_t;
+    struct job_t;
+    struct queue_t;
+
+    /// @brief worker thread main loop.
+    void worker(size_t home);
+
+    /// @brief take a job, from the home deque first then from any other.
+    bool take(size_t home, job_t& out);
+
+    /// @brief run a job and mark it done in its batch.
+    void execute(job_t& job);
+
+    std::vector<std::unique_ptr<queue_t>> queues_;
+    std::vector<std::thread> threads_;
+    /// @brief number of jobs held in all deques.
+    std::atomic<size_t> queued_;
+    /// @brief deque the next job is pushed to.
+    std::atomic<size_t> next_;
+    /// @brief guards sleeping workers.
+    std::mutex mux_;
+    std::condition_variable wake_;
+    bool stop_;
+};
+
+/// @brief cmd_job_t, a command running in the background.
+///
+/// a job is shared by the job list and the task queued to run it, so a job
+/// killed while still queued can be dropped without waiting for a worker.
+///
+struct cmd_job_t {
+
+    enum {
+        e_queued,
+        e_running,
+        e_done,
+    };
+
+    /// @brief constructor.
+    ///
+    /// @param id job number.
+    /// @param expr command expression.
+    /// @param idents identifiers to substitute tokens with.
+    /// @param session session starting the job.
+    cmd_job_t(uint32_t id, const std::string& expr, cmd_idents_t* idents, struct cmd_session_t* session);
+
+    /// @brief check if the command has returned.
+    bool done() const
+    {
+        return state_.load(std::memory_order_acquire) == e_done;
+    }
+
+    /// @brief request the command stop, a job not yet started is done at once.
+    void cancel();
 
-    struct {
-        /// @brief check if a flag was passed to the token list.
-        ///
-        /// @return true if 'name' flag was passed as an argument.
-        bool get(const std::string& name) const
-        {
-            return !(flags_.find(name) == flags_.end());
-        }
+    /// @brief claim a queued job to run it.
+    ///
+    /// @return false if the job was cancelled before it started.
+    bool start();
 
-        /// @brief check if the flag set is empty.
-        ///
-        /// @return true if the flags set is empty, otherwise false.
-        bool empty() const
-        {
-            return flags_.empty();
-        }
+    /// @brief note the command has returned.
+    void finish(bool ok);
 
-        /// @brief command token flags.
-        std::set<std::string> flags_;
-    } flags;
+    /// @brief block until the command has returned.
+    void join();
 
-    struct {
-        /// @brief retreive the argument to a passed token pair.
-        ///
-        /// @return true if the pair was in the token list.
-        bool get(const std::string& name, cmd_token_t& out) const
-        {
-            auto itt = pairs_.find(name);
-            if (itt == pairs_.end()) {
-                return false;
-            } else {
-                return (out = itt->second), true;
-            }
-        }
+    /// @brief job number.
+    const uint32_t id_;
 
-        /// @brief check if the pairs map is empty.
-        ///
-        /// @return true if the pairs set is empty, otherwise false.
-        bool empty() const
-        {
-            return pairs_.empty();
-        }
+    /// @brief command expression.
+    const std::string expr_;
 
-        /// @brief key value pair arguments.
-        std::map<std::string, cmd_token_t> pairs_;
-    } pairs;
+    /// @brief set by kill.
+    cmd_cancel_t cancel_;
 
-    struct {
-        /// @brief return number of tokens in the token list.
-        ///
-        /// @return number of tokens in the token list.
-        size_t size() const
-        {
-            return tokens_.size();
-        }
+    /// @brief output captured while running.
+    std::unique_ptr<cmd_output_buffer_t> out_;
 
-        /// @brief get the front most token from the token list.
-        ///
-        /// @return true if the front most token could be retrived.
-        bool get(std::string& out)
-        {
-            if (tokens_.empty()) {
-                return false;
-            }
-            out = tokens_.front().get();
-            tokens_.pop_front();
-            return true;
-        }
+    /// @brief arguments of the command.
+    cmd_tokens_t tokens_;
 
-        /// @brief get the front most token from the token list.
-        ///
-        /// @param output to receive front most token.
-        /// @return true if the front most token could be retrived.
-        bool get(cmd_token_t& out)
-        {
-            if (tokens_.empty()) {
-                return false;
-            }
-            out = tokens_.front();
-            tokens_.pop_front();
-            return true;
-        }
+    /// @brief e_queued, e_running or e_done, set done under mux_ for join().
+    std::atomic<uint32_t> state_;
+    std::mutex mux_;
+    std::condition_variable returned_;
 
-        /// @brief get the front most token from the token list as an integer.
-        ///
-        /// @param output to receive the front most token.
-        /// @return true if the front most token could be interpreted as integer.
-        bool get(uint64_t& out)
-        {
-            if (!tokens_.empty()) {
-                if (front().get(out)) {
-                    tokens_.pop_front();
-                    return true;
-                }
-            }
-            return false;
-        }
+    /// @brief command result, valid once done.
+    bool ok_;
+};
 
-        /// @brief check if the token list is empty.
-        ///
-        /// @return true if the token list is empty.
-        bool empty() const
-        {
-            return tokens_.empty();
-        }
+/// @brief cmd_job_list_t, background jobs started by a session.
+///
+/// jobs are kept until they are waited for, or until they are reaped once
+/// done, which the session does after each line it executes so jobs that
+/// are never waited for do not build up.  destroying the list cancels every
+/// job still running and waits for it to return.
+///
+struct cmd_job_list_t {
 
-        /// @brief return a reference to the first token in the queue.
-        ///
-        /// @return reference to first token.
-        const cmd_token_t& front() const
+    cmd_job_list_t()
+        : next_(1)
+    {
+    }
+
+    ~cmd_job_list_t();
+
+    /// @brief number the next job will be given.
+    uint32_t next_id() const
+    {
+        return next_;
+    }
+
+    /// @brief take ownership of a started job.
+    void add(std::shared_ptr<cmd_job_t> job);
+
+    /// @brief find a job by number.
+    ///
+    /// @return job otherwise nullptr.
+    cmd_job_t* find(uint32_t id) const;
+
+    /// @brief request a job stop.
+    ///
+    /// @return true if the job exists.
+    bool kill(uint32_t id);
+
+    /// @brief wait for a job to complete and write its output.
+    ///
+    /// the job is removed once it completes and a failure is reported.
+    ///
+    /// @param id job number.
+    /// @param out output to write the job output to.
+    /// @return true if the job exists.
+    bool wait(uint32_t id, cmd_output_t& out);
+
+    /// @brief remove the jobs that are done, reporting them and their output.
+    ///
+    /// @param out output to write the jobs to.
+    /// @return number of jobs removed.
+    size_t reap(cmd_output_t& out);
+
+    /// @brief all jobs ordered by number.
+    const std::vector<std::shared_ptr<cmd_job_t>>& list() const
+    {
+        return jobs_;
+    }
+
+protected:
+    /// @brief join a removed job and write its output.
+    void finish(cmd_job_t& job, cmd_output_t& out);
+
+    std::vector<std::shared_ptr<cmd_job_t>> jobs_;
+    uint32_t next_;
+};
+
+/// @brief cmd_history_list_t, bounded history of input lines.
+///
+/// lines are interned one after another into a single ring of bytes, with a
+/// ring of entries indexing them.  the rings grow until they hold the lines
+/// kept, after which recording a line reuses the space of the oldest lines
+/// and never allocates.  a line that repeats the one before it is not recorded again.
+///
+/// every recorded line is numbered from 1 in the order it was added, so a
+/// number keeps referring to the same line as older lines are dropped.
+///
+struct cmd_history_list_t {
+
+    /// @brief iterator over the lines, oldest first.
+    struct const_iterator {
+
+        const_iterator(const cmd_history_list_t* list, size_t index)
+            : list_(list)
+            , index_(index)
         {
-            return tokens_.front();
         }
 
-        /// @brief return a reference to the last token in the queue.
-        ///
-        /// @return reference to last token.
-        const cmd_token_t& back() const
+        std::string_view operator*() const
         {
-            return tokens_.back();
+            return (*list_)[index_];
         }
 
-        /// @brief pop front most argument from token list.
-        ///
-        /// @return true if front argument was popped.
-        bool pop()
+        const_iterator& operator++()
         {
-            if (!tokens_.empty()) {
-                assert(!raw_.empty());
-                if (raw_.front() == tokens_.front()) {
-                    // pop prefixed tokens
-                    raw_.pop_front();
-                    tokens_.pop_front();
-                    return true;
-                }
-            }
-            assert(!"FIXME: failed to pop");
-            return false;
+            ++index_;
+            return *this;
         }
 
-        /// @brief Find a matching token in the token list.
-        ///
-        /// @param in input string to try and locate in the token list.
-        const bool find(const std::string& in) const
+        bool operator==(const const_iterator& other) const
         {
-            for (const cmd_token_t& tok : tokens_) {
-                if (tok == in) {
-                    return true;
-                }
-            }
-            return false;
+            return index_ == other.index_;
         }
 
-        /// @brief Accessor for the tokens deque.
-        std::deque<cmd_token_t>& operator()()
+        bool operator!=(const const_iterator& other) const
         {
-            return tokens_;
+            return index_ != other.index_;
         }
 
-        /// @brief basic token arguments.
-        std::deque<cmd_token_t> tokens_;
-        /// @brief raw tokens.
-        std::deque<cmd_token_t> raw_;
-    } tokens;
+    protected:
+        const cmd_history_list_t* list_;
+        size_t index_;
+    };
 
     /// @brief constructor.
     ///
-    /// @param idents list of identifiers to substitute tokens with.
-    cmd_tokens_t(cmd_idents_t* idents)
-        : idents_(idents)
+    /// @param resource resource the rings are allocated from.
+    /// @param lines maximum number of lines kept.
+    /// @param bytes maximum number of bytes of line text kept.
+    cmd_history_list_t(
+        std::pmr::memory_resource* resource = std::pmr::get_default_resource(),
+        size_t lines = 1024,
+        size_t bytes = 64 * 1024)
+        : text_(resource)
+        , entries_(resource)
+        , first_(0)
+        , count_(0)
+        , head_(0)
+        , used_(0)
+        , next_(1)
+        , lines_(lines)
+        , bytes_(std::min<size_t>(bytes, UINT32_MAX))
     {
     }
 
-    /// @brief tokenize and input stream into a cmd_tokens_t instance.
+    /// @brief Record a line, dropping the oldest lines to make room.
     ///
-    /// @param in input stream to tokenize.
-    /// @param out output cmd_tokens_t instance to populate.
-    /// @return number of tokens parsed.
-    size_t tokenize(const char* in);
+    /// the line may be one already held in the history.
+    ///
+    /// @return false if the line repeats the last line or does not fit.
+    bool push(const std::string_view& line);
 
-protected:
-    /// @brief push a new token into this token list.
+    /// @brief Change the limits, dropping the oldest lines to fit.
+    void set_limit(size_t lines, size_t bytes);
+
+    /// @brief Get a line by number.
     ///
-    /// @param string token to push onto list.
-    void push(std::string input);
+    /// @return false if the line was dropped or never recorded.
+    bool find(uint64_t number, std::string_view& line) const;
 
-    /// @brief list of identifiers that can be substituted for tokens.
-    cmd_idents_t* idents_;
+    /// @brief Recall a line by a '!' history event.
+    ///
+    /// "!!" is the last line, "!n" is line number n and "!-n" the line n
+    /// back from the end.
+    ///
+    /// @param event expression that may be a history event.
+    /// @param line receives the line, empty if the event names no line.
+    /// @return true if the expression is a history event.
+    bool recall(const std::string_view& event, std::string_view& line) const;
 
-    /// @brief staging area for pairs.
-    std::pair<std::string, cmd_token_t> stage_pair_;
-};
+    /// @brief Drop all lines, numbering carries on from where it was.
+    void clear()
+    {
+        first_ = 0;
+        count_ = 0;
+        head_ = 0;
+        used_ = 0;
+    }
 
-/// @brief cmd_t, the command base class.
-///
-/// this is the base command class that should be extended to handle custom commands.
-/// a cmd_t can be a child of another command or inserted into a cmd_parser_t as a root command.
-/// two key methods can be overriden, on_execute and on_usage which the cmd_parser_t will invoke based on user input.
-///
-struct cmd_t {
+    /// @brief number of lines held.
+    size_t size() const
+    {
+        return count_;
+    }
 
-    /// @brief command name.
-    const char* const name_;
+    bool empty() const
+    {
+        return count_ == 0;
+    }
 
-    /// @brief owning command parser.
-    struct cmd_parser_t& parser_;
+    /// @brief Get a line, 0 being the oldest.
+    ///
+    /// the view is null terminated and valid until the next push().
+    std::string_view operator[](size_t index) const
+    {
+        assert(index < count_);
+        const entry_t& e = entry(index);
+        return std::string_view(text_.data() + e.off_, e.len_);
+    }
 
-    /// @brief opaque user data for this command.
-    cmd_baton_t user_;
+    /// @brief the most recent line.
+    std::string_view back() const
+    {
+        return (*this)[count_ - 1];
+    }
 
-    /// @brief the parent if this is a child command.
-    cmd_t* parent_;
+    /// @brief number of the oldest line held.
+    uint64_t first_number() const
+    {
+        return next_ - count_;
+    }
 
-    /// @brief list of child commands.
-    cmd_list_t sub_;
+    /// @brief number the next recorded line will get.
+    uint64_t next_number() const
+    {
+        return next_;
+    }
 
-    /// @brief command argument string.
-    const char* usage_;
+    size_t lines_limit() const
+    {
+        return lines_;
+    }
 
-    /// @brief command description string.
-    const char* desc_;
+    size_t bytes_limit() const
+    {
+        return bytes_;
+    }
 
-    /// @brief cmd_t constructor.
-    ///
-    /// @param const char* name, the name of this command.
-    /// @param cmd_t* parent, the parent cmd_t instance.
-    /// @param cmd_baton_t user, the opaque user data passed to this cmd_t instance.
-    cmd_t(const char* name,
-        cmd_parser_t& parser,
-        cmd_t* parent,
-        cmd_baton_t user = nullptr)
-        : name_(name)
-        , parser_(parser)
-        , user_(user)
-        , parent_(parent)
-        , sub_()
-        , usage_(nullptr)
-        , desc_(nullptr)
+    const_iterator begin() const
+    {
+        return const_iterator(this, 0);
+    }
+
+    const_iterator end() const
+    {
+        return const_iterator(this, count_);
+    }
+
+protected:
+    struct entry_t {
+        uint32_t off_;
+        uint32_t len_;
+        uint32_t hash_;
+    };
+
+    const entry_t& entry(size_t index) const
     {
+        return entries_[(first_ + index) % entries_.size()];
     }
 
-    /// @brief Add child command to this command.
-    ///
-    /// instanciate and attach a new child command to this parent command
-    /// supplying this commands user_ data during its construction.
+    /// @brief Drop the oldest line.
+    void drop();
+
+    /// @brief line text, each null terminated.
+    std::pmr::vector<char> text_;
+
+    /// @brief ring of lines, starting at first_.
+    std::pmr::vector<entry_t> entries_;
+
+    size_t first_;
+    size_t count_;
+
+    /// @brief offset in text_ the next line is written to.
+    size_t head_;
+
+    /// @brief bytes taken by the lines held.
+    size_t used_;
+
+    /// @brief number given to the next line.
+    uint64_t next_;
+
+    size_t lines_;
+    size_t bytes_;
+};
+
+/// @brief cmd_memory_t, memory resources used by the sessions of a parser.
+///
+/// each session keeps a pool for its long lived state, the history and
+/// identifiers, and a monotonic arena for the tokens of the commands being
+/// executed which is released once execute() returns.  both draw on the
+/// upstream resource, which must be safe to use from several threads if
+/// sessions execute concurrently.
+///
+struct cmd_memory_t {
+
+    /// @brief constructor.
     ///
-    /// @return the new cmd_t instance.
-    template <typename type_t>
-    type_t* add_sub_command()
+    /// @param upstream resource that session pools allocate from.
+    /// @param arena bytes set aside for the arena of each session.
+    /// @param history_lines maximum lines in the history of each session.
+    /// @param history_bytes maximum bytes in the history of each session.
+    cmd_memory_t(
+        std::pmr::memory_resource* upstream = std::pmr::get_default_resource(),
+        size_t arena = 4096,
+        size_t history_lines = 1024,
+        size_t history_bytes = 64 * 1024)
+        : upstream_(upstream)
+        , arena_(arena)
+        , history_lines_(history_lines)
+        , history_bytes_(history_bytes)
     {
-        return add_sub_command<type_t>(user_);
     }
 
-    /// @brief Add child command to this command.
+    /// @brief resource that session pools allocate from.
+    std::pmr::memory_resource* upstream_;
+
+    /// @brief bytes set aside for the arena of each session, commands
+    /// needing more spill over into the session pool.
+    size_t arena_;
+
+    /// @brief limits of the history of each session, see cmd_history_list_t.
+    size_t history_lines_;
+    size_t history_bytes_;
+};
+
+/// @brief cmd_session_t, per user state for executing commands.
+///
+/// a session holds the input history and identifiers of one user, along
+/// with any per user state that commands keep, and executes input against
+/// the command tree of a cmd_parser_t.  the command tree is shared and only
+/// read while executing, so many sessions may execute concurrently from
+/// different threads without a global lock.  a session itself must only be
+/// used by one thread at a time, and indentation is held by the output so
+/// each session should write to its own output.
+///
+/// commands must all be added before sessions start executing, aliases may
+/// be changed at any time.
+///
+struct cmd_session_t {
+
+    /// @brief base for per session state kept by a command.
+    struct state_t {
+        virtual ~state_t() {}
+    };
+
+    /// @brief constructor.
     ///
-    /// instanciate and attach a new child command to this parent command.
+    /// memory is taken from the resources the parser was given.
     ///
-    /// @param user opaque user data to pass to the new child cmd_t.
-    /// @return the new cmd_t instance.
-    template <typename type_t>
-    type_t* add_sub_command(cmd_baton_t user)
-    {
-        auto temp = std::unique_ptr<type_t>(new type_t(parser_, this, user));
-        sub_.push_back(std::move(temp));
-        return (type_t*)sub_.rbegin()->get();
-    }
+    /// @param parser parser that owns the command tree.
+    cmd_session_t(struct cmd_parser_t& parser);
 
-    /// @brief Command execution handler.
+    // state_ is keyed by command so sessions are not copied
+    cmd_session_t(const cmd_session_t&) = delete;
+
+    /// @brief Execute ';' delimited expressions in this session.
     ///
-    /// Virtual function that will be called when the user specifies is full path or an alias to this command.
-    /// If this command is ternimal then any following input tokens will be passed to this handler.
-    /// The caller provided output stream is also passed to the called command execution handler.
+    /// each ';' delimited expression may be a group of '&&' delimited
+    /// commands that can run concurrently.  consecutive commands of a group
+    /// that are marked parallel_ run together on the parser worker pool,
+    /// any other command waits for them and runs on the calling thread
+    /// before later commands are resolved, so they see what it changed.
+    /// the output of each command is captured and written in the order the
+    /// commands were given, and a failure stops the rest of the group and
+    /// any later ';' expressions.
     ///
-    /// @param tok token list of arguments supplied by the user.
-    /// @param out text output stream for writing results to.
-    /// @param user user data passed to the command from cmd_parser_t::execute().
+    /// an expression ending in '&' is started as a background job and its
+    /// output is held until it is waited for.  only parallel_ commands can
+    /// run in the background, and they should poll cmd_tokens_t::cancelled().
+    ///
+    /// @param expr a list of ';' delimited expression strings to execute.
+    /// @param output output stream that can be written to during execution.
+    /// @param user additional user data to pass to command.
     /// @return true if the command executed successfully.
-    virtual bool on_execute(cmd_tokens_t& tok, cmd_output_t& out, cmd_baton_t user);
+    bool execute(
+        const std::string& expr,
+        cmd_output_t* output,
+        cmd_baton_t user);
 
-    /// @brief Return string with hierarchy of parent commands.
+#if CMD_COROUTINES
+    /// @brief Execute ';' delimited expressions, awaiting coroutine commands.
     ///
-    /// @param out the string to store output hierarchy.
-    void get_command_path(std::string& out) const
-    {
-        if (parent_) {
-            parent_->get_command_path(out);
-            out.append(" ");
-        }
-        out.append(name_);
-    }
+    /// behaves as execute() but each command is run through on_execute_async
+    /// so the session can be suspended while a command waits.  '&&' groups
+    /// and '&' jobs run as they do in execute().  the output must remain
+    /// valid until the task completes and the session must not execute
+    /// anything else in the meantime.  the output lock is not held while
+    /// suspended.
+    ///
+    /// @param expr a list of ';' delimited expression strings to execute.
+    /// @param output output stream that can be written to during execution.
+    /// @param user additional user data to pass to command.
+    /// @return task completing with true if the command executed successfully.
+    cmd_task_t execute_async(
+        std::string expr,
+        cmd_output_t* output,
+        cmd_baton_t user);
+#endif
 
-    /// @brief Print command usage information to output stream.
+    /// @brief Get the last user input to be executed.
     ///
-    /// @param out output stream to print to
-    /// @return true if usage was written successfully
-    virtual bool on_usage(cmd_output_t& out, cmd_baton_t user) const
+    /// @return the last line, empty if nothing was executed yet.
+    std::string_view last_cmd() const
     {
-        (void)user;
-        cmd_output_t::indent_t indent = out.indent(2);
-        std::string path;
-        get_command_path(path);
-        cmd_locale_t::usage(out, path.c_str(), usage_, desc_);
-        if (!sub_.empty()) {
-            cmd_locale_t::subcommands(out);
-            print_sub_commands(out);
-        }
-        return true;
+        return history_.empty() ? std::string_view() : history_.back();
     }
 
-protected:
-    /// @brief Add an alias for this command.
-    ///
-    /// bind a cmt_t instance to a single string token known as an alias.
-    /// during command interpretation if the first token matches any alises then the associated cmd_t instance will be executed.
+    /// @brief Limit the lines and bytes kept in the history.
     ///
-    /// @param name the string name of the alias to add.
-    /// @return true if the alias was associated successfully.
-    bool alias_add(const std::string& name);
-
-    /// @brief Report an error condition to the output stream.
+    /// the oldest lines are dropped to fit.
     ///
-    /// @param out output stream.
-    /// @param fmt input format string.
-    /// @param ... variable args.
-    /// @return false so it can be propagated via return statements easily.
-    bool error(cmd_output_t& out, const char* fmt, ...)
+    /// @param lines maximum number of lines.
+    /// @param bytes maximum number of bytes of line text.
+    void set_history_limit(size_t lines, size_t bytes = 64 * 1024)
     {
-        va_list args;
-        va_start(args, fmt);
-        out.println(fmt, args);
-        va_end(args);
-        return false;
+        history_.set_limit(lines, bytes);
     }
 
-    /// @brief Print a list of command names to an output stream.
+    /// @brief Get the state a command keeps for this session.
     ///
-    /// @param list input command list.
-    /// @param out output stream to write command names to.
-    void print_cmd_list(const cmd_list_t& list, cmd_output_t& out) const
+    /// the state is created the first time it is requested.
+    ///
+    /// @param type_t type derived from state_t.
+    /// @param cmd command that owns the state.
+    /// @return state instance.
+    template <typename type_t>
+    type_t& state(const cmd_t* cmd)
     {
-        cmd_output_t::indent_t indent = out.indent(2);
-        for (const auto& cmd : list) {
-            out.println("%s", cmd->name_);
+        std::unique_ptr<state_t>& slot = state_[cmd];
+        if (!slot) {
+            slot.reset(new type_t);
         }
+        return static_cast<type_t&>(*slot);
     }
 
-    /// @brief Print a list of child commands to the output stream.
-    ///
-    /// @param out output stream to write command names to.
-    void print_sub_commands(cmd_output_t& out) const
+    /// @brief parser that owns the command tree.
+    struct cmd_parser_t& parser_;
+
+protected:
+    /// @brief pool for long lived state, ahead of the state that uses it.
+    std::pmr::unsynchronized_pool_resource pool_;
+
+    /// @brief storage for the tokens of the commands being executed.
+    std::pmr::monotonic_buffer_resource arena_;
+
+public:
+    /// @brief user input history.
+    cmd_history_list_t history_;
+
+    /// @brief expression identifier list.
+    cmd_idents_t idents_;
+
+    /// @brief background jobs started by this session.
+    cmd_job_list_t& jobs()
     {
-        print_cmd_list(sub_, out);
+        return jobs_;
     }
+
+protected:
+    /// @brief Execute a single command expression.
+    bool execute_imp(
+        const std::string_view& expr,
+        cmd_tokens_t& tokens,
+        cmd_output_t* output,
+        cmd_baton_t user);
+
+    /// @brief Start a command expression as a background job.
+    bool execute_background(
+        const std::string_view& expr,
+        cmd_output_t& out,
+        cmd_baton_t user);
+
+    /// @brief Execute a group of '&&' delimited command expressions.
+    bool execute_group(
+        const std::string_view& expr,
+        cmd_output_t& out,
+        cmd_baton_t user);
+
+    /// @brief Tokenize and dispatch a command expression.
+    ///
+    /// an empty expression repeats the last line and a '!' history event
+    /// recalls an earlier one.  the expression is added to the history and
+    /// any failure to find a command is reported to the output.
+    ///
+    /// @param lap receives the tokenize and dispatch times.
+    /// @return the matched command otherwise nullptr.
+    cmd_t* resolve(
+        const std::string_view& expr,
+        cmd_tokens_t& tokens,
+        cmd_output_t& out,
+        uint64_t (&lap)[cmd_metrics_t::e_phases]);
+
+    /// @brief Invoke a resolved command and record its statistics.
+    bool invoke(
+        cmd_t* cmd,
+        cmd_tokens_t& tokens,
+        cmd_output_t& out,
+        cmd_baton_t user,
+        uint64_t (&lap)[cmd_metrics_t::e_phases]);
+
+    /// @brief prepared commands are invoked like any other.
+    friend struct cmd_prepared_t;
+
+    /// @brief number of execute() calls in progress, the arena is released
+    /// when the outermost returns.
+    size_t depth_;
+
+    /// @brief state kept by each command.
+    std::map<const cmd_t*, std::unique_ptr<state_t>> state_;
+
+    /// @brief background jobs, last so they stop before the session is torn down.
+    cmd_job_list_t jobs_;
 };
 
 /// @brief cmd_parser_t, the command parser.
@@ -717,6 +3099,9 @@ protected:
 /// it stores some state that can be accessed via all commands (alias_, idents_)
 /// cmd_parser_t is responsible for parsing and dispatching user input to the appropriate command
 ///
+/// the parser has a default session that execute() runs in, further
+/// cmd_session_t instances can share the command tree of one parser.
+///
 struct cmd_parser_t {
 
     /// @brief global user data passed to new subcommands unless overridden.
@@ -731,34 +3116,90 @@ struct cmd_parser_t {
     /// @brief root subcommand list.
     cmd_list_t sub_;
 
-    /// @brief user input history.
-    std::vector<std::string> history_;
+    /// @brief prefix index over the root commands.
+    cmd_index_t index_;
+
+    /// @brief memory resources given to each session.
+    const cmd_memory_t memory_;
+
+    /// @brief session used by execute().
+    cmd_session_t session_;
+
+    /// @brief user input history of the default session.
+    cmd_history_list_t& history_;
 
     /// @brief map of alias names to command instances.
-    std::map<std::string, cmd_t*> alias_;
+    cmd_alias_map_t alias_;
 
-    /// @brief expression identifier list.
-    cmd_idents_t idents_;
+    /// @brief flattened command tree, set while the parser is frozen.
+    std::unique_ptr<cmd_frozen_t> frozen_;
+
+    /// @brief incremented whenever the command tree or aliases change.
+    std::atomic<uint64_t> generation_;
+
+    /// @brief fuzzy index for suggestions, built on demand.
+    std::shared_ptr<const cmd_fuzzy_t> fuzzy_;
+
+    /// @brief parser generation that fuzzy_ was built for.
+    uint64_t fuzzy_generation_;
+
+    /// @brief guards rebuilding fuzzy_.
+    std::mutex fuzzy_mux_;
+
+    /// @brief expression identifier list of the default session.
+    cmd_idents_t& idents_;
+
+    /// @brief guards alias_ and frozen_ while sessions execute.
+    ///
+    /// dispatch holds a shared lock while alias changes take it exclusively.
+    mutable std::shared_mutex mux_;
+
+    /// @brief worker pool for '&&' groups, created on demand.
+    std::unique_ptr<cmd_pool_t> pool_;
+
+    /// @brief worker pool for background jobs, created on demand.
+    std::unique_ptr<cmd_pool_t> job_pool_;
+
+    /// @brief guards creating pool_ and job_pool_.
+    std::mutex pool_mux_;
+
+#if CMD_STATS
+    /// @brief statistics for input that did not match any command.
+    cmd_metrics_t unmatched_;
+#endif
 
     /// @brief cmd_parser_t constructor.
     ///
     /// @param user opaque user data pointer passed from parent to child.
+    /// @param memory memory resources for the sessions of this parser.
     /// @return user a global custom data pointer to be passed to any sub commands.
-    cmd_parser_t(cmd_baton_t user = nullptr)
+    cmd_parser_t(cmd_baton_t user = nullptr, const cmd_memory_t& memory = cmd_memory_t())
         : user_(user)
         , parent_(nullptr)
+        , memory_(memory)
+        , session_(*this)
+        , history_(session_.history_)
+        , generation_(0)
+        , fuzzy_generation_(0)
+        , idents_(session_.idents_)
     {
     }
 
-    /// @brief Get a string with the last user input to be executed.
+    /// @brief Get the last user input to be executed.
     ///
-    /// @return reference to the last
-    const std::string& last_cmd()
+    /// @return the last line, empty if nothing was executed yet.
+    std::string_view last_cmd() const
     {
-        if (history_.empty()) {
-            history_.push_back("hello");
-        }
-        return history_.back();
+        return session_.last_cmd();
+    }
+
+    /// @brief Lock the aliases and frozen tree for reading.
+    ///
+    /// commands that walk alias_ or frozen() should hold this while doing so
+    /// as other sessions may change aliases concurrently.
+    std::shared_lock<std::shared_mutex> read_lock() const
+    {
+        return std::shared_lock<std::shared_mutex>(mux_);
     }
 
     /// @brief Add a new root command to the command parser.
@@ -784,7 +3225,10 @@ struct cmd_parser_t {
         cmd_t* parent = nullptr;
         std::unique_ptr<type_t> temp(new type_t(*this, parent, user));
         sub_.push_back(std::move(temp));
-        return (type_t*)sub_.rbegin()->get();
+        cmd_t* cmd = sub_.rbegin()->get();
+        index_.insert(cmd, cmd->name_);
+        invalidate();
+        return (type_t*)cmd;
     }
 
     /// @brief Add a new root command to the command parser.
@@ -801,11 +3245,116 @@ struct cmd_parser_t {
         std::unique_ptr<cmd_t> temp(std::move(command));
         sub_.push_back(std::move(temp));
         command = nullptr;
-        return sub_.rbegin()->get();
+        cmd_t* cmd = sub_.rbegin()->get();
+        index_.insert(cmd, cmd->name_);
+        invalidate();
+        return cmd;
+    }
+
+    /// @brief Freeze the command tree for faster dispatch.
+    ///
+    /// compact the command tree into the flattened cmd_frozen_t tables which
+    /// are then used for dispatch, alias resolution and tree walks.  adding
+    /// a command after freezing will thaw the parser again.
+    void freeze();
+
+    /// @brief Discard the frozen command tree.
+    void thaw()
+    {
+        std::unique_lock<std::shared_mutex> lock(mux_);
+        frozen_.reset();
+    }
+
+    /// @brief Notify the parser that the command tree has changed.
+    ///
+    /// thaws the parser and marks any prepared commands as stale.
+    void invalidate()
+    {
+        thaw();
+        ++generation_;
+    }
+
+    /// @brief Collect every command that has recorded statistics.
+    ///
+    /// @param out list to receive commands in depth first order.
+    /// @return number of commands found, always zero if CMD_STATS is 0.
+    size_t stats_collect(std::vector<const cmd_t*>& out) const;
+
+    /// @brief Reset the statistics of every command.
+    void stats_clear();
+
+    /// @brief Get the fuzzy index of all command paths and aliases.
+    ///
+    /// the index is rebuilt on demand if the command tree or aliases have
+    /// changed since it was last used.  the reference is only valid until
+    /// the next change, use fuzzy_shared() while sessions are executing.
+    ///
+    /// @return fuzzy index for the current command tree.
+    const cmd_fuzzy_t& fuzzy()
+    {
+        return *fuzzy_shared();
+    }
+
+    /// @brief Get a reference counted fuzzy index.
+    ///
+    /// the index stays valid even if the aliases change while in use.
+    ///
+    /// @return fuzzy index for the current command tree.
+    std::shared_ptr<const cmd_fuzzy_t> fuzzy_shared();
+
+    /// @brief Get the worker pool used to run '&&' groups.
+    ///
+    /// the pool is created the first time it is needed with one thread per
+    /// hardware thread.
+    ///
+    /// @return worker pool.
+    cmd_pool_t& pool();
+
+    /// @brief Replace the worker pool with one of a given size.
+    ///
+    /// must not be called while sessions are executing.
+    ///
+    /// @param threads number of worker threads.
+    void set_workers(uint32_t threads)
+    {
+        std::lock_guard<std::mutex> guard(pool_mux_);
+        pool_.reset(new cmd_pool_t(threads));
+    }
+
+    /// @brief Get the worker pool used to run background jobs.
+    ///
+    /// the pool is created the first time it is needed with one thread per
+    /// hardware thread.  it is kept apart from pool() so long running jobs
+    /// do not hold up '&&' groups, and jobs started while every worker is
+    /// busy wait their turn, so however many jobs the sessions of a parser
+    /// start the number of threads stays bounded.
+    ///
+    /// @return worker pool.
+    cmd_pool_t& job_pool();
+
+    /// @brief Replace the background job pool with one of a given size.
+    ///
+    /// must not be called while any session has jobs.
+    ///
+    /// @param threads number of worker threads.
+    void set_job_workers(uint32_t threads)
+    {
+        std::lock_guard<std::mutex> guard(pool_mux_);
+        job_pool_.reset(new cmd_pool_t(threads));
+    }
+
+    /// @brief Check if the command tree is frozen.
+    ///
+    /// @return flattened command tree if frozen otherwise nullptr.
+    const cmd_frozen_t* frozen() const
+    {
+        return frozen_.get();
     }
 
     /// @brief Execute expressions, calling the relevant cmd_t instances with arguments.
     ///
+    /// expressions are executed in the default session.
+    ///
     /// @param a list of ';' delimited expression strings to execute.
     /// @param output output stream that can be written to during execution.
     /// @param additional user data to pass to command.
@@ -813,7 +3362,21 @@ struct cmd_parser_t {
     bool execute(
         const std::string& expr,
         cmd_output_t* output,
-        cmd_baton_t user);
+        cmd_baton_t user)
+    {
+        return session_.execute(expr, output, user);
+    }
+
+    /// @brief Prepare a command for repeated execution.
+    ///
+    /// the command path is resolved and the fixed arguments are tokenized
+    /// once.  any argument given as a lone '?' token becomes a positional
+    /// placeholder that is bound before each execution.  identifier
+    /// substitutions are still applied at execution time.
+    ///
+    /// @param expr a single command expression, without ';' delimiters.
+    /// @return prepared command otherwise nullptr if the command could not be resolved.
+    std::unique_ptr<struct cmd_prepared_t> prepare(const std::string& expr);
 
     /// @brief Add a new parser alias for a cmd_t instance.
     ///
@@ -836,22 +3399,160 @@ struct cmd_parser_t {
 
     /// @brief Find a cmd_t instance given its alias name.
     ///
+    /// the caller should hold read_lock() if other sessions are executing.
+    ///
     /// @param alias the string alias to search for an associated cmd_t instance.
     /// @return cmd_t instance linked to this alias otherwise nullptr.
-    cmd_t* alias_find(const std::string& alias) const
+    cmd_t* alias_find(const std::string_view& alias) const
     {
         auto itt = alias_.find(alias);
         return itt == alias_.end() ? nullptr : itt->second;
     }
 
 protected:
-    /// @brief Execute a command expression, calling the relevant cmd_t instance with arguments.
+    friend struct cmd_prepared_t;
+    friend struct cmd_session_t;
+
+    /// @brief Find the command addressed by a token list.
+    ///
+    /// tokens naming the command path are popped from the token list.
+    ///
+    /// @param tokens token list to dispatch.
+    /// @param out output stream for reporting ambiguous matches.
+    /// @param ambiguous set if dispatch stopped at an ambiguous match.
+    /// @return the matched command otherwise nullptr.
+    cmd_t* dispatch(cmd_tokens_t& tokens, cmd_output_t& out, bool& ambiguous);
+
+    /// @brief Find the command addressed by a token list using the frozen tree.
+    cmd_t* dispatch_frozen(cmd_tokens_t& tokens, cmd_output_t& out, bool& ambiguous);
+
+    /// @brief Suggest commands close to an invalid command.
+    ///
+    /// @param tokens token list that failed to dispatch.
+    /// @param out output stream for suggestions.
+    void suggest(const cmd_tokens_t& tokens, cmd_output_t& out);
+};
+
+/// @brief cmd_prepared_t, a command resolved once and executed many times.
+///
+/// similar to a prepared sql statement, the target cmd_t instance is found
+/// and the fixed arguments tokenized when the command is prepared.  the
+/// values for any '?' placeholders are bound and the command executed with
+/// no further dispatch.  if the command tree or aliases change the command
+/// is transparently resolved again on its next execution.
+///
+struct cmd_prepared_t {
+
+    /// @brief constructor.
+    ///
+    /// @param parser the parser the command will be executed by.
+    /// @param expr the command expression to prepare.
+    cmd_prepared_t(cmd_parser_t& parser, const std::string& expr);
+
+    /// @brief check if this command is resolved and up to date.
+    ///
+    /// @return true if the command can execute without being resolved again.
+    bool valid() const
+    {
+        return cmd_ && generation_ == parser_.generation_;
+    }
+
+    /// @brief the command this statement will execute.
+    ///
+    /// @return resolved command instance otherwise nullptr.
+    cmd_t* command() const
+    {
+        return cmd_;
+    }
+
+    /// @brief number of positional placeholders.
+    size_t size() const
+    {
+        return holes_.size();
+    }
+
+    /// @brief bind an integer to a placeholder.
+    ///
+    /// @param index placeholder index, starting at zero.
+    /// @param value value to bind.
+    /// @return true if the placeholder exists.
+    bool bind(size_t index, uint64_t value);
+
+    /// @brief bind a string to a placeholder.
+    ///
+    /// @param index placeholder index, starting at zero.
+    /// @param value single token value to bind.
+    /// @return true if the placeholder exists.
+    bool bind(size_t index, const std::string_view& value);
+
+    /// @brief execute this command with the currently bound values.
+    ///
+    /// the command runs in a session of the parser, whose identifiers are
+    /// substituted and where its statistics are recorded.  a trailing '?'
+    /// argument prints the command usage, as for execute().  a statement
+    /// may run in different sessions but only in one at a time.
     ///
-    /// @param expression string to execute.
+    /// @param session session to execute in.
     /// @param output output stream that can be written to during execution.
+    /// @param user additional user data to pass to the command.
     /// @return true if the command executed successfully.
-    bool execute_imp(
-        const std::string& expr,
-        cmd_output_t* output,
-        cmd_baton_t user);
+    bool execute(cmd_session_t& session, cmd_output_t* output, cmd_baton_t user);
+
+    /// @brief execute this command in the default session of the parser.
+    ///
+    /// @param output output stream that can be written to during execution.
+    /// @param user additional user data to pass to the command.
+    /// @return true if the command executed successfully.
+    bool execute(cmd_output_t* output, cmd_baton_t user);
+
+protected:
+    /// @brief resolve the command and its fixed arguments.
+    ///
+    /// @return true if a command was found.
+    bool resolve();
+
+    /// @brief forget the identifier slots, to be looked up in a table.
+    void reset_slots(const cmd_idents_t& idents);
+
+    cmd_parser_t& parser_;
+
+    /// @brief the expression that was prepared.
+    std::string expr_;
+
+    /// @brief parser generation when this command was resolved.
+    uint64_t generation_;
+
+    /// @brief resolved command.
+    cmd_t* cmd_;
+
+    /// @brief fixed arguments following the command path.
+    std::vector<std::string> args_;
+
+    /// @brief identifier slot for each '$ident' argument, npos until the
+    /// name has a slot or for other arguments.
+    std::vector<uint32_t> slots_;
+
+    /// @brief identifier table the slots were found in.
+    const cmd_idents_t* idents_;
+
+    /// @brief identifier epoch the slots were found in.
+    uint64_t epoch_;
+
+    /// @brief formatted identifier values reused between executions.
+    std::vector<std::string> subst_;
+
+    /// @brief argument index of each placeholder.
+    std::vector<size_t> holes_;
+
+    /// @brief bound placeholder values.
+    std::vector<std::string> bound_;
+
+    /// @brief set for each placeholder that has been bound.
+    std::vector<bool> is_bound_;
+
+    /// @brief argument views reused between executions.
+    std::vector<std::string_view> views_;
+
+    /// @brief token list reused between executions.
+    cmd_tokens_t tokens_;
 };
@@ -11,27 +11,21 @@ struct cmd_alias_t : public cmd_t {
             desc_ = "alias a command with a single name";
         }
 
-        static cmd_t* cmd_find(const cmd_tokens_t& tok, const cmd_list_t* list)
+        static cmd_t* cmd_find(const cmd_tokens_t& tok, const cmd_index_t* index)
         {
             cmd_t* cmd = nullptr;
             for (const cmd_token_t& token : tok.tokens.raw_) {
-                cmd = nullptr;
-                if (list == nullptr) {
+                if (index == nullptr) {
                     return nullptr;
                 }
-                for (const auto& list_cmd : *list) {
-                    if (token.get() == list_cmd->name_) {
-                        cmd = list_cmd.get();
-                        break;
-                    }
-                }
+                cmd = index->find_exact(token.get());
                 if (cmd == nullptr) {
                     break;
                 }
                 if (!cmd->sub_.empty()) {
-                    list = &(cmd->sub_);
+                    index = &(cmd->index_);
                 } else {
-                    list = nullptr;
+                    index = nullptr;
                 }
             }
             return cmd;
@@ -44,7 +38,7 @@ struct cmd_alias_t : public cmd_t {
                 cmd_token_t name = tok.tokens.front();
                 tok.tokens.pop();
                 // lookup a command for the remaining tokens
-                cmd_t* cmd = cmd_find(tok, &(parser_.sub_));
+                cmd_t* cmd = cmd_find(tok, &(parser_.index_));
                 if (cmd == nullptr) {
                     auto ident = out.indent(2);
                     return cmd_locale_t::unable_to_find_cmd(out, name.c_str()), false;
@@ -84,14 +78,23 @@ struct cmd_alias_t : public cmd_t {
         virtual bool on_execute(cmd_tokens_t& tok, cmd_output_t& out, cmd_baton_t user) override
         {
             auto indent = out.indent(2);
+            const auto lock = parser_.read_lock();
+            std::string path;
+            if (out.structured()) {
+                for (const auto& itt : parser_.alias_) {
+                    path.clear();
+                    itt.second->get_command_path(path);
+                    cmd_record_t(out, "alias").field("name", itt.first).field("command", path);
+                }
+                return true;
+            }
             cmd_locale_t::num_aliases(out, parser_.alias_.size());
             indent.add(2);
-            std::string path;
             for (auto itt : parser_.alias_) {
                 const cmd_t* cmd = itt.second;
                 path.clear();
                 cmd->get_command_path(path);
-                out.println("%8s - %s", itt.first.c_str(), path.c_str());
+                out.line(cmd_format_t::pad(itt.first, 8), " - ", path);
             }
             return true;
         }
@@ -0,0 +1,97 @@
+#pragma once
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+/// @brief cmd_alloc_t, count heap allocations made by the calling thread.
+///
+/// used by tests and benchmarks to check that a warmed up execute() does
+/// not allocate.  the count only moves in a program where exactly one
+/// translation unit defines CMD_ALLOC_COUNT before including this header,
+/// which replaces the global operator new with one that counts.
+///
+/// @code
+///     cmd_alloc_t::scope_t scope;
+///     parser.execute("echo 1", out, nullptr);
+///     assert(scope.allocs() == 0);
+/// @endcode
+///
+struct cmd_alloc_t {
+
+    /// @brief number of allocations made by this thread so far.
+    static uint64_t& count()
+    {
+        thread_local uint64_t count = 0;
+        return count;
+    }
+
+    /// @brief counts the allocations made by this thread while in scope.
+    struct scope_t {
+
+        scope_t()
+            : start_(count())
+        {
+        }
+
+        /// @brief allocations made since construction.
+        uint64_t allocs() const
+        {
+            return count() - start_;
+        }
+
+    protected:
+        uint64_t start_;
+    };
+};
+
+#if defined(CMD_ALLOC_COUNT)
+// array and nothrow forms of new and delete forward to these by default
+void* operator new(size_t size)
+{
+    ++cmd_alloc_t::count();
+    if (void* ptr = malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+// std::pmr::new_delete_resource allocates through the aligned forms
+void* operator new(size_t size, std::align_val_t align)
+{
+    ++cmd_alloc_t::count();
+    const size_t alignment = size_t(align);
+    size = (size + alignment - 1) & ~(alignment - 1);
+#if defined(_MSC_VER)
+    if (void* ptr = _aligned_malloc(size ? size : alignment, alignment)) {
+#else
+    if (void* ptr = aligned_alloc(alignment, size ? size : alignment)) {
+#endif
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept
+{
+#if defined(_MSC_VER)
+    _aligned_free(ptr);
+#else
+    free(ptr);
+#endif
+}
+
+void operator delete(void* ptr, size_t, std::align_val_t align) noexcept
+{
+    operator delete(ptr, align);
+}
+#endif // defined(CMD_ALLOC_COUNT)
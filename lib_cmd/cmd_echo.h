@@ -8,22 +8,49 @@ struct cmd_echo_t : public cmd_t {
     {
         usage_ = "arg [arg] [...]";
         desc_ = "echo cmd_t args for debugging";
+        parallel_ = true;
+    }
+
+    void record(cmd_tokens_t& tok, cmd_output_t& out)
+    {
+        cmd_record_t rec(out, "echo");
+        rec.list("tokens");
+        for (const cmd_token_t& token : tok.tokens.tokens_) {
+            rec.item(token.get());
+        }
+        rec.list_end().list("flags");
+        for (const std::string_view& flag : tok.flags.flags_) {
+            rec.item(flag);
+        }
+        // pairs are written as alternating keys and values
+        rec.list_end().list("pairs");
+        for (const auto& pair : tok.pairs.pairs_) {
+            rec.item(pair.first).item(pair.second.get());
+        }
+        rec.list_end().list("raw");
+        for (const cmd_token_t& token : tok.tokens.raw_) {
+            rec.item(token.get());
+        }
+        rec.list_end();
     }
 
     virtual bool on_execute(cmd_tokens_t& tok, cmd_output_t& out, cmd_baton_t user) override
     {
+        if (out.structured()) {
+            return record(tok, out), true;
+        }
         auto indent = out.indent(2);
         if (!tok.tokens.empty()) {
             std::string tokens;
             for (const cmd_token_t& token : tok.tokens.tokens_) {
-                tokens.append(token);
+                tokens.append(token.get());
                 tokens.append(1, ' ');
             }
             out.println("tokens: %s", tokens.c_str());
         }
         if (!tok.flags.empty()) {
             std::string flags;
-            for (const cmd_token_t& flag : tok.flags.flags_) {
+            for (const std::string_view& flag : tok.flags.flags_) {
                 flags.append(flag);
                 flags.append(1, ' ');
             }
@@ -31,9 +58,9 @@ struct cmd_echo_t : public cmd_t {
         }
         if (!tok.pairs.empty()) {
             out.print(" pairs: ");
-            std::string pair;
             for (const auto& pair : tok.pairs.pairs_) {
-                out.print<false>("%s:%s ", pair.first.c_str(), pair.second.c_str());
+                // keys are views into the token line buffer and are null terminated
+                out.print<false>("%s:%s ", pair.first.data(), pair.second.c_str());
             }
             out.eol();
         }
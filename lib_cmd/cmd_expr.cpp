@@ -1,5 +1,8 @@
 #include <assert.h>
+#include <cstring>
+#include <list>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include <array>
 
@@ -232,6 +235,41 @@ struct cmd_exp_lexer_t {
         return true;
     }
 
+    // append the items an input lexes to, each separated by a space, so
+    // expressions that lex the same produce the same text
+    void normalize(const std::string_view& input, std::string& out)
+    {
+        const size_t npos = std::string_view::npos;
+        // start of the item being read
+        size_t start = npos;
+        for (size_t i = 0; i <= input.size(); ++i) {
+            const char ch = i < input.size() ? input[i] : ' ';
+            if (start != npos) {
+                if (is_value(ch)) {
+                    continue;
+                }
+                append_item(input.substr(start, i - start), out);
+                start = npos;
+            }
+            if (is_whitespace(ch)) {
+                continue;
+            }
+            if (is_operator(ch)) {
+                append_item(input.substr(i, 1), out);
+                continue;
+            }
+            start = i;
+        }
+    }
+
+    void append_item(const std::string_view& item, std::string& out)
+    {
+        if (!out.empty()) {
+            out.push_back(' ');
+        }
+        out.append(item);
+    }
+
     // produce parsed token queue from an input string
     bool tokenize(const std::string& input, std::deque<exp_token_t>& out)
     {
@@ -283,35 +321,86 @@ struct cmd_exp_lexer_t {
 
 } // namespace {}
 
-// command expression evaluation implementation
-struct cmd_expr_imp_t {
-    std::vector<exp_token_t> stack_;
+namespace {
+// a single bytecode instruction
+struct exp_op_t {
+    enum code_t : uint8_t {
+        e_push_value, // push a literal value
+        e_push_ident, // push an identifier, value_ indexes its name
+        e_push_other, // push a non value token (operator or eof)
+        e_apply, // apply an operator to the top two stack entries
+        e_fail, // report the compile error and stop
+    };
+    code_t code_;
+    char op_;
+    uint32_t slot_;
+    uint64_t value_;
+};
+} // namespace {}
+
+// expression compiled into postfix bytecode
+//
+// identifier opcodes refer to slots in the cmd_idents_t the program was
+// compiled against, so a program must only run against that table.  names
+// that have no slot yet are looked up as the program runs, they are only
+// given a slot once assigned so reading unknown names does not grow the
+// table.
+struct cmd_expr_program_t {
+    std::vector<exp_op_t> code_;
+    // name of each identifier opcode
+    std::vector<std::string> names_;
+    // first error raised while parsing, used by e_fail
+    std::string error_;
+    // the lexer rejected the input
+    bool lex_fail_;
+
+    cmd_expr_program_t()
+        : lex_fail_(false)
+    {
+    }
+};
+
+// compile an expression into a cmd_expr_program_t
+//
+// the parser is a faithful copy of the evaluating recursive descent parser
+// except that values are pushed and operators applied by emitting opcodes.
+// parse decisions never depend on values so running the program produces
+// the same results and the same first error as evaluating directly.
+struct cmd_expr_compiler_t {
     std::deque<exp_token_t> input_;
-    std::map<std::string, uint64_t>& idents_;
     cmd_exp_error_t error_;
+    cmd_expr_program_t& prog_;
+    const cmd_idents_t& idents_;
 
-    cmd_expr_imp_t(std::map<std::string, uint64_t>& i)
-        : idents_(i)
+    cmd_expr_compiler_t(cmd_expr_program_t& prog, const cmd_idents_t& idents)
+        : prog_(prog)
+        , idents_(idents)
     {
     }
 
-    /* evaluate a given expression */
-    bool evaluate(const std::string& exp)
+    /* compile a given expression */
+    bool compile(const std::string& exp)
     {
         cmd_exp_lexer_t lexer;
         if (!lexer.tokenize(exp, input_)) {
+            prog_.lex_fail_ = true;
             return false;
         }
         if (!expr(0)) {
+            assert(!error_.error_.empty());
+            prog_.error_ = error_.error_.front();
+            emit(exp_op_t::e_fail);
             return false;
         }
-        if (stack_.size() != 1) {
-            return error_.error_non_single_result();
-        }
         return true;
     }
 
 protected:
+    void emit(exp_op_t::code_t code, char op = 0, uint32_t slot = 0, uint64_t value = 0)
+    {
+        prog_.code_.push_back(exp_op_t{ code, op, slot, value });
+    }
+
     bool input_found_op(const char op)
     {
         assert(!input_.empty());
@@ -367,31 +456,19 @@ protected:
             if (!input_next(temp)) {
                 return error_.error_cant_shift_input();
             }
-            stack_.push_back(temp);
-        }
-        return true;
-    }
-
-    /* pop a value from the working stack */
-    bool stack_pop(exp_token_t& out)
-    {
-        if (!stack_.empty()) {
-            out = *stack_.rbegin();
-            stack_.pop_back();
-            return true;
-        } else {
-            return false;
+            switch (temp.type_) {
+            case exp_token_t::e_value:
+                emit(exp_op_t::e_push_value, 0, 0, temp.value_);
+                break;
+            case exp_token_t::e_identifier:
+                emit(exp_op_t::e_push_ident, 0, idents_.slot(temp.ident_), prog_.names_.size());
+                prog_.names_.push_back(temp.ident_);
+                break;
+            default:
+                emit(exp_op_t::e_push_other);
+                break;
+            }
         }
-    }
-
-    /* push a value onto the working stack (int -> string) */
-    bool stack_push(const uint64_t val)
-    {
-        // convert number to hex
-        exp_token_t temp;
-        temp.type_ = temp.e_value;
-        temp.value_ = val;
-        stack_.push_back(temp);
         return true;
     }
 
@@ -420,50 +497,232 @@ protected:
         }
     }
 
+    /* consume input until a minium precedence is reached */
+    bool expr(uint32_t min_prec)
+    {
+        // consume a literal or identifier
+        if (!parse_ident()) {
+            return error_.error_expect_lit_or_ident();
+        }
+        // check for end of input
+        if (input_eof()) {
+            return true;
+        }
+        exp_token_t op;
+        while (true) {
+            // halting condition
+            {
+                const exp_token_t& temp = input_peek();
+                if (temp.type_ != temp.e_operator) {
+                    return error_.error_expect_op();
+                }
+                if (op_prec(temp) <= min_prec) {
+                    break;
+                }
+            }
+            // get the next operator
+            if (!input_next(op)) {
+                return error_.error_expect_op();
+            }
+            if (op.type_ != op.e_operator) {
+                return error_.error_expect_op();
+            }
+            if (!expr(op_prec(op))) {
+                return false;
+            }
+            // apply this operator
+            emit(exp_op_t::e_apply, char(op.op_));
+            // if we have exhausted the input stop looping
+            if (input_eof()) {
+                break;
+            }
+        }
+        return true;
+    }
+}; // struct cmd_expr_compiler_t
+
+// least recently used cache of compiled expressions, one per session as the
+// programs refer to identifier slots of that session
+struct cmd_expr_cache_t : public cmd_session_t::state_t {
+    typedef std::pair<std::string, cmd_expr_program_t> entry_t;
+
+    static const size_t capacity = 256;
+
+    cmd_expr_cache_t()
+        : epoch_(0)
+    {
+    }
+
+    // most recently used at the front
+    std::list<entry_t> lru_;
+    // keys are views of the strings held in lru_
+    std::unordered_map<std::string_view, std::list<entry_t>::iterator> map_;
+    // reusable key buffer
+    std::string key_;
+    // identifier epoch the programs were compiled in
+    uint64_t epoch_;
+
+    /* find or compile the program for a normalized expression */
+    cmd_expr_program_t& get(const std::string& exp, const cmd_idents_t& idents)
+    {
+        if (epoch_ != idents.epoch()) {
+            // the slots the programs hold are no longer valid
+            map_.clear();
+            lru_.clear();
+            epoch_ = idents.epoch();
+        }
+        auto itt = map_.find(exp);
+        if (itt != map_.end()) {
+            lru_.splice(lru_.begin(), lru_, itt->second);
+            return itt->second->second;
+        }
+        if (lru_.size() >= capacity) {
+            map_.erase(lru_.back().first);
+            lru_.pop_back();
+        }
+        lru_.emplace_front(exp, cmd_expr_program_t());
+        entry_t& entry = lru_.front();
+        cmd_expr_compiler_t compiler(entry.second, idents);
+        compiler.compile(entry.first);
+        map_.emplace(entry.first, lru_.begin());
+        return entry.second;
+    }
+};
+
+// command expression evaluation implementation
+struct cmd_expr_imp_t {
+
+    // working stack entry
+    struct value_t {
+        enum type_t {
+            e_value,
+            e_identifier,
+            e_other
+        };
+        type_t type_;
+        uint32_t slot_;
+        uint64_t value_;
+        // index of an identifier name in the program
+        uint32_t name_;
+    };
+
+    std::vector<value_t> stack_;
+    cmd_idents_t& idents_;
+    cmd_exp_error_t error_;
+    const cmd_expr_program_t* prog_;
+
+    cmd_expr_imp_t(cmd_idents_t& i)
+        : idents_(i)
+        , prog_(nullptr)
+    {
+    }
+
+    /* evaluate a compiled expression */
+    bool evaluate(cmd_expr_program_t& prog)
+    {
+        prog_ = &prog;
+        if (prog.lex_fail_) {
+            return false;
+        }
+        for (exp_op_t& op : prog.code_) {
+            switch (op.code_) {
+            case exp_op_t::e_push_value:
+                stack_.push_back(value_t{ value_t::e_value, 0, op.value_, 0 });
+                break;
+            case exp_op_t::e_push_ident:
+                if (op.slot_ == cmd_idents_t::npos) {
+                    // kept once the name has been given a slot
+                    op.slot_ = idents_.slot(prog.names_[op.value_]);
+                }
+                stack_.push_back(value_t{ value_t::e_identifier, op.slot_, 0, uint32_t(op.value_) });
+                break;
+            case exp_op_t::e_push_other:
+                stack_.push_back(value_t{ value_t::e_other, 0, 0, 0 });
+                break;
+            case exp_op_t::e_apply:
+                if (!op_apply(op.op_)) {
+                    return error_.error_applying_op(op.op_);
+                }
+                break;
+            case exp_op_t::e_fail:
+                return error_.error("%s", prog.error_.c_str());
+            }
+        }
+        if (stack_.size() != 1) {
+            return error_.error_non_single_result();
+        }
+        return true;
+    }
+
+    /* name of an identifier, null terminated */
+    std::string_view ident(const value_t& val) const
+    {
+        assert(val.type_ == value_t::e_identifier);
+        return prog_->names_[val.name_];
+    }
+
+protected:
+    /* pop a value from the working stack */
+    bool stack_pop(value_t& out)
+    {
+        if (!stack_.empty()) {
+            out = *stack_.rbegin();
+            stack_.pop_back();
+            return true;
+        } else {
+            return false;
+        }
+    }
+
+    /* push a value onto the working stack */
+    bool stack_push(const uint64_t val)
+    {
+        stack_.push_back(value_t{ value_t::e_value, 0, val, 0 });
+        return true;
+    }
+
     /* lookup idenfier value */
-    bool dereference(const exp_token_t& in, exp_token_t& out) const
+    bool dereference(value_t& val) const
     {
-        // note: in and out may reference the same object
-        if (in.type_ == in.e_value) {
-            out.type_ = out.e_value;
-            out.value_ = in.value_;
+        if (val.type_ == value_t::e_value) {
             return true;
         }
-        if (in.type_ == in.e_identifier) {
-            auto itt = idents_.find(in.ident_);
-            if (itt == idents_.end()) {
+        if (val.type_ == value_t::e_identifier) {
+            if (!idents_.get(val.slot_, val.value_)) {
                 return false;
             }
-            out.type_ = out.e_value;
-            out.value_ = itt->second;
+            val.type_ = value_t::e_value;
             return true;
         }
         return false;
     }
 
-    bool op_apply_assign(const exp_token_t& lhs, exp_token_t rhs)
+    bool op_apply_assign(const value_t& lhs, const value_t& rhs)
     {
-        if (lhs.type_ != exp_token_t::e_identifier) {
+        if (lhs.type_ != value_t::e_identifier) {
             return error_.error_cant_assign_literal();
         }
-        assert(rhs.type_ == exp_token_t::e_value);
-        idents_[lhs.ident_] = rhs.value_;
-        stack_.push_back(lhs);
+        assert(rhs.type_ == value_t::e_value);
+        value_t ident = lhs;
+        if (ident.slot_ == cmd_idents_t::npos) {
+            ident.slot_ = idents_.intern(this->ident(lhs));
+        }
+        idents_.set(ident.slot_, rhs.value_);
+        stack_.push_back(ident);
         return true;
     }
 
-    bool op_apply_generic(const exp_token_t& op, exp_token_t& lhs, const exp_token_t& rhs)
+    bool op_apply_generic(const char op, value_t& lhs, const value_t& rhs)
     {
-        assert(op.type_ == exp_token_t::e_operator);
-        if (lhs.type_ == exp_token_t::e_identifier) {
-            if (!dereference(lhs, lhs)) {
-                return error_.error_cant_deref(lhs.ident_.c_str());
+        if (lhs.type_ == value_t::e_identifier) {
+            if (!dereference(lhs)) {
+                return error_.error_cant_deref(ident(lhs).data());
             }
         }
-        if (lhs.type_ != exp_token_t::e_value || rhs.type_ != exp_token_t::e_value) {
+        if (lhs.type_ != value_t::e_value || rhs.type_ != value_t::e_value) {
             return error_.error_malformed_expr();
         }
-        switch (op.op_) {
+        switch (op) {
         case '&':
             return stack_push(lhs.value_ & rhs.value_), true;
         case '|':
@@ -485,15 +744,14 @@ protected:
             }
             return stack_push(lhs.value_ % rhs.value_), true;
         default:
-            return error_.error_unknown_op(op.op_);
+            return error_.error_unknown_op(op);
         }
     }
 
     /* apply an operator to the working value stack */
-    bool op_apply(const exp_token_t& op)
+    bool op_apply(const char op)
     {
-        assert(op.type_ == exp_token_t::e_operator);
-        exp_token_t rhs, lhs;
+        value_t rhs, lhs;
         if (!stack_pop(rhs)) {
             return error_.error_missing_rhs();
         }
@@ -501,103 +759,82 @@ protected:
             return error_.error_missing_lhs();
         }
         // we can dereference the RHS in anticipation
-        if (rhs.type_ == exp_token_t::e_identifier) {
-            if (!dereference(rhs, rhs)) {
-                return error_.error_cant_deref(rhs.ident_.c_str());
+        if (rhs.type_ == value_t::e_identifier) {
+            if (!dereference(rhs)) {
+                return error_.error_cant_deref(ident(rhs).data());
             }
         }
-        if (rhs.type_ != rhs.e_value) {
+        if (rhs.type_ != value_t::e_value) {
             return error_.error_rhs_needs_rvalue();
         }
         // dispatch based on operator type
-        switch (op.op_) {
+        switch (op) {
         case '=':
             return op_apply_assign(lhs, rhs);
         default:
             return op_apply_generic(op, lhs, rhs);
         }
     }
+}; // struct cmd_expr_imp_t
 
-    /* consume input until a minium precedence is reached */
-    bool expr(uint32_t min_prec)
-    {
-        // consume a literal or identifier
-        if (!parse_ident()) {
-            return error_.error_expect_lit_or_ident();
-        }
-        // check for end of input
-        if (input_eof()) {
-            return true;
-        }
-        exp_token_t op;
-        // todo: make this peek robust and check if operator
-        while (true) {
-            // halting condition
-            {
-                const exp_token_t& temp = input_peek();
-                if (temp.type_ != temp.e_operator) {
-                    return error_.error_expect_op();
-                }
-                if (op_prec(temp) <= min_prec) {
-                    break;
-                }
-            }
-            // get the next operator
-            if (!input_next(op)) {
-                return error_.error_expect_op();
-            }
-            if (op.type_ != op.e_operator) {
-                return error_.error_expect_op();
-            }
-            if (!expr(op_prec(op))) {
-                return false;
-            }
-            // apply this operator
-            if (!op_apply(op)) {
-                return error_.error_applying_op(op.op_);
-            }
-            // if we have exhausted the input stop looping
-            if (input_eof()) {
-                break;
-            }
-        }
-        return true;
+bool cmd_expr_t::cmd_expr_eval_t::join_expr(const cmd_tokens_t& tok, std::string& out) const
+{
+    out.clear();
+    cmd_exp_lexer_t lexer;
+    for (const cmd_token_t& token : tok.tokens.raw_) {
+        lexer.normalize(token.view(), out);
     }
-}; // struct cmd_expr_imp_t
+    return true;
+}
+
+cmd_expr_t::cmd_expr_eval_t::cmd_expr_eval_t(cmd_parser_t& cli, cmd_t* parent, cmd_baton_t user)
+    : cmd_t("eval", cli, parent, user)
+{
+    usage_ = "[expression]";
+    desc_ = "evaluate an algabreic expression";
+    alias_add("p");
+}
 
 bool cmd_expr_t::cmd_expr_eval_t::on_execute(cmd_tokens_t& tok, cmd_output_t& out, cmd_baton_t user)
 {
     auto indent = out.indent(2);
-    // turn arguments into expression string
-    std::string expr;
+    // turn arguments into normalized expression text
+    cmd_session_t& session = tok.session();
+    cmd_expr_cache_t& cache = session.state<cmd_expr_cache_t>(this);
+    std::string& expr = cache.key_;
     if (!join_expr(tok, expr)) {
         return cmd_locale_t::malformed_exp(out), false;
     }
+    // fetch or compile the expression
+    cmd_expr_program_t& prog = cache.get(expr, session.idents_);
     // execute the expression
-    cmd_expr_imp_t state(parser_.idents_);
-    if (!state.evaluate(expr)) {
+    cmd_expr_imp_t state(session.idents_);
+    if (!state.evaluate(prog)) {
         return state.error_.print(out), false;
     }
     indent.add(2);
     // print results
-    for (const exp_token_t& val : state.stack_) {
+    for (const cmd_expr_imp_t::value_t& val : state.stack_) {
         switch (val.type_) {
-        case exp_token_t::e_identifier: {
-            auto& idents = state.idents_;
-            auto itt = idents.find(val.ident_);
-            if (itt == idents.end()) {
+        case cmd_expr_imp_t::value_t::e_identifier: {
+            uint64_t value = 0;
+            if (!state.idents_.get(val.slot_, value)) {
                 // unknown identifier
-                cmd_locale_t::unknown_ident(out, val.ident_.c_str());
+                cmd_locale_t::unknown_ident(out, state.ident(val).data());
+            } else if (out.structured()) {
+                cmd_record_t(out, "ident").field("name", state.ident(val)).field("value", value);
             } else {
                 // print key value pair
-                const std::string& key = itt->first;
-                const uint64_t& value = itt->second;
-                out.println("%s = 0x%llx", key.c_str(), value);
+                out.line(state.ident(val), " = ", cmd_format_t::hex(value));
             }
             break;
         }
-        case exp_token_t::e_value:
-            out.println("0x%llx", val.value_);
+        case cmd_expr_imp_t::value_t::e_value:
+            if (out.structured()) {
+                cmd_record_t(out, "value").field("value", val.value_);
+            } else {
+                out.line(cmd_format_t::hex(val.value_));
+            }
             break;
         default:
             return cmd_locale_t::not_val_or_ident(out), false;
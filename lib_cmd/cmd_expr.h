@@ -23,7 +23,7 @@ struct cmd_expr_t : public cmd_t {
         {
             (void)user;
             cmd_output_t::indent_t indent = out.indent(2);
-            cmd_idents_t& idents = parser_.idents_;
+            cmd_idents_t& idents = tok.session().idents_;
             // parse identifier name
             std::string name;
             if (!tok.tokens.get(name)) {
@@ -36,7 +36,7 @@ struct cmd_expr_t : public cmd_t {
                 return out.println("value required"), false;
             }
             // set the identifier
-            return (idents[name] = value), true;
+            return idents.set(name, value), true;
         }
     };
 
@@ -53,7 +53,7 @@ struct cmd_expr_t : public cmd_t {
         {
             (void)user;
             cmd_output_t::indent_t indent = out.indent(2);
-            cmd_idents_t& idents = parser_.idents_;
+            cmd_idents_t& idents = tok.session().idents_;
             // parse identifier name
             std::string name;
             if (!tok.tokens.get(name)) {
@@ -61,10 +61,7 @@ struct cmd_expr_t : public cmd_t {
             }
             assert(!name.empty());
             // erase the identifier
-            auto itt = idents.find(name);
-            if (itt != idents.end()) {
-                idents.erase(itt);
-            } else {
+            if (!idents.erase(name)) {
                 out.println("unable to find identifier '%s'", name.c_str());
             }
             return true;
@@ -73,24 +70,14 @@ struct cmd_expr_t : public cmd_t {
 
     struct cmd_expr_eval_t : public cmd_t {
 
-        cmd_expr_eval_t(cmd_parser_t& cli, cmd_t* parent, cmd_baton_t user)
-            : cmd_t("eval", cli, parent, user)
-        {
-            usage_ = "[expression]";
-            desc_ = "evaluate an algabreic expression";
-            alias_add("p");
-        }
+        cmd_expr_eval_t(cmd_parser_t& cli, cmd_t* parent, cmd_baton_t user);
 
-        bool join_expr(const cmd_tokens_t& tok, std::string& out) const
-        {
-            out.clear();
-            for (const cmd_token_t& token : tok.tokens.raw_) {
-                out.append(token.get());
-                out.append(1, ' ');
-            }
-            return true;
-        }
+        /// @brief join the arguments into the items they lex to, separated
+        /// by single spaces, so "x+1" and "x + 1" give the same text.
+        bool join_expr(const cmd_tokens_t& tok, std::string& out) const;
 
+        /// @brief compiled expressions are cached per session in a
+        /// cmd_expr_cache_t keyed on the normalized expression text.
         virtual bool on_execute(cmd_tokens_t& tok, cmd_output_t& out, cmd_baton_t user) override;
     };
 
@@ -105,11 +92,25 @@ struct cmd_expr_t : public cmd_t {
         virtual bool on_execute(cmd_tokens_t& tok, cmd_output_t& out, cmd_baton_t user) override
         {
             cmd_output_t::indent_t indent = out.indent(2);
-            const cmd_idents_t& idents = parser_.idents_;
-            out.println("%lld variables:", (uint64_t)idents.size());
+            const cmd_idents_t& idents = tok.session().idents_;
+            if (out.structured()) {
+                // stream records without sorting or formatting to text
+                for (uint32_t slot = 0; slot < idents.slots(); ++slot) {
+                    uint64_t value = 0;
+                    if (idents.get(slot, value)) {
+                        cmd_record_t(out, "ident").field("name", idents.name(slot)).field("value", value);
+                    }
+                }
+                return true;
+            }
+            out.line(idents.size(), " variables:");
             indent.add(2);
-            for (const auto& itt : idents) {
-                out.println("%8s 0x%llx", itt.first.c_str(), itt.second);
+            std::vector<uint32_t> slots;
+            idents.sorted(slots);
+            for (const uint32_t slot : slots) {
+                uint64_t value = 0;
+                idents.get(slot, value);
+                out.line(cmd_format_t::pad(idents.name(slot), 8), " ", cmd_format_t::hex(value));
             }
             return true;
         }
@@ -8,14 +8,20 @@ struct cmd_help_t : public cmd_t {
             : cmd_t("tree", cli, parent, user)
         {
             desc_ = "list all commands and their sub commands";
-            parser_.history_.push_back("help");
+            parser_.history_.push("help");
         }
 
         void walk(const cmd_list_t& list, cmd_output_t& out)
         {
             auto indent = out.indent(2);
             for (const auto& cmd : list) {
-                out.println(cmd->name_);
+                if (out.structured()) {
+                    std::string path;
+                    cmd->get_command_path(path);
+                    cmd_record_t(out, "command").field("path", path);
+                } else {
+                    out.println(cmd->name_);
+                }
                 assert(cmd);
                 if (!cmd->sub_.empty()) {
                     walk(cmd->sub_, out);
@@ -23,10 +29,36 @@ struct cmd_help_t : public cmd_t {
             }
         }
 
+        std::string path(const cmd_frozen_t& tree, uint32_t node)
+        {
+            std::string out;
+            tree.cmd(node)->get_command_path(out);
+            return out;
+        }
+
+        void walk(const cmd_frozen_t& tree, uint32_t node, cmd_output_t& out)
+        {
+            auto indent = out.indent(2);
+            const uint32_t end = tree.child_end(node);
+            for (uint32_t i = tree.child_begin(node); i < end; ++i) {
+                if (out.structured()) {
+                    cmd_record_t(out, "command").field("path", path(tree, i));
+                } else {
+                    out.println("%s", tree.name(i).data());
+                }
+                walk(tree, i, out);
+            }
+        }
+
         virtual bool on_execute(cmd_tokens_t& tok, cmd_output_t& out, cmd_baton_t user) override
         {
             (void)user;
-            walk(parser_.sub_, out);
+            const auto lock = parser_.read_lock();
+            if (const cmd_frozen_t* tree = parser_.frozen()) {
+                walk(*tree, cmd_frozen_t::npos, out);
+            } else {
+                walk(parser_.sub_, out);
+            }
             return true;
         }
     };
@@ -41,7 +73,25 @@ struct cmd_help_t : public cmd_t {
     virtual bool on_execute(cmd_tokens_t& tok, cmd_output_t& out, cmd_baton_t user) override
     {
         (void)user;
-        print_cmd_list(parser_.sub_, out);
+        const auto lock = parser_.read_lock();
+        if (const cmd_frozen_t* tree = parser_.frozen()) {
+            cmd_output_t::indent_t indent = out.indent(2);
+            const uint32_t end = tree->child_end(cmd_frozen_t::npos);
+            for (uint32_t i = tree->child_begin(cmd_frozen_t::npos); i < end; ++i) {
+                if (out.structured()) {
+                    const cmd_t* cmd = tree->cmd(i);
+                    cmd_record_t(out, "command").field("name", tree->name(i)).field("desc", cmd->desc_);
+                } else {
+                    out.println("%s", tree->name(i).data());
+                }
+            }
+        } else if (out.structured()) {
+            for (const auto& cmd : parser_.sub_) {
+                cmd_record_t(out, "command").field("name", cmd->name_).field("desc", cmd->desc_);
+            }
+        } else {
+            print_cmd_list(parser_.sub_, out);
+        }
         return true;
     }
 };
@@ -0,0 +1,122 @@
+#include "cmd_history.h"
+
+#include <algorithm>
+
+namespace {
+
+// three bytes of a line packed into an index key
+uint32_t gram(const char* in)
+{
+    return (uint32_t(uint8_t(in[0])) << 16) | (uint32_t(uint8_t(in[1])) << 8) | uint32_t(uint8_t(in[2]));
+}
+} // namespace {}
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- cmd_history_index_t
+
+void cmd_history_index_t::update(const cmd_history_list_t& history)
+{
+    if (history.next_number() < next_) {
+        // not the history that was indexed
+        grams_.clear();
+        base_ = next_ = pruned_ = 0;
+    }
+    const uint64_t first = history.first_number();
+    // once more lines were dropped than are held the index is mostly stale
+    if (first - pruned_ > std::max<uint64_t>(history.size(), 1024) || history.next_number() - base_ > UINT32_MAX) {
+        prune(first);
+    }
+    for (uint64_t num = std::max(next_, first); num < history.next_number(); ++num) {
+        const std::string_view line = history[size_t(num - first)];
+        const uint32_t rel = uint32_t(num - base_);
+        for (size_t i = 0; i + 2 < line.size(); ++i) {
+            std::vector<uint32_t>& list = grams_[gram(line.data() + i)];
+            // a trigram may appear more than once in a line
+            if (list.empty() || list.back() != rel) {
+                list.push_back(rel);
+            }
+        }
+    }
+    next_ = history.next_number();
+}
+
+void cmd_history_index_t::prune(uint64_t first)
+{
+    if (first - base_ > UINT32_MAX) {
+        grams_.clear();
+    } else {
+        const uint32_t shift = uint32_t(first - base_);
+        for (auto itt = grams_.begin(); itt != grams_.end();) {
+            std::vector<uint32_t>& list = itt->second;
+            list.erase(list.begin(), std::lower_bound(list.begin(), list.end(), shift));
+            if (list.empty()) {
+                itt = grams_.erase(itt);
+                continue;
+            }
+            for (uint32_t& rel : list) {
+                rel -= shift;
+            }
+            ++itt;
+        }
+    }
+    base_ = first;
+    pruned_ = first;
+}
+
+size_t cmd_history_index_t::search(
+    const cmd_history_list_t& history,
+    const std::string_view& sub,
+    uint64_t before,
+    size_t limit,
+    std::vector<uint64_t>& out)
+{
+    out.clear();
+    update(history);
+    const uint64_t first = history.first_number();
+    before = std::min(before, history.next_number());
+    if (sub.empty() || limit == 0 || before <= first) {
+        return 0;
+    }
+    if (sub.size() < 3) {
+        // too short to be indexed, so check every line
+        for (uint64_t num = before; num-- > first && out.size() < limit;) {
+            if (history[size_t(num - first)].find(sub) != std::string_view::npos) {
+                out.push_back(num);
+            }
+        }
+        return out.size();
+    }
+    // a line holding sub holds all of its trigrams
+    lists_.clear();
+    for (size_t i = 0; i + 2 < sub.size(); ++i) {
+        auto itt = grams_.find(gram(sub.data() + i));
+        if (itt == grams_.end()) {
+            return 0;
+        }
+        if (std::find(lists_.begin(), lists_.end(), &itt->second) == lists_.end()) {
+            lists_.push_back(&itt->second);
+        }
+    }
+    std::sort(lists_.begin(), lists_.end(), [](const std::vector<uint32_t>* a, const std::vector<uint32_t>* b) {
+        return a->size() < b->size();
+    });
+    // walk the shortest list back from the newest line
+    const std::vector<uint32_t>& shortest = *lists_.front();
+    const uint32_t lower = uint32_t(first - base_);
+    auto itt = std::lower_bound(shortest.begin(), shortest.end(), uint32_t(before - base_));
+    while (itt != shortest.begin() && out.size() < limit) {
+        const uint32_t rel = *--itt;
+        if (rel < lower) {
+            break;
+        }
+        bool all = true;
+        for (size_t i = 1; all && i < lists_.size(); ++i) {
+            all = std::binary_search(lists_[i]->begin(), lists_[i]->end(), rel);
+        }
+        // trigrams can be found apart from each other, so check the line
+        const uint64_t num = base_ + rel;
+        if (all && history[size_t(num - first)].find(sub) != std::string_view::npos) {
+            out.push_back(num);
+        }
+    }
+    return out.size();
+}
@@ -1,27 +1,139 @@
 #pragma once
 #include "cmd.h"
 
+#include <unordered_map>
+
+/// @brief cmd_history_index_t, trigram index for substring search of a history.
+///
+/// maps each three byte sequence to the numbers of the lines holding it, in
+/// the order they were recorded.  the index catches up with the lines added
+/// since it was last used and forgets dropped lines once they outnumber the
+/// lines held, so keeping it costs in proportion to the input rather than to
+/// the size of the history.  a search walks the shortest posting list of the
+/// query back from the newest line, so the most recent matches are found
+/// without visiting older lines.
+///
+struct cmd_history_index_t {
+
+    cmd_history_index_t()
+        : base_(0)
+        , next_(0)
+        , pruned_(0)
+    {
+    }
+
+    /// @brief Find the lines holding a substring, most recent first.
+    ///
+    /// stepping back through matches, as reverse incremental search does,
+    /// is done by passing the number of the last match as before.
+    ///
+    /// @param history history to search, the index is brought up to date.
+    /// @param sub substring to search for.
+    /// @param before only lines numbered below this are reported.
+    /// @param limit maximum number of matches to report.
+    /// @param out output list to receive the line numbers.
+    /// @return number of matches found.
+    size_t search(
+        const cmd_history_list_t& history,
+        const std::string_view& sub,
+        uint64_t before,
+        size_t limit,
+        std::vector<uint64_t>& out);
+
+    /// @brief Index the lines added to a history since the last update.
+    void update(const cmd_history_list_t& history);
+
+    /// @brief number of distinct trigrams held.
+    size_t size() const
+    {
+        return grams_.size();
+    }
+
+protected:
+    /// @brief Forget lines numbered below first.
+    void prune(uint64_t first);
+
+    /// @brief line numbers holding each trigram, less base_ so they fit 32 bits.
+    std::unordered_map<uint32_t, std::vector<uint32_t>> grams_;
+    uint64_t base_;
+    /// @brief number of the next line to index.
+    uint64_t next_;
+    /// @brief oldest line number when last pruned.
+    uint64_t pruned_;
+    /// @brief posting lists of a query, reused between searches.
+    std::vector<const std::vector<uint32_t>*> lists_;
+};
+
 struct cmd_history_t : public cmd_t {
 
+    struct cmd_history_search_t : public cmd_t {
+
+        /// @brief search index kept for each session.
+        struct state_t : public cmd_session_t::state_t {
+            cmd_history_index_t index_;
+        };
+
+        cmd_history_search_t(cmd_parser_t& cli, cmd_t* parent, cmd_baton_t user)
+            : cmd_t("search", cli, parent, user)
+        {
+            usage_ = "[-n count] [-before number] substring";
+            desc_ = "list the most recent commands holding a substring";
+        }
+
+        virtual bool on_execute(cmd_tokens_t& tok, cmd_output_t& out, cmd_baton_t user) override
+        {
+            (void)user;
+            const cmd_history_list_t& history = tok.session().history_;
+            // dont match the last thing, which is this command
+            uint64_t limit = 10, before = history.next_number() - 1;
+            cmd_token_t value;
+            if ((tok.pairs.get("-n", value) && !value.get(limit)) || (tok.pairs.get("-before", value) && !value.get(before))) {
+                return on_usage(out, user), false;
+            }
+            std::string sub;
+            for (const cmd_token_t& token : tok.tokens()) {
+                sub.append(sub.empty() ? "" : " ").append(token.get());
+            }
+            if (sub.empty()) {
+                return on_usage(out, user), false;
+            }
+            std::vector<uint64_t> found;
+            tok.session().state<state_t>(this).index_.search(history, sub, before, size_t(limit), found);
+            auto indent = out.indent(2);
+            for (const uint64_t num : found) {
+                std::string_view line;
+                history.find(num, line);
+                if (out.structured()) {
+                    cmd_record_t(out, "history").field("index", num).field("command", line);
+                } else {
+                    out.line("(", cmd_format_t::dec(int64_t(num), 2, '0'), ") ", line);
+                }
+            }
+            return true;
+        }
+    };
+
     cmd_history_t(cmd_parser_t& cli, cmd_t* parent, cmd_baton_t user)
         : cmd_t("history", cli, parent, user)
     {
-        desc_ = "show all previously executed commands";
+        add_sub_command<cmd_history_search_t>(user);
+        desc_ = "show previously executed commands, recalled with !n";
     }
 
     virtual bool on_execute(cmd_tokens_t& tok, cmd_output_t& out, cmd_baton_t user) override
     {
         (void)user;
         auto indent = out.indent(2);
-        size_t num = parser_.history_.size();
-        num ? --num : 0;
-        for (const auto& itt : parser_.history_) {
-            // dont print last thing
-            if (&itt != &parser_.history_.back()) {
-                break;
+        const cmd_history_list_t& history = tok.session().history_;
+        // dont print last thing, which is this command
+        for (size_t i = 0; i + 1 < history.size(); ++i) {
+            // numbered as recalled by '!n'
+            const uint64_t num = history.first_number() + i;
+            if (out.structured()) {
+                cmd_record_t(out, "history").field("index", num).field("command", history[i]);
+            } else {
+                out.line("(", cmd_format_t::dec(int64_t(num), 2, '0'), ") ", history[i]);
             }
-            out.println("(-%02d) %s", (uint32_t)num, itt.c_str());
-            --num;
         }
         return true;
     }
@@ -0,0 +1,88 @@
+#pragma once
+#include "cmd.h"
+
+/// @brief jobs, wait and kill builtins for background jobs.
+///
+/// a command ending in '&' runs on the parser job pool while the session
+/// carries on, waiting for a free worker if every one is busy.  only
+/// commands marked parallel_ can be backgrounded, as the job runs alongside
+/// the session, and of the builtins only echo is.  a job that is done is
+/// reported with its output after the next line executed, unless it was
+/// waited for first.
+///
+struct cmd_jobs_t : public cmd_t {
+
+    cmd_jobs_t(cmd_parser_t& cli, cmd_t* parent, cmd_baton_t user)
+        : cmd_t("jobs", cli, parent, user)
+    {
+        desc_ = "list background jobs, start one by ending a command with '&'";
+    }
+
+    virtual bool on_execute(cmd_tokens_t& tok, cmd_output_t& out, cmd_baton_t user) override
+    {
+        (void)user;
+        auto indent = out.indent(2);
+        for (const auto& job : tok.session().jobs().list()) {
+            if (out.structured()) {
+                cmd_record_t(out, "job")
+                    .field("id", job->id_)
+                    .field("state", job->done() ? "done" : "running")
+                    .field("command", job->expr_);
+            } else {
+                cmd_locale_t::job_state(out, job->id_, job->done(), job->expr_);
+            }
+        }
+        return true;
+    }
+};
+
+struct cmd_wait_t : public cmd_t {
+
+    cmd_wait_t(cmd_parser_t& cli, cmd_t* parent, cmd_baton_t user)
+        : cmd_t("wait", cli, parent, user)
+    {
+        usage_ = "[id]";
+        desc_ = "wait for a background job, or all of them, and show its output";
+    }
+
+    virtual bool on_execute(cmd_tokens_t& tok, cmd_output_t& out, cmd_baton_t user) override
+    {
+        cmd_job_list_t& jobs = tok.session().jobs();
+        if (tok.tokens.empty()) {
+            while (!jobs.list().empty()) {
+                jobs.wait(jobs.list().front()->id_, out);
+            }
+            return true;
+        }
+        uint64_t id = 0;
+        if (!tok.tokens.get(id)) {
+            return on_usage(out, user), false;
+        }
+        if (!jobs.wait(uint32_t(id), out)) {
+            return cmd_locale_t::unknown_job(out, id), false;
+        }
+        return true;
+    }
+};
+
+struct cmd_kill_t : public cmd_t {
+
+    cmd_kill_t(cmd_parser_t& cli, cmd_t* parent, cmd_baton_t user)
+        : cmd_t("kill", cli, parent, user)
+    {
+        usage_ = "id";
+        desc_ = "ask a background job to stop";
+    }
+
+    virtual bool on_execute(cmd_tokens_t& tok, cmd_output_t& out, cmd_baton_t user) override
+    {
+        uint64_t id = 0;
+        if (!tok.tokens.get(id)) {
+            return on_usage(out, user), false;
+        }
+        if (!tok.session().jobs().kill(uint32_t(id))) {
+            return cmd_locale_t::unknown_job(out, id), false;
+        }
+        return true;
+    }
+};
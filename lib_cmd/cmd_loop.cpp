@@ -0,0 +1,195 @@
+#include "cmd_loop.h"
+
+#if CMD_COROUTINES && defined(__linux__)
+
+#include <cerrno>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace {
+
+thread_local cmd_loop_t* current_loop = nullptr;
+
+// makes a loop current for the life of a scope
+struct current_t {
+    current_t(cmd_loop_t* loop)
+        : prev_(current_loop)
+    {
+        current_loop = loop;
+    }
+
+    ~current_t()
+    {
+        current_loop = prev_;
+    }
+
+    cmd_loop_t* prev_;
+};
+
+// coroutine that starts immediately and frees itself when done
+struct detached_t {
+    struct promise_type {
+        detached_t get_return_object()
+        {
+            return {};
+        }
+
+        std::suspend_never initial_suspend() noexcept
+        {
+            return {};
+        }
+
+        std::suspend_never final_suspend() noexcept
+        {
+            return {};
+        }
+
+        void return_void() {}
+
+        void unhandled_exception()
+        {
+            std::terminate();
+        }
+    };
+};
+
+detached_t run_detached(cmd_task_t task, std::function<void(bool)> done, size_t* pending)
+{
+    const bool ok = co_await task;
+    --*pending;
+    if (done) {
+        done(ok);
+    }
+}
+
+} // namespace {}
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- cmd_loop_t
+
+bool cmd_loop_t::wait_t::await_suspend(std::coroutine_handle<> handle)
+{
+    handle_ = handle;
+    epoll_event ev;
+    ev.events = events_ | EPOLLONESHOT;
+    ev.data.ptr = this;
+    if (epoll_ctl(loop_.epoll_, EPOLL_CTL_ADD, fd_, &ev) != 0) {
+        // eg. a regular file, resume straight away
+        ready_ = EPOLLERR;
+        return false;
+    }
+    return true;
+}
+
+cmd_loop_t::cmd_loop_t()
+    : epoll_(epoll_create1(EPOLL_CLOEXEC))
+    , wake_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+    , seq_(0)
+    , pending_(0)
+    , stop_(false)
+{
+    epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = nullptr;
+    epoll_ctl(epoll_, EPOLL_CTL_ADD, wake_, &ev);
+}
+
+cmd_loop_t::~cmd_loop_t()
+{
+    // tasks still suspended here are leaked rather than resumed
+    assert(pending_ == 0);
+    ::close(wake_);
+    ::close(epoll_);
+}
+
+cmd_loop_t* cmd_loop_t::current()
+{
+    return current_loop;
+}
+
+bool cmd_loop_t::block_on(cmd_task_t task)
+{
+    cmd_loop_t loop;
+    bool result = false;
+    loop.spawn(std::move(task), [&result](bool ok) { result = ok; });
+    loop.run();
+    return result;
+}
+
+cmd_loop_t::wait_t cmd_loop_t::readable(int fd)
+{
+    return wait_t{ *this, fd, EPOLLIN, 0, nullptr };
+}
+
+cmd_loop_t::wait_t cmd_loop_t::writable(int fd)
+{
+    return wait_t{ *this, fd, EPOLLOUT, 0, nullptr };
+}
+
+void cmd_loop_t::spawn(cmd_task_t task, std::function<void(bool)> done)
+{
+    const current_t scope(this);
+    ++pending_;
+    run_detached(std::move(task), std::move(done), &pending_);
+}
+
+void cmd_loop_t::run()
+{
+    stop_ = false;
+    while (run_once(-1)) {
+    }
+}
+
+bool cmd_loop_t::run_once(int timeout_ms)
+{
+    const current_t scope(this);
+    if (!timers_.empty()) {
+        // round up so we never wake just before a timer is due
+        const auto wait = timers_.top().when_ - clock_t::now();
+        const auto ms = std::chrono::ceil<std::chrono::milliseconds>(wait).count();
+        const int due = int(std::max<decltype(ms)>(ms, 0));
+        timeout_ms = (timeout_ms < 0) ? due : std::min(timeout_ms, due);
+    }
+    if (pending_ == 0 || stop_) {
+        timeout_ms = 0;
+    }
+    std::array<epoll_event, 256> events;
+    const int count = epoll_wait(epoll_, events.data(), int(events.size()), timeout_ms);
+    for (int i = 0; i < count; ++i) {
+        wait_t* wait = static_cast<wait_t*>(events[i].data.ptr);
+        if (!wait) {
+            uint64_t value = 0;
+            (void)!read(wake_, &value, sizeof(value));
+            continue;
+        }
+        epoll_ctl(epoll_, EPOLL_CTL_DEL, wait->fd_, nullptr);
+        wait->ready_ = events[i].events;
+        wait->handle_.resume();
+    }
+    fire_timers();
+    return pending_ != 0 && !stop_;
+}
+
+void cmd_loop_t::stop()
+{
+    stop_ = true;
+    const uint64_t one = 1;
+    (void)!write(wake_, &one, sizeof(one));
+}
+
+void cmd_loop_t::add_timer(clock_t::time_point when, std::coroutine_handle<> handle)
+{
+    timers_.push(timer_t{ when, seq_++, handle });
+}
+
+void cmd_loop_t::fire_timers()
+{
+    const clock_t::time_point now = clock_t::now();
+    while (!timers_.empty() && timers_.top().when_ <= now) {
+        const std::coroutine_handle<> handle = timers_.top().handle_;
+        timers_.pop();
+        handle.resume();
+    }
+}
+
+#endif // CMD_COROUTINES && defined(__linux__)
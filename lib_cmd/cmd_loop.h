@@ -0,0 +1,161 @@
+#pragma once
+#include "cmd.h"
+
+#if CMD_COROUTINES && defined(__linux__)
+
+#include <chrono>
+
+/// @brief cmd_loop_t, single threaded event loop for coroutine commands.
+///
+/// commands that override cmd_t::on_execute_async can co_await timers and
+/// file descriptor readiness provided by the loop, so thousands of waiting
+/// commands can share the one thread that calls run().  commands find the
+/// loop running them through current().  the loop itself is not thread
+/// safe, apart from stop().
+///
+/// @code
+///     cmd_loop_t loop;
+///     loop.spawn(session.execute_async("fetch 10", out, nullptr));
+///     loop.run();
+/// @endcode
+///
+struct cmd_loop_t {
+
+    typedef std::chrono::steady_clock clock_t;
+
+    /// @brief awaitable that resumes once a point in time has passed.
+    struct sleep_t {
+        cmd_loop_t& loop_;
+        clock_t::time_point when_;
+
+        bool await_ready() const
+        {
+            return when_ <= clock_t::now();
+        }
+
+        void await_suspend(std::coroutine_handle<> handle)
+        {
+            loop_.add_timer(when_, handle);
+        }
+
+        void await_resume() const {}
+    };
+
+    /// @brief awaitable that resumes once a file descriptor is ready.
+    ///
+    /// resumes with the ready epoll events, EPOLLERR is returned straight
+    /// away for descriptors that can not be polled.
+    struct wait_t {
+        cmd_loop_t& loop_;
+        int fd_;
+        uint32_t events_;
+        uint32_t ready_;
+        std::coroutine_handle<> handle_;
+
+        bool await_ready() const
+        {
+            return false;
+        }
+
+        bool await_suspend(std::coroutine_handle<> handle);
+
+        uint32_t await_resume() const
+        {
+            return ready_;
+        }
+    };
+
+    cmd_loop_t();
+    ~cmd_loop_t();
+
+    cmd_loop_t(const cmd_loop_t&) = delete;
+
+    /// @brief the loop running on the calling thread, or nullptr.
+    static cmd_loop_t* current();
+
+    /// @brief Run a task to completion on a private loop.
+    ///
+    /// lets a command implement on_execute with its on_execute_async.
+    ///
+    /// @param task task to run.
+    /// @return result of the task.
+    static bool block_on(cmd_task_t task);
+
+    /// @brief wait for a duration.
+    sleep_t sleep(clock_t::duration duration)
+    {
+        return sleep_t{ *this, clock_t::now() + duration };
+    }
+
+    /// @brief wait until a point in time.
+    sleep_t until(clock_t::time_point when)
+    {
+        return sleep_t{ *this, when };
+    }
+
+    /// @brief wait for a file descriptor to become readable.
+    ///
+    /// only one coroutine may wait on a descriptor at a time.
+    wait_t readable(int fd);
+
+    /// @brief wait for a file descriptor to become writable.
+    ///
+    /// only one coroutine may wait on a descriptor at a time.
+    wait_t writable(int fd);
+
+    /// @brief Start a task on this loop.
+    ///
+    /// the task runs on the calling thread until it first suspends, after
+    /// which it is resumed by run().
+    ///
+    /// @param task task to start.
+    /// @param done called with the result once the task completes.
+    void spawn(cmd_task_t task, std::function<void(bool)> done = nullptr);
+
+    /// @brief Resume tasks until none are left or stop() is called.
+    void run();
+
+    /// @brief Resume any tasks that are ready.
+    ///
+    /// @param timeout_ms longest time to wait for an event, -1 for no limit.
+    /// @return true while tasks remain and the loop is not stopped.
+    bool run_once(int timeout_ms);
+
+    /// @brief Make run() return, may be called from any thread.
+    void stop();
+
+    /// @brief number of spawned tasks that have not completed.
+    size_t pending() const
+    {
+        return pending_;
+    }
+
+protected:
+    struct timer_t {
+        clock_t::time_point when_;
+        /// @brief timers due at the same time fire in the order added.
+        uint64_t seq_;
+        std::coroutine_handle<> handle_;
+
+        bool operator>(const timer_t& rhs) const
+        {
+            return when_ != rhs.when_ ? when_ > rhs.when_ : seq_ > rhs.seq_;
+        }
+    };
+
+    /// @brief resume a coroutine at a point in time.
+    void add_timer(clock_t::time_point when, std::coroutine_handle<> handle);
+
+    /// @brief resume all timers that are due.
+    void fire_timers();
+
+    std::priority_queue<timer_t, std::vector<timer_t>, std::greater<timer_t>> timers_;
+    int epoll_;
+    /// @brief eventfd used to interrupt epoll_wait from stop().
+    int wake_;
+    uint64_t seq_;
+    size_t pending_;
+    std::atomic<bool> stop_;
+};
+
+#endif // CMD_COROUTINES && defined(__linux__)
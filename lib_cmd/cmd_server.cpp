@@ -0,0 +1,399 @@
+#include "cmd_server.h"
+
+#if defined(__linux__)
+
+#include <array>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace {
+
+// epoll tag of the listening socket, wakeups are tagged with their loop
+void* const tag_listen = nullptr;
+
+// bytes read from a socket per call
+const size_t read_size = 16 * 1024;
+
+bool set_nonblocking(int fd)
+{
+    const int flags = fcntl(fd, F_GETFL, 0);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+} // namespace {}
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- cmd_server_t
+
+struct cmd_server_t::client_t {
+
+    client_t(cmd_parser_t& parser, int fd)
+        : fd_(fd)
+        , session_(parser)
+        , out_(cmd_output_t::create_output_buffer())
+        , scan_(0)
+        , sent_(0)
+        , events_(0)
+        , closing_(false)
+    {
+    }
+
+    int fd_;
+    cmd_session_t session_;
+    /// @brief output not yet written, starting at sent_.
+    std::unique_ptr<cmd_output_buffer_t> out_;
+    /// @brief input not yet executed.
+    std::string in_;
+    /// @brief bytes of in_ already searched for a newline.
+    size_t scan_;
+    size_t sent_;
+    /// @brief events registered with epoll.
+    uint32_t events_;
+    /// @brief the peer has closed its side.
+    bool closing_;
+    /// @brief reused command line.
+    std::string line_;
+
+    size_t pending() const
+    {
+        return out_->size() - sent_;
+    }
+};
+
+struct cmd_server_t::loop_t {
+
+    loop_t()
+        : epoll_(-1)
+        , wake_(-1)
+    {
+    }
+
+    ~loop_t()
+    {
+        (epoll_ >= 0) ? (void)::close(epoll_) : (void)0;
+        (wake_ >= 0) ? (void)::close(wake_) : (void)0;
+    }
+
+    int epoll_;
+    /// @brief eventfd used to interrupt epoll_wait when stopping.
+    int wake_;
+    std::thread thread_;
+    std::unordered_map<int, std::unique_ptr<client_t>> clients_;
+};
+
+cmd_server_t::cmd_server_t(cmd_parser_t& parser, cmd_baton_t user)
+    : parser_(parser)
+    , user_(user)
+    , listen_(-1)
+    , port_(0)
+    , running_(false)
+    , sessions_(0)
+    , prompt_("> ")
+    , record_format_(cmd_output_t::e_text)
+    , max_line_(4096)
+    , max_pending_(256 * 1024)
+{
+}
+
+cmd_server_t::~cmd_server_t()
+{
+    stop();
+}
+
+bool cmd_server_t::listen_unix(const std::string& path)
+{
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    if (listen_ >= 0 || path.empty() || path.size() >= sizeof(addr.sun_path)) {
+        return false;
+    }
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, path.data(), path.size());
+    const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return false;
+    }
+    unlink(path.c_str());
+    if (bind(fd, (const sockaddr*)&addr, sizeof(addr)) != 0 || ::listen(fd, SOMAXCONN) != 0 || !set_nonblocking(fd)) {
+        return ::close(fd), false;
+    }
+    listen_ = fd;
+    path_ = path;
+    return true;
+}
+
+bool cmd_server_t::listen_tcp(uint16_t port)
+{
+    if (listen_ >= 0) {
+        return false;
+    }
+    const int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return false;
+    }
+    const int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (bind(fd, (const sockaddr*)&addr, sizeof(addr)) != 0 || ::listen(fd, SOMAXCONN) != 0 || !set_nonblocking(fd) || getsockname(fd, (sockaddr*)&addr, &len) != 0) {
+        return ::close(fd), false;
+    }
+    listen_ = fd;
+    port_ = ntohs(addr.sin_port);
+    return true;
+}
+
+bool cmd_server_t::start(uint32_t threads)
+{
+    if (listen_ < 0 || running_ || threads == 0) {
+        return false;
+    }
+    for (uint32_t i = 0; i < threads; ++i) {
+        std::unique_ptr<loop_t> loop(new loop_t);
+        loop->epoll_ = epoll_create1(EPOLL_CLOEXEC);
+        loop->wake_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (loop->epoll_ < 0 || loop->wake_ < 0) {
+            return loops_.clear(), false;
+        }
+        epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.ptr = loop.get();
+        epoll_ctl(loop->epoll_, EPOLL_CTL_ADD, loop->wake_, &ev);
+        // every loop accepts from the same socket, exclusive wakeups stop
+        // all of them waking for each connection
+        ev.events = EPOLLIN | EPOLLEXCLUSIVE;
+        ev.data.ptr = tag_listen;
+        if (epoll_ctl(loop->epoll_, EPOLL_CTL_ADD, listen_, &ev) != 0) {
+            ev.events = EPOLLIN;
+            epoll_ctl(loop->epoll_, EPOLL_CTL_ADD, listen_, &ev);
+        }
+        loops_.push_back(std::move(loop));
+    }
+    running_ = true;
+    for (auto& loop : loops_) {
+        loop_t* ptr = loop.get();
+        loop->thread_ = std::thread([this, ptr]() { run(*ptr); });
+    }
+    return true;
+}
+
+void cmd_server_t::stop()
+{
+    if (running_.exchange(false)) {
+        for (auto& loop : loops_) {
+            const uint64_t one = 1;
+            (void)!write(loop->wake_, &one, sizeof(one));
+        }
+        for (auto& loop : loops_) {
+            loop->thread_.join();
+        }
+    }
+    loops_.clear();
+    if (listen_ >= 0) {
+        ::close(listen_);
+        listen_ = -1;
+    }
+    if (!path_.empty()) {
+        unlink(path_.c_str());
+        path_.clear();
+    }
+    std::lock_guard<std::mutex> guard(mux_);
+    stopped_.notify_all();
+}
+
+void cmd_server_t::wait()
+{
+    std::unique_lock<std::mutex> lock(mux_);
+    stopped_.wait(lock, [this]() { return !running_; });
+}
+
+void cmd_server_t::run(loop_t& loop)
+{
+    std::array<epoll_event, 256> events;
+    while (running_) {
+        const int count = epoll_wait(loop.epoll_, events.data(), int(events.size()), -1);
+        if (count < 0 && errno != EINTR) {
+            break;
+        }
+        for (int i = 0; i < count; ++i) {
+            const epoll_event& ev = events[i];
+            if (ev.data.ptr == tag_listen) {
+                accept(loop);
+            } else if (ev.data.ptr == &loop) {
+                uint64_t value = 0;
+                (void)!read(loop.wake_, &value, sizeof(value));
+            } else {
+                client_t& client = *static_cast<client_t*>(ev.data.ptr);
+                const bool readable = (ev.events & (EPOLLIN | EPOLLHUP | EPOLLRDHUP)) != 0;
+                if ((ev.events & EPOLLERR) || !pump(loop, client, readable)) {
+                    close(loop, client);
+                }
+            }
+        }
+    }
+    // disconnect everyone still attached to this loop
+    sessions_ -= loop.clients_.size();
+    for (auto& itt : loop.clients_) {
+        ::close(itt.first);
+    }
+    loop.clients_.clear();
+}
+
+void cmd_server_t::accept(loop_t& loop)
+{
+    for (;;) {
+        const int fd = accept4(listen_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            // EAGAIN once another loop has taken the connection
+            return;
+        }
+        if (path_.empty()) {
+            // requests and responses are small so dont wait to coalesce them
+            const int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        }
+        std::unique_ptr<client_t> client(new client_t(parser_, fd));
+        client->out_->set_record_format(record_format_);
+        if (!client->out_->structured()) {
+            client->out_->print<false>("%s", prompt_.c_str());
+        }
+        client_t& ref = *client;
+        loop.clients_.emplace(fd, std::move(client));
+        ++sessions_;
+        if (!pump(loop, ref, false)) {
+            close(loop, ref);
+        }
+    }
+}
+
+bool cmd_server_t::pump(loop_t& loop, client_t& client, bool readable)
+{
+    if (readable && !client.closing_) {
+        // stop after a bounded amount so one client can not starve the rest,
+        // epoll is level triggered so anything left will be reported again
+        char temp[read_size];
+        for (size_t total = 0; total < max_line_ + read_size;) {
+            const ssize_t got = read(client.fd_, temp, sizeof(temp));
+            if (got > 0) {
+                client.in_.append(temp, size_t(got));
+                total += size_t(got);
+                continue;
+            }
+            if (got == 0) {
+                client.closing_ = true;
+            } else if (errno == EINTR) {
+                continue;
+            } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                return false;
+            }
+            break;
+        }
+    }
+    // alternate executing and writing until blocked on the socket
+    for (;;) {
+        if (!process(client) || !flush(client)) {
+            return false;
+        }
+        if (client.pending() != 0 || client.in_.find('\n', client.scan_) == std::string::npos) {
+            break;
+        }
+    }
+    if (client.closing_ && client.pending() == 0) {
+        return false;
+    }
+    watch(loop, client);
+    return true;
+}
+
+bool cmd_server_t::process(client_t& client)
+{
+    size_t start = 0;
+    while (client.pending() < max_pending_) {
+        const size_t end = client.in_.find('\n', client.scan_);
+        if (end == std::string::npos) {
+            client.scan_ = client.in_.size();
+            break;
+        }
+        size_t len = end - start;
+        if (len && client.in_[end - 1] == '\r') {
+            --len;
+        }
+        client.line_.assign(client.in_, start, len);
+        client.session_.execute(client.line_, client.out_.get(), user_);
+        if (!client.out_->structured()) {
+            client.out_->print<false>("%s", prompt_.c_str());
+        }
+        start = end + 1;
+        client.scan_ = start;
+    }
+    client.in_.erase(0, start);
+    client.scan_ -= start;
+    // a line longer than the limit will never be executed
+    return client.scan_ <= max_line_;
+}
+
+bool cmd_server_t::flush(client_t& client)
+{
+    const std::string_view view = client.out_->view();
+    while (client.sent_ < view.size()) {
+        const ssize_t sent = send(client.fd_, view.data() + client.sent_, view.size() - client.sent_, MSG_NOSIGNAL);
+        if (sent > 0) {
+            client.sent_ += size_t(sent);
+        } else if (sent < 0 && errno == EINTR) {
+            continue;
+        } else if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return true;
+        } else {
+            return false;
+        }
+    }
+    // everything went so the buffer can be reused from the start
+    client.out_->reset();
+    client.sent_ = 0;
+    return true;
+}
+
+void cmd_server_t::watch(loop_t& loop, client_t& client)
+{
+    // once closing only the remaining output is of interest
+    uint32_t events = client.closing_ ? 0u : uint32_t(EPOLLRDHUP);
+    if (client.pending()) {
+        events |= EPOLLOUT;
+    }
+    // stop reading while the client is not keeping up with its output
+    if (!client.closing_ && client.pending() < max_pending_) {
+        events |= EPOLLIN;
+    }
+    if (events == client.events_) {
+        return;
+    }
+    epoll_event ev;
+    ev.events = events;
+    ev.data.ptr = &client;
+    epoll_ctl(loop.epoll_, client.events_ ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, client.fd_, &ev);
+    client.events_ = events;
+}
+
+void cmd_server_t::close(loop_t& loop, client_t& client)
+{
+    const int fd = client.fd_;
+    epoll_ctl(loop.epoll_, EPOLL_CTL_DEL, fd, nullptr);
+    ::close(fd);
+    loop.clients_.erase(fd);
+    --sessions_;
+}
+
+#endif // defined(__linux__)
@@ -0,0 +1,153 @@
+#pragma once
+#include "cmd.h"
+
+#include <condition_variable>
+#include <thread>
+
+#if defined(__linux__)
+
+/// @brief cmd_server_t, serve command sessions over a local socket.
+///
+/// clients connect over a unix domain socket or loopback tcp and send
+/// newline terminated commands, each client getting its own cmd_session_t.
+/// a small fixed pool of threads each run an epoll loop, so thousands of
+/// clients can be served without a thread per connection.  input is framed
+/// incrementally as it arrives and output is written without blocking,
+/// reading from a client pauses while too much of its output is pending.
+///
+/// commands run on the loop thread serving the client, so while one runs,
+/// every other client of that loop waits.  a slow command, or a wait for a
+/// background job, stalls them all.  long commands should be started as
+/// '&' jobs, which run on the parser job pool, and more loop threads make
+/// fewer clients share each stall.
+///
+/// @code
+///     cmd_server_t server(parser);
+///     server.listen_unix("/tmp/app.sock") && server.start(2);
+/// @endcode
+///
+struct cmd_server_t {
+
+    /// @brief constructor.
+    ///
+    /// all commands should be added to the parser before the server starts.
+    ///
+    /// @param parser parser holding the shared command tree.
+    /// @param user user data passed to commands.
+    cmd_server_t(cmd_parser_t& parser, cmd_baton_t user = nullptr);
+
+    ~cmd_server_t();
+
+    /// @brief Listen on a unix domain socket.
+    ///
+    /// any existing file at the path is replaced.
+    ///
+    /// @param path socket path.
+    /// @return true if the socket is listening.
+    bool listen_unix(const std::string& path);
+
+    /// @brief Listen on a loopback tcp port.
+    ///
+    /// @param port port number, zero to pick any free port.
+    /// @return true if the socket is listening.
+    bool listen_tcp(uint16_t port = 0);
+
+    /// @brief the tcp port being listened on, zero if not tcp.
+    uint16_t port() const
+    {
+        return port_;
+    }
+
+    /// @brief Start serving clients.
+    ///
+    /// @param threads number of event loop threads.
+    /// @return true if the server started.
+    bool start(uint32_t threads = 1);
+
+    /// @brief Stop serving and disconnect all clients.
+    void stop();
+
+    /// @brief Block until the server is stopped.
+    void wait();
+
+    /// @brief Set the prompt sent on connection and after each command.
+    ///
+    /// the prompt is not sent when the output format is structured.
+    void set_prompt(const std::string& prompt)
+    {
+        prompt_ = prompt;
+    }
+
+    /// @brief Set the output format used for every client.
+    void set_record_format(cmd_output_t::record_format_t format)
+    {
+        record_format_ = format;
+    }
+
+    /// @brief Set the per client limits.
+    ///
+    /// @param max_line longest input line, longer lines close the client.
+    /// @param max_pending output bytes pending before input is paused.
+    void set_limits(size_t max_line, size_t max_pending)
+    {
+        max_line_ = max_line;
+        max_pending_ = max_pending;
+    }
+
+    /// @brief number of connected clients.
+    size_t sessions() const
+    {
+        return sessions_.load(std::memory_order_relaxed);
+    }
+
+protected:
+    struct client_t;
+    struct loop_t;
+
+    /// @brief Run an event loop until stopped.
+    void run(loop_t& loop);
+
+    /// @brief Accept all pending connections.
+    void accept(loop_t& loop);
+
+    /// @brief Read, execute and write for a client.
+    ///
+    /// @return false if the client should be closed.
+    bool pump(loop_t& loop, client_t& client, bool readable);
+
+    /// @brief Execute complete lines in the input buffer.
+    bool process(client_t& client);
+
+    /// @brief Write pending output.
+    bool flush(client_t& client);
+
+    /// @brief Update the events a client is waiting for.
+    void watch(loop_t& loop, client_t& client);
+
+    /// @brief Disconnect a client.
+    void close(loop_t& loop, client_t& client);
+
+    cmd_parser_t& parser_;
+    cmd_baton_t user_;
+
+    /// @brief listening socket.
+    int listen_;
+    /// @brief unix socket path to remove when stopped.
+    std::string path_;
+    uint16_t port_;
+
+    std::vector<std::unique_ptr<loop_t>> loops_;
+    std::atomic<bool> running_;
+    std::atomic<size_t> sessions_;
+
+    /// @brief signalled when the server stops.
+    std::mutex mux_;
+    std::condition_variable stopped_;
+
+    std::string prompt_;
+    cmd_output_t::record_format_t record_format_;
+    size_t max_line_;
+    size_t max_pending_;
+};
+
+#endif // defined(__linux__)
@@ -0,0 +1,112 @@
+#pragma once
+#include "cmd.h"
+
+#include <algorithm>
+
+struct cmd_stats_t : public cmd_t {
+
+    struct cmd_stats_clear_t : public cmd_t {
+        cmd_stats_clear_t(cmd_parser_t& cli, cmd_t* parent, cmd_baton_t user)
+            : cmd_t("clear", cli, parent, user)
+        {
+            desc_ = "reset all command statistics";
+        }
+
+        virtual bool on_execute(cmd_tokens_t& tok, cmd_output_t& out, cmd_baton_t user) override
+        {
+            (void)tok, (void)out, (void)user;
+            parser_.stats_clear();
+            return true;
+        }
+    };
+
+    cmd_stats_t(cmd_parser_t& cli, cmd_t* parent, cmd_baton_t user)
+        : cmd_t("stats", cli, parent, user)
+    {
+        usage_ = "[count]";
+        desc_ = "show the slowest and most used commands";
+        add_sub_command<cmd_stats_clear_t>();
+    }
+
+#if CMD_STATS
+    static double usec(uint64_t ns)
+    {
+        return double(ns) / 1000.0;
+    }
+
+    void print_records(const std::vector<const cmd_t*>& list, cmd_output_t& out)
+    {
+        std::string path;
+        for (const cmd_t* cmd : list) {
+            const cmd_metrics_t& m = cmd->metrics_;
+            path.clear();
+            cmd->get_command_path(path);
+            cmd_record_t(out, "stats")
+                .field("command", path)
+                .field("calls", m.calls())
+                .field("fails", m.fails())
+                .field("total_ns", m.total())
+                .field("p99_ns", m.latency().percentile(0.99))
+                .field("tokenize_p99_ns", m.phase(cmd_metrics_t::e_tokenize).percentile(0.99))
+                .field("dispatch_p99_ns", m.phase(cmd_metrics_t::e_dispatch).percentile(0.99))
+                .field("execute_p99_ns", m.phase(cmd_metrics_t::e_execute).percentile(0.99));
+        }
+    }
+
+    void print_table(const std::vector<const cmd_t*>& list, size_t count, cmd_output_t& out)
+    {
+        auto indent = out.indent(2);
+        out.println("%8s %6s %12s %10s %10s %10s %10s  %s",
+            "calls", "fails", "total us", "p99 us", "tok p99", "disp p99", "exec p99", "command");
+        std::string path;
+        for (size_t i = 0; i < list.size() && i < count; ++i) {
+            const cmd_metrics_t& m = list[i]->metrics_;
+            path.clear();
+            list[i]->get_command_path(path);
+            out.println("%8llu %6llu %12.1f %10.1f %10.1f %10.1f %10.1f  %s",
+                (unsigned long long)m.calls(),
+                (unsigned long long)m.fails(),
+                usec(m.total()),
+                usec(m.latency().percentile(0.99)),
+                usec(m.phase(cmd_metrics_t::e_tokenize).percentile(0.99)),
+                usec(m.phase(cmd_metrics_t::e_dispatch).percentile(0.99)),
+                usec(m.phase(cmd_metrics_t::e_execute).percentile(0.99)),
+                path.c_str());
+        }
+    }
+#endif
+
+    virtual bool on_execute(cmd_tokens_t& tok, cmd_output_t& out, cmd_baton_t user) override
+    {
+        (void)user;
+        auto indent = out.indent(2);
+#if CMD_STATS
+        uint64_t count = 10;
+        if (!tok.tokens.empty() && !tok.tokens.front().get(count)) {
+            return on_usage(out, user), false;
+        }
+        std::vector<const cmd_t*> list;
+        if (parser_.stats_collect(list) == 0) {
+            return cmd_locale_t::no_stats(out), true;
+        }
+        std::stable_sort(list.begin(), list.end(), [](const cmd_t* a, const cmd_t* b) {
+            return a->metrics_.total() > b->metrics_.total();
+        });
+        if (out.structured()) {
+            // every command, consumers can sort as they please
+            return print_records(list, out), true;
+        }
+        out.println("by total time:");
+        print_table(list, size_t(count), out);
+        std::stable_sort(list.begin(), list.end(), [](const cmd_t* a, const cmd_t* b) {
+            return a->metrics_.latency().percentile(0.99) > b->metrics_.latency().percentile(0.99);
+        });
+        out.println("by p99 latency:");
+        print_table(list, size_t(count), out);
+        return true;
+#else
+        (void)tok;
+        return cmd_locale_t::stats_disabled(out), false;
+#endif
+    }
+};
@@ -0,0 +1,487 @@
+#include "cmd_store.h"
+
+#if defined(__linux__)
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+// file header, followed by the snapshot sections and then the journal
+struct header_t {
+    char magic_[8];
+    uint32_t version_;
+    // layout of an identifier slot, as the tables are copied as they are
+    uint32_t slot_size_;
+    // entries in each identifier table
+    uint64_t slots_;
+    uint64_t table_;
+    uint64_t names_;
+    // number of set identifiers
+    uint64_t count_;
+    // bytes of null terminated history lines
+    uint64_t history_;
+    // bytes of null terminated alias name and command path pairs
+    uint64_t aliases_;
+};
+
+// journal record header, followed by size_ bytes
+struct record_t {
+    uint32_t type_;
+    uint32_t size_;
+    uint32_t check_;
+};
+
+const char magic[8] = { 'c', 'm', 'd', 's', 't', 'o', 'r', 'e' };
+const uint32_t version = 1;
+
+// fnv-1a over the type and body of a record
+uint32_t checksum(uint32_t type, const char* data, size_t size)
+{
+    uint32_t hash = 2166136261u ^ type;
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ uint8_t(data[i])) * 16777619u;
+    }
+    return hash;
+}
+
+bool write_all(int fd, const void* data, size_t size)
+{
+    const char* ptr = static_cast<const char*>(data);
+    while (size) {
+        const ssize_t done = ::write(fd, ptr, size);
+        if (done < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        ptr += done;
+        size -= size_t(done);
+    }
+    return true;
+}
+
+// read only mapping of a file for the life of a scope
+struct mapping_t {
+    mapping_t(int fd, size_t size)
+        : data_(nullptr)
+        , size_(size)
+    {
+        void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            data_ = static_cast<const char*>(data);
+        }
+    }
+
+    ~mapping_t()
+    {
+        if (data_) {
+            munmap(const_cast<char*>(data_), size_);
+        }
+    }
+
+    const char* data_;
+    size_t size_;
+};
+} // namespace {}
+
+cmd_store_t::cmd_store_t(cmd_session_t& session)
+    : session_(session)
+    , fd_(-1)
+    , snapshot_(0)
+    , journal_(0)
+    , line_(0)
+    , generation_(0)
+{
+}
+
+cmd_store_t::~cmd_store_t()
+{
+    close();
+}
+
+bool cmd_store_t::open(const char* path)
+{
+    close();
+    const int fd = ::open(path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        ::close(fd);
+        return false;
+    }
+    path_ = path;
+    fd_ = fd;
+    const size_t size = size_t(info.st_size);
+    if (size == 0) {
+        // a new store starts from the current state
+        if (!compact()) {
+            close();
+            return false;
+        }
+    } else {
+        size_t valid = 0;
+        bool ok = false;
+        {
+            const mapping_t map(fd, size);
+            ok = map.data_ && load(map.data_, size, valid);
+        }
+        // drop a record torn by a crash so appends follow the last good one
+        if (!ok || (valid < size && ftruncate(fd, off_t(valid)) != 0)) {
+            close();
+            return false;
+        }
+        mark_synced();
+    }
+    session_.idents_.track_changes(true);
+    return true;
+}
+
+bool cmd_store_t::load(const char* data, size_t size, size_t& valid)
+{
+    typedef cmd_idents_t::slot_t slot_t;
+    static_assert(std::is_trivially_copyable<slot_t>::value, "slots are copied as bytes");
+    header_t header;
+    if (size < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic_, magic, sizeof(magic)) != 0 || header.version_ != version || header.slot_size_ != sizeof(slot_t)) {
+        return false;
+    }
+    // each section must fit in what is left of the file, counts are
+    // bounded first so the section sizes can not overflow
+    if (header.slots_ > size || header.table_ > size) {
+        return false;
+    }
+    size_t left = size - sizeof(header);
+    const uint64_t sections[] = { header.slots_ * sizeof(slot_t), header.table_ * sizeof(uint32_t), header.names_, header.history_, header.aliases_ };
+    for (const uint64_t bytes : sections) {
+        if (bytes > left) {
+            return false;
+        }
+        left -= size_t(bytes);
+    }
+    // lookups rely on a power of two table that is never full
+    if ((header.table_ & (header.table_ - 1)) != 0 || header.slots_ * 2 > header.table_) {
+        return false;
+    }
+
+    // the identifier tables are copied in bulk, without parsing or rehashing
+    const char* ptr = data + sizeof(header);
+    const slot_t* slots = reinterpret_cast<const slot_t*>(ptr);
+    const uint32_t* table = reinterpret_cast<const uint32_t*>(ptr + sections[0]);
+    const char* names = ptr + sections[0] + sections[1];
+    if (!check_idents(slots, size_t(header.slots_), table, size_t(header.table_), names, size_t(header.names_), size_t(header.count_))) {
+        return false;
+    }
+    cmd_idents_t& idents = session_.idents_;
+    idents.slots_.assign(slots, slots + header.slots_);
+    idents.table_.assign(table, table + header.table_);
+    idents.names_.assign(names, names + header.names_);
+    ptr = names + sections[2];
+    idents.count_ = size_t(header.count_);
+    idents.changed_.clear();
+    idents.cleared_ = false;
+    // slots handed out before refer to the old table
+    ++idents.epoch_;
+
+    for (const char* end = ptr + header.history_; ptr < end;) {
+        const size_t len = strnlen(ptr, size_t(end - ptr));
+        session_.history_.push(std::string_view(ptr, len));
+        ptr += len + 1;
+    }
+
+    // only the last list of aliases counts
+    const char* aliases = ptr;
+    size_t aliases_size = size_t(header.aliases_);
+    ptr += aliases_size;
+    snapshot_ = size_t(ptr - data);
+
+    const char* end = data + size;
+    while (size_t(end - ptr) >= sizeof(record_t)) {
+        record_t rec;
+        memcpy(&rec, ptr, sizeof(rec));
+        const char* body = ptr + sizeof(rec);
+        if (rec.size_ > size_t(end - body) || rec.check_ != checksum(rec.type_, body, rec.size_)) {
+            break;
+        }
+        if (rec.type_ == e_aliases) {
+            aliases = body;
+            aliases_size = rec.size_;
+        } else {
+            apply(rec.type_, body, rec.size_);
+        }
+        ptr = body + rec.size_;
+    }
+    add_aliases(aliases, aliases_size);
+    valid = size_t(ptr - data);
+    journal_ = valid - snapshot_;
+    return true;
+}
+
+bool cmd_store_t::check_idents(
+    const cmd_idents_t::slot_t* slots,
+    size_t slots_size,
+    const uint32_t* table,
+    size_t table_size,
+    const char* names,
+    size_t names_size,
+    size_t count)
+{
+    size_t set = 0;
+    for (size_t i = 0; i < slots_size; ++i) {
+        const cmd_idents_t::slot_t& slot = slots[i];
+        // names are null terminated
+        if (size_t(slot.off_) + slot.len_ >= names_size || names[slot.off_ + slot.len_] != '\0') {
+            return false;
+        }
+        // changes are tracked from the load on
+        if (slot.changed_) {
+            return false;
+        }
+        set += slot.set_ ? 1 : 0;
+    }
+    if (set != count) {
+        return false;
+    }
+    // every entry names a slot and there is one for each slot, which with
+    // the load factor checked leaves empty entries to end each probe
+    size_t found = 0;
+    for (size_t i = 0; i < table_size; ++i) {
+        if (table[i] > slots_size) {
+            return false;
+        }
+        found += table[i] ? 1 : 0;
+    }
+    return found == slots_size;
+}
+
+void cmd_store_t::apply(uint32_t type, const char* data, size_t size)
+{
+    cmd_idents_t& idents = session_.idents_;
+    switch (type) {
+    case e_line:
+        session_.history_.push(std::string_view(data, size));
+        break;
+    case e_set:
+        if (size >= sizeof(uint64_t)) {
+            uint64_t value;
+            memcpy(&value, data, sizeof(value));
+            idents.set(std::string_view(data + sizeof(value), size - sizeof(value)), value);
+        }
+        break;
+    case e_erase:
+        idents.erase(std::string_view(data, size));
+        break;
+    case e_clear:
+        idents.clear();
+        break;
+    default:
+        // written by a newer version
+        break;
+    }
+}
+
+void cmd_store_t::add_aliases(const char* data, size_t size)
+{
+    cmd_parser_t& parser = session_.parser_;
+    for (const char* end = data + size; data < end;) {
+        const std::string_view name(data, strnlen(data, size_t(end - data)));
+        data += name.size() + 1;
+        if (data >= end) {
+            break;
+        }
+        const std::string_view path(data, strnlen(data, size_t(end - data)));
+        data += path.size() + 1;
+        // walk the command path from the root
+        const cmd_index_t* index = &parser.index_;
+        cmd_t* cmd = nullptr;
+        for (size_t at = 0; at < path.size() && index;) {
+            const size_t space = std::min(path.find(' ', at), path.size());
+            cmd = index->find_exact(path.substr(at, space - at));
+            if (cmd == nullptr) {
+                break;
+            }
+            index = cmd->sub_.empty() ? nullptr : &cmd->index_;
+            at = space + 1;
+        }
+        if (cmd) {
+            parser.alias_add(cmd, std::string(name));
+        }
+    }
+}
+
+void cmd_store_t::get_aliases(std::string& out) const
+{
+    const cmd_parser_t& parser = session_.parser_;
+    const auto lock = parser.read_lock();
+    for (const auto& itt : parser.alias_) {
+        out.append(itt.first);
+        out.push_back('\0');
+        itt.second->get_command_path(out);
+        out.push_back('\0');
+    }
+}
+
+void cmd_store_t::record(uint32_t type, const void* data, size_t size, const void* extra, size_t extra_size)
+{
+    const size_t at = buffer_.size();
+    buffer_.resize(at + sizeof(record_t));
+    buffer_.append(static_cast<const char*>(data), size);
+    buffer_.append(static_cast<const char*>(extra), extra_size);
+    record_t rec;
+    rec.type_ = type;
+    rec.size_ = uint32_t(size + extra_size);
+    rec.check_ = checksum(type, buffer_.data() + at + sizeof(rec), rec.size_);
+    memcpy(&buffer_[at], &rec, sizeof(rec));
+}
+
+bool cmd_store_t::sync()
+{
+    if (!is_open()) {
+        return false;
+    }
+    buffer_.clear();
+    slots_.clear();
+    cmd_idents_t& idents = session_.idents_;
+    const bool cleared = idents.changes(slots_);
+    if (cleared) {
+        record(e_clear, nullptr, 0);
+    }
+    for (const uint32_t slot : slots_) {
+        const std::string_view name = idents.name(slot);
+        if (idents.is_set(slot)) {
+            const uint64_t value = idents.slots_[slot].value_;
+            record(e_set, &value, sizeof(value), name.data(), name.size());
+        } else {
+            record(e_erase, name.data(), name.size());
+        }
+    }
+    // lines dropped from the history since the last sync are lost
+    const cmd_history_list_t& history = session_.history_;
+    for (uint64_t number = std::max(line_, history.first_number()); number < history.next_number(); ++number) {
+        std::string_view line;
+        if (history.find(number, line)) {
+            record(e_line, line.data(), line.size());
+        }
+    }
+    const uint64_t generation = session_.parser_.generation_;
+    if (generation != generation_) {
+        std::string aliases;
+        get_aliases(aliases);
+        record(e_aliases, aliases.data(), aliases.size());
+    }
+    if (!buffer_.empty() && !write_all(fd_, buffer_.data(), buffer_.size())) {
+        // keep everything pending so the next sync tries again, and cut off
+        // anything partly written so later records still load
+        restore_changes(cleared);
+        if (ftruncate(fd_, off_t(snapshot_ + journal_)) != 0) {
+            close();
+        }
+        return false;
+    }
+    journal_ += buffer_.size();
+    line_ = history.next_number();
+    generation_ = generation;
+    return true;
+}
+
+bool cmd_store_t::compact()
+{
+    if (!is_open()) {
+        return false;
+    }
+    cmd_idents_t& idents = session_.idents_;
+    // erased identifiers are left out of the snapshot
+    if (idents.slots() > idents.size()) {
+        idents.compact();
+    }
+    // the snapshot holds every change, which are noted again on failure
+    slots_.clear();
+    const bool cleared = idents.changes(slots_);
+    std::string history, aliases;
+    for (const std::string_view line : session_.history_) {
+        history.append(line);
+        history.push_back('\0');
+    }
+    get_aliases(aliases);
+
+    header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic_, magic, sizeof(magic));
+    header.version_ = version;
+    header.slot_size_ = sizeof(cmd_idents_t::slot_t);
+    header.slots_ = idents.slots_.size();
+    header.table_ = idents.table_.size();
+    header.names_ = idents.names_.size();
+    header.count_ = idents.count_;
+    header.history_ = history.size();
+    header.aliases_ = aliases.size();
+
+    // written aside then renamed over the store, so it is never seen partly written
+    const std::string temp = path_ + ".tmp";
+    const int fd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    bool ok = fd >= 0;
+    ok = ok && write_all(fd, &header, sizeof(header));
+    ok = ok && write_all(fd, idents.slots_.data(), idents.slots_.size() * sizeof(cmd_idents_t::slot_t));
+    ok = ok && write_all(fd, idents.table_.data(), idents.table_.size() * sizeof(uint32_t));
+    ok = ok && write_all(fd, idents.names_.data(), idents.names_.size());
+    ok = ok && write_all(fd, history.data(), history.size());
+    ok = ok && write_all(fd, aliases.data(), aliases.size());
+    ok = ok && fsync(fd) == 0;
+    if (fd >= 0) {
+        ::close(fd);
+    }
+    ok = ok && rename(temp.c_str(), path_.c_str()) == 0;
+    const int append = ok ? ::open(path_.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC) : -1;
+    if (append < 0) {
+        unlink(temp.c_str());
+        restore_changes(cleared);
+        return false;
+    }
+    ::close(fd_);
+    fd_ = append;
+    snapshot_ = sizeof(header) + header.slots_ * sizeof(cmd_idents_t::slot_t) + header.table_ * sizeof(uint32_t) + header.names_ + header.history_ + header.aliases_;
+    journal_ = 0;
+    mark_synced();
+    return true;
+}
+
+void cmd_store_t::mark_synced()
+{
+    slots_.clear();
+    session_.idents_.changes(slots_);
+    line_ = session_.history_.next_number();
+    generation_ = session_.parser_.generation_;
+}
+
+void cmd_store_t::restore_changes(bool cleared)
+{
+    cmd_idents_t& idents = session_.idents_;
+    idents.cleared_ |= cleared;
+    for (const uint32_t slot : slots_) {
+        idents.touch(slot);
+    }
+}
+
+void cmd_store_t::close()
+{
+    if (fd_ >= 0) {
+        ::close(fd_);
+        session_.idents_.track_changes(false);
+    }
+    fd_ = -1;
+    path_.clear();
+    snapshot_ = 0;
+    journal_ = 0;
+}
+
+#endif // defined(__linux__)
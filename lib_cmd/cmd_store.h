@@ -0,0 +1,143 @@
+#pragma once
+#include "cmd.h"
+
+#if defined(__linux__)
+
+/// @brief cmd_store_t, keep the state of a session across restarts.
+///
+/// the identifiers and history of a session, along with the aliases of its
+/// parser, are kept in one file holding a snapshot followed by a journal of
+/// the changes made since.  open() maps the file and copies the identifier
+/// tables out of it as they are, so nothing is parsed or rehashed, then
+/// applies the journal.  sync() appends the changes made since the last
+/// sync, and compact() replaces the file with a fresh snapshot.
+///
+/// the snapshot is only ever replaced by renaming a complete file over it,
+/// and each journal record carries a checksum, so after a crash open()
+/// drops any torn record at the end and carries on from there.
+///
+/// the store must be used from the thread that executes in the session.
+///
+/// @code
+///     cmd_store_t store(parser.session_);
+///     store.open("/var/lib/app/session");
+///     parser.execute(line, out, nullptr);
+///     store.sync();
+/// @endcode
+///
+struct cmd_store_t {
+
+    /// @brief constructor.
+    ///
+    /// @param session session whose state is kept.
+    cmd_store_t(cmd_session_t& session);
+
+    cmd_store_t(const cmd_store_t&) = delete;
+
+    ~cmd_store_t();
+
+    /// @brief Open a store, loading its state into the session.
+    ///
+    /// the identifiers of the session are replaced, invalidating the slots
+    /// handed out before as cmd_idents_t::epoch() tells, history lines and
+    /// aliases are added to those it already has.  aliases to commands that
+    /// no longer exist are skipped.  a missing file is created.
+    ///
+    /// @param path file holding the store.
+    /// @return false if the file can not be opened, is not a store or its
+    ///         snapshot is corrupt, in which case the session is unchanged.
+    bool open(const char* path);
+
+    /// @brief Append the changes made since the last sync.
+    ///
+    /// @return false if the store is not open or the write failed.
+    bool sync();
+
+    /// @brief Replace the file with a snapshot of the current state.
+    ///
+    /// @return false if the store is not open or the snapshot could not be
+    ///         written, in which case the old file is left in place.
+    bool compact();
+
+    /// @brief Close the store, changes not synced are not kept.
+    void close();
+
+    /// @brief check if the store is open.
+    bool is_open() const
+    {
+        return fd_ >= 0;
+    }
+
+    /// @brief bytes of journal following the snapshot.
+    uint64_t journal_size() const
+    {
+        return journal_;
+    }
+
+protected:
+    /// @brief journal record types.
+    enum type_t : uint32_t {
+        e_line = 1,
+        e_set,
+        e_erase,
+        e_clear,
+        e_aliases,
+    };
+
+    /// @brief Load a mapped file, returning the bytes that are valid.
+    bool load(const char* data, size_t size, size_t& valid);
+
+    /// @brief Check snapshot identifier tables can be adopted as they are.
+    ///
+    /// every name must lie within the names, every table entry name a slot
+    /// and the set count agree with the slots, so a corrupt file can not
+    /// send lookups out of bounds.
+    static bool check_idents(
+        const cmd_idents_t::slot_t* slots,
+        size_t slots_size,
+        const uint32_t* table,
+        size_t table_size,
+        const char* names,
+        size_t names_size,
+        size_t count);
+
+    /// @brief Apply one journal record.
+    void apply(uint32_t type, const char* data, size_t size);
+
+    /// @brief Add aliases from null terminated name and path pairs.
+    void add_aliases(const char* data, size_t size);
+
+    /// @brief Append null terminated name and path pairs of all aliases.
+    void get_aliases(std::string& out) const;
+
+    /// @brief Add a record to buffer_.
+    void record(uint32_t type, const void* data, size_t size, const void* extra = nullptr, size_t extra_size = 0);
+
+    /// @brief Note the state as saved so sync() starts from here.
+    void mark_synced();
+
+    /// @brief Note the identifier changes taken into slots_ again after a failed write.
+    void restore_changes(bool cleared);
+
+    cmd_session_t& session_;
+    std::string path_;
+    int fd_;
+
+    /// @brief bytes of snapshot at the start of the file.
+    uint64_t snapshot_;
+
+    /// @brief bytes of journal following the snapshot.
+    uint64_t journal_;
+
+    /// @brief number of the next history line to journal.
+    uint64_t line_;
+
+    /// @brief parser generation the aliases were last journaled at.
+    uint64_t generation_;
+
+    /// @brief records waiting to be written.
+    std::string buffer_;
+    std::vector<uint32_t> slots_;
+};
+
+#endif // defined(__linux__)
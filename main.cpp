@@ -1,6 +1,7 @@
 #include "lib_cmd/cmd_echo.h"
 #include "lib_cmd/lib_cmd.h"
 #include <array>
+#include <cstring>
 
 struct cmd_exit_t : public cmd_t {
     cmd_exit_t(cmd_parser_t& parser, cmd_t* parent, cmd_baton_t user)
@@ -12,6 +13,8 @@ struct cmd_exit_t : public cmd_t {
     bool on_execute(cmd_tokens_t& tok, cmd_output_t& out, cmd_baton_t user) override
     {
         (void)user;
+        // buffered output is lost on exit
+        out.flush();
         exit(0);
         return false;
     }
@@ -30,20 +33,52 @@ int main(const int argc, const char** args)
     parser.add_command<cmd_echo_t>();
     parser.add_command<cmd_expr_t>();
     parser.add_command<cmd_history_t>();
+    parser.add_command<cmd_stats_t>();
+    parser.add_command<cmd_jobs_t>();
+    parser.add_command<cmd_wait_t>();
+    parser.add_command<cmd_kill_t>();
+    // the command tree is complete so flatten it for dispatch
+    parser.freeze();
     // create output stream
     std::unique_ptr<cmd_output_t> out(cmd_output_t::create_output_stdio(stdout));
+#if defined(__linux__)
+    // keeps identifiers, history and aliases across restarts
+    cmd_store_t store(parser.session_);
+#endif
+    // select structured output for machine consumers
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(args[i], "--jsonl") == 0) {
+            out->set_record_format(cmd_output_t::e_jsonl);
+        } else if (strcmp(args[i], "--binary") == 0) {
+            out->set_record_format(cmd_output_t::e_binary);
+        }
+#if defined(__linux__)
+        else if (strcmp(args[i], "--store") == 0 && i + 1 < argc && !store.open(args[++i])) {
+            fprintf(stderr, "unable to open store '%s'\n", args[i]);
+            return 1;
+        }
+#endif
+    }
+    // the prompt is only for people
+    const bool prompt = !out->structured();
     // REPL (read-eval-print loop)
-    out->print<false>("> ");
+    prompt ? out->print<false>("> ") : (void)0;
+    out->flush();
     while (fgets(buffer.data(), buffer.size(), stdin)) {
         const size_t size = strnlen(buffer.data(), buffer.size());
         buffer.data()[size ? size - 1 : 0] = '\0';
-        std::string string(buffer.data(), buffer.size());
+        // only the line just read, the buffer holds older input past it
+        std::string string(buffer.data());
         if (string.empty()) {
             break;
         }
         if (!parser.execute(string, out.get(), nullptr)) {
         }
-        out->print<false>("> ");
+#if defined(__linux__)
+        store.sync();
+#endif
+        prompt ? out->print<false>("> ") : (void)0;
+        out->flush();
     }
     // exit
     return 0;
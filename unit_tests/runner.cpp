@@ -14,6 +14,32 @@ void init() {
     TEST(init_test_1);
     TEST(init_test_2);
     TEST(init_test_strtoll);
+    TEST(init_test_tokens);
+    TEST(init_test_index);
+    TEST(init_test_prepared);
+    TEST(init_test_idents);
+    TEST(init_test_expr);
+    TEST(init_test_levenshtein);
+    TEST(init_test_fuzzy);
+    TEST(init_test_stats);
+    TEST(init_test_output);
+    TEST(init_test_async);
+    TEST(init_test_buffer);
+    TEST(init_test_record);
+    TEST(init_test_format);
+    TEST(init_test_session);
+    TEST(init_test_parallel);
+    TEST(init_test_jobs);
+    TEST(init_test_alloc);
+    TEST(init_test_memory);
+    TEST(init_test_history);
+#if defined(__linux__)
+    TEST(init_test_server);
+    TEST(init_test_store);
+#endif
+#if CMD_COROUTINES && defined(__linux__)
+    TEST(init_test_coro);
+#endif
 }
 
 int main(int argc, char** args)
@@ -0,0 +1,108 @@
+#include "runner.h"
+
+#define CMD_ALLOC_COUNT
+#include "../lib_cmd/cmd_alloc.h"
+
+namespace {
+
+// prints its arguments without allocating
+struct cmd_args_t : public cmd_t {
+
+    cmd_args_t(cmd_parser_t& cli, cmd_t* parent, cmd_baton_t user, const char* name = "args")
+        : cmd_t(name, cli, parent, user)
+    {
+    }
+
+    virtual bool on_execute(cmd_tokens_t& tok, cmd_output_t& out, cmd_baton_t user) override
+    {
+        (void)user;
+        for (const cmd_token_t& token : tok.tokens.tokens_) {
+            out.println("%s", token.c_str());
+        }
+        cmd_token_t value;
+        if (tok.pairs.get("-n", value)) {
+            out.println("n=%s", value.c_str());
+        }
+        return !tok.flags.get("-fail");
+    }
+};
+
+struct cmd_sub_t : public cmd_args_t {
+
+    cmd_sub_t(cmd_parser_t& cli, cmd_t* parent, cmd_baton_t user)
+        : cmd_args_t(cli, parent, user, "sub")
+    {
+    }
+};
+
+struct test_t : public test_base_t {
+
+    test_t()
+        : test_base_t(__FILE__)
+    {
+    }
+
+    // allocations made by a number of executes of each expression
+    uint64_t allocs(cmd_parser_t& parser, cmd_output_buffer_t& out, uint32_t count)
+    {
+        const std::vector<std::string> exprs = {
+            "args",
+            "args one two three four five six seven eight nine ten eleven",
+            "args sub a b",
+            "args -n 12 -v -q c",
+            "args $x $y;args sub -n $x",
+            "args a longer argument that will not fit in a small string",
+        };
+        cmd_alloc_t::scope_t scope;
+        for (uint32_t i = 0; i < count; ++i) {
+            for (const std::string& expr : exprs) {
+                out.reset();
+                parser.execute(expr, &out, nullptr);
+            }
+        }
+        return scope.allocs();
+    }
+
+    virtual bool run() override
+    {
+        cmd_parser_t parser(nullptr);
+        parser.add_command<cmd_args_t>()->add_sub_command<cmd_sub_t>();
+        parser.idents_.set("x", 1234);
+        parser.idents_.set("y", 0xffff);
+        parser.session_.set_history_limit(64);
+        std::unique_ptr<cmd_output_buffer_t> out(cmd_output_t::create_output_buffer());
+
+        // the hook sees allocations made on this thread
+        {
+            cmd_alloc_t::scope_t scope;
+            std::unique_ptr<cmd_session_t> session(new cmd_session_t(parser));
+            CHECK(scope.allocs() >= 1);
+        }
+
+        // once warmed up repeated commands of the same shape allocate nothing
+        CHECK(allocs(parser, *out, 100) > 0);
+        CHECK(allocs(parser, *out, 100) == 0);
+        CHECK(parser.history_.size() == 64);
+        CHECK(parser.history_.back() == "args a longer argument that will not fit in a small string");
+        out->reset();
+        CHECK(parser.execute("args -n 7 z", out.get(), nullptr));
+        CHECK(out->view() == "  z\n  n=7\n");
+
+        // and the same for the frozen tree
+        parser.freeze();
+        allocs(parser, *out, 2);
+        CHECK(allocs(parser, *out, 100) == 0);
+
+        // failures still report and stop later expressions
+        out->reset();
+        CHECK(!parser.execute("args -fail;args never", out.get(), nullptr));
+        CHECK(out->view().find("never") == std::string_view::npos);
+        return true;
+    }
+};
+} // namespace {}
+
+test_base_t* init_test_alloc()
+{
+    return new test_t();
+}
@@ -0,0 +1,120 @@
+#include "runner.h"
+
+#include <thread>
+
+namespace {
+
+struct test_t : public test_base_t {
+
+    test_t()
+        : test_base_t(__FILE__)
+    {
+    }
+
+    std::vector<std::string> lines(FILE* fd)
+    {
+        std::vector<std::string> out;
+        rewind(fd);
+        char buffer[256];
+        while (fgets(buffer, sizeof(buffer), fd)) {
+            out.push_back(buffer);
+        }
+        return out;
+    }
+
+    // several threads printing with their own indentation
+    bool test_block()
+    {
+        const uint32_t threads = 4, count = 5000;
+        FILE* fd = tmpfile();
+        CHECK(fd);
+        {
+            std::unique_ptr<cmd_output_t> out(cmd_output_t::create_output_async(fd, 64, cmd_output_t::e_block));
+            std::vector<std::thread> workers;
+            for (uint32_t t = 0; t < threads; ++t) {
+                workers.emplace_back([&out, t]() {
+                    auto indent = out->indent(t);
+                    for (uint32_t i = 0; i < count; ++i) {
+                        out->print("t%u", t);
+                        out->print<false>(" %u", i);
+                        out->eol();
+                    }
+                });
+            }
+            for (auto& worker : workers) {
+                worker.join();
+            }
+        }
+        const auto all = lines(fd);
+        CHECK(all.size() == threads * count);
+        std::vector<uint32_t> next(threads, 0);
+        for (const std::string& line : all) {
+            uint32_t t = 0, i = 0;
+            const size_t lead = line.find_first_not_of(' ');
+            CHECK(sscanf(line.c_str() + lead, "t%u %u", &t, &i) == 2);
+            CHECK(t < threads);
+            // default indent plus the threads own
+            CHECK(lead == 2 + t);
+            // lines from one thread keep their order
+            CHECK(i == next[t]++);
+        }
+        fclose(fd);
+        return true;
+    }
+
+    // a full queue discards lines and reports how many
+    bool test_drop()
+    {
+        const uint32_t count = 20000;
+        FILE* fd = tmpfile();
+        CHECK(fd);
+        {
+            std::unique_ptr<cmd_output_t> out(cmd_output_t::create_output_async(fd, 4, cmd_output_t::e_drop));
+            for (uint32_t i = 0; i < count; ++i) {
+                out->println("line %u", i);
+            }
+        }
+        uint64_t written = 0, dropped = 0;
+        for (const std::string& line : lines(fd)) {
+            unsigned long long num = 0;
+            if (sscanf(line.c_str(), "... %llu lines dropped", &num) == 1) {
+                dropped += num;
+            } else {
+                ++written;
+            }
+        }
+        CHECK(written + dropped == count);
+        fclose(fd);
+        return true;
+    }
+
+    // each instance starts a thread afresh, however many came before
+    bool test_instances()
+    {
+        FILE* fd = tmpfile();
+        CHECK(fd);
+        for (uint32_t i = 0; i < 100; ++i) {
+            std::unique_ptr<cmd_output_t> out(cmd_output_t::create_output_async(fd, 4, cmd_output_t::e_block));
+            out->print("%u", i);
+            // left unfinished and indented, which must not carry over
+            auto indent = out->indent(4);
+            out->print("x");
+        }
+        const auto all = lines(fd);
+        CHECK(!all.empty() && all.front().find("  0") == 0);
+        CHECK(all.front().find("  1      x") != std::string::npos);
+        fclose(fd);
+        return true;
+    }
+
+    virtual bool run() override
+    {
+        return test_block() && test_drop() && test_instances();
+    }
+};
+} // namespace {}
+
+test_base_t* init_test_async()
+{
+    return new test_t();
+}
@@ -0,0 +1,69 @@
+#include "runner.h"
+
+namespace {
+
+struct cmd_items_t : public cmd_t {
+    cmd_items_t(cmd_parser_t& cli, cmd_t* parent, cmd_baton_t user)
+        : cmd_t("list", cli, parent, user)
+    {
+    }
+
+    virtual bool on_execute(cmd_tokens_t& tok, cmd_output_t& out, cmd_baton_t user) override
+    {
+        (void)user;
+        uint64_t count = 0;
+        tok.tokens.get(count);
+        for (uint64_t i = 0; i < count; ++i) {
+            out.println("item %d", int(i));
+        }
+        return true;
+    }
+};
+
+struct test_t : public test_base_t {
+
+    test_t()
+        : test_base_t(__FILE__)
+    {
+    }
+
+    virtual bool run() override
+    {
+        std::unique_ptr<cmd_output_buffer_t> out(cmd_output_t::create_output_buffer());
+        CHECK(out->view().empty());
+        out->println("a %d", 1);
+        {
+            auto indent = out->indent(2);
+            out->print("b");
+            out->print<false>("%s", "c");
+            out->eol();
+        }
+        CHECK(out->view() == "  a 1\n    bc\n");
+        out->reset();
+        CHECK(out->view().empty() && out->size() == 0);
+
+        // results of whole commands
+        cmd_parser_t parser;
+        parser.add_command<cmd_items_t>();
+        CHECK(parser.execute("list 3", out.get(), nullptr));
+        CHECK(out->view() == "  item 0\n  item 1\n  item 2\n");
+
+        // reset keeps the memory so the same output does not move
+        out->reset();
+        CHECK(parser.execute("list 2000", out.get(), nullptr));
+        const char* data = out->view().data();
+        const size_t size = out->size();
+        for (uint32_t i = 0; i < 10; ++i) {
+            out->reset();
+            CHECK(parser.execute("list 2000", out.get(), nullptr));
+            CHECK(out->view().data() == data && out->size() == size);
+        }
+        return true;
+    }
+};
+} // namespace {}
+
+test_base_t* init_test_buffer()
+{
+    return new test_t();
+}
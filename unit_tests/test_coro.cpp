@@ -0,0 +1,161 @@
+#include "runner.h"
+
+#include "../lib_cmd/cmd_echo.h"
+#include "../lib_cmd/cmd_loop.h"
+
+#if CMD_COROUTINES && defined(__linux__)
+
+#include <chrono>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+namespace {
+
+// waits on the loop then prints its name
+struct cmd_delay_t : public cmd_t {
+
+    cmd_delay_t(cmd_parser_t& cli, cmd_t* parent, cmd_baton_t user)
+        : cmd_t("delay", cli, parent, user)
+    {
+        usage_ = "ms name";
+    }
+
+    virtual bool on_execute(cmd_tokens_t& tok, cmd_output_t& out, cmd_baton_t user) override
+    {
+        return cmd_loop_t::block_on(on_execute_async(tok, out, user));
+    }
+
+    virtual cmd_task_t on_execute_async(cmd_tokens_t& tok, cmd_output_t& out, cmd_baton_t user) override
+    {
+        uint64_t ms = 0;
+        cmd_token_t name;
+        if (!tok.tokens.get(ms) || !tok.tokens.get(name)) {
+            co_return false;
+        }
+        co_await cmd_loop_t::current()->sleep(std::chrono::milliseconds(ms));
+        out.println("%s", name.c_str());
+        co_return true;
+    }
+};
+
+// waits for a descriptor to become readable then prints a byte from it
+struct cmd_readfd_t : public cmd_t {
+
+    cmd_readfd_t(cmd_parser_t& cli, cmd_t* parent, cmd_baton_t user)
+        : cmd_t("readfd", cli, parent, user)
+    {
+    }
+
+    virtual cmd_task_t on_execute_async(cmd_tokens_t& tok, cmd_output_t& out, cmd_baton_t user) override
+    {
+        uint64_t fd = 0;
+        if (!tok.tokens.get(fd)) {
+            co_return false;
+        }
+        const uint32_t events = co_await cmd_loop_t::current()->readable(int(fd));
+        char ch = 0;
+        if (!(events & EPOLLIN) || read(int(fd), &ch, 1) != 1) {
+            co_return false;
+        }
+        out.println("%c", ch);
+        co_return true;
+    }
+};
+
+struct test_t : public test_base_t {
+
+    test_t()
+        : test_base_t(__FILE__)
+    {
+    }
+
+    virtual bool run() override
+    {
+        cmd_parser_t parser(nullptr);
+        parser.add_command<cmd_delay_t>();
+        parser.add_command<cmd_readfd_t>();
+        parser.add_command<cmd_echo_t>();
+
+        // thousands of waiting commands share one thread
+        {
+            const size_t count = 2000;
+            std::vector<std::unique_ptr<cmd_session_t>> sessions;
+            std::vector<std::unique_ptr<cmd_output_buffer_t>> outs;
+            size_t passed = 0;
+            cmd_loop_t loop;
+            for (size_t i = 0; i < count; ++i) {
+                sessions.emplace_back(new cmd_session_t(parser));
+                outs.emplace_back(cmd_output_t::create_output_buffer());
+                loop.spawn(
+                    sessions.back()->execute_async("delay 50 x;delay 0 y", outs.back().get(), nullptr),
+                    [&passed](bool ok) { passed += ok; });
+            }
+            CHECK(loop.pending() == count);
+            const auto start = std::chrono::steady_clock::now();
+            loop.run();
+            const auto taken = std::chrono::steady_clock::now() - start;
+            CHECK(taken < std::chrono::seconds(5));
+            CHECK(loop.pending() == 0);
+            CHECK(passed == count);
+            for (const auto& out : outs) {
+                CHECK(out->view() == "  x\n  y\n");
+            }
+        }
+
+        // resumes when a descriptor becomes readable
+        {
+            int fds[2];
+            CHECK(pipe(fds) == 0);
+            std::unique_ptr<cmd_output_buffer_t> out(cmd_output_t::create_output_buffer());
+            cmd_session_t session(parser);
+            bool result = false;
+            cmd_loop_t loop;
+            const std::string expr = "readfd " + std::to_string(fds[0]);
+            loop.spawn(session.execute_async(expr, out.get(), nullptr), [&result](bool ok) { result = ok; });
+            CHECK(loop.run_once(10));
+            CHECK(out->view().empty());
+            CHECK(write(fds[1], "k", 1) == 1);
+            loop.run();
+            CHECK(result);
+            CHECK(out->view() == "  k\n");
+            close(fds[0]);
+            close(fds[1]);
+        }
+
+        // synchronous commands, usage and failures through execute_async
+        {
+            std::unique_ptr<cmd_output_buffer_t> out(cmd_output_t::create_output_buffer());
+            cmd_session_t session(parser);
+            bool result = false;
+            cmd_loop_t loop;
+            loop.spawn(session.execute_async("echo hi;delay 1 a", out.get(), nullptr), [&result](bool ok) { result = ok; });
+            loop.run();
+            CHECK(result);
+            CHECK(out->view().find("tokens: hi") != std::string_view::npos);
+            CHECK(out->view().find("  a\n") != std::string_view::npos);
+            out->reset();
+            loop.spawn(session.execute_async("delay ?", out.get(), nullptr), [&result](bool ok) { result = ok; });
+            loop.run();
+            CHECK(out->view().find("ms name") != std::string_view::npos);
+            out->reset();
+            loop.spawn(session.execute_async("delay x;echo no", out.get(), nullptr), [&result](bool ok) { result = ok; });
+            loop.run();
+            CHECK(!result);
+            CHECK(out->view().find("no") == std::string_view::npos);
+        }
+
+        // coroutine commands still run through execute
+        std::unique_ptr<cmd_output_buffer_t> out(cmd_output_t::create_output_buffer());
+        CHECK(parser.execute("delay 1 s", out.get(), nullptr));
+        CHECK(out->view() == "  s\n");
+        return true;
+    }
+};
+} // namespace {}
+
+test_base_t* init_test_coro()
+{
+    return new test_t();
+}
+
+#endif // CMD_COROUTINES && defined(__linux__)
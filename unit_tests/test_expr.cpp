@@ -0,0 +1,67 @@
+#include "runner.h"
+
+#include "../lib_cmd/cmd_expr.h"
+
+namespace {
+
+struct test_t : public test_base_t {
+
+    test_t()
+        : test_base_t(__FILE__)
+    {
+    }
+
+    virtual bool run() override
+    {
+        cmd_parser_t parser;
+        parser.add_command<cmd_expr_t>();
+        std::unique_ptr<cmd_output_buffer_t> out(cmd_output_t::create_output_buffer());
+
+        // spellings that lex the same evaluate the same
+        CHECK(parser.execute("expr eval x = 2", out.get(), nullptr));
+        for (const char* expr : { "expr eval x+1*3", "expr eval x + 1 * 3", "expr eval  x+ 1 *3 " }) {
+            out->reset();
+            CHECK(parser.execute(expr, out.get(), nullptr));
+            CHECK(out->view() == "      0x5\n");
+        }
+        std::string expr;
+        cmd_tokens_t tokens(nullptr);
+        cmd_expr_t::cmd_expr_eval_t* eval = static_cast<cmd_expr_t::cmd_expr_eval_t*>(parser.sub_[0]->sub_[0].get());
+        tokens.tokenize("x+1*(3-y)");
+        CHECK(eval->join_expr(tokens, expr) && expr == "x + 1 * ( 3 - y )");
+        tokens.tokenize("  x +1 * ( 3-y) ");
+        CHECK(eval->join_expr(tokens, expr) && expr == "x + 1 * ( 3 - y )");
+
+        // reading unknown names does not give them a slot
+        const uint32_t slots = parser.idents_.slots();
+        for (uint32_t i = 0; i < 100; ++i) {
+            out->reset();
+            CHECK(!parser.execute("expr eval unknown" + std::to_string(i) + " + 1", out.get(), nullptr));
+            CHECK(out->view().find("cant dereference 'unknown") != std::string_view::npos);
+        }
+        out->reset();
+        CHECK(parser.execute("expr eval never", out.get(), nullptr));
+        CHECK(out->view().find("never") != std::string_view::npos);
+        CHECK(parser.idents_.slots() == slots);
+
+        // a cached expression sees names assigned after it was compiled
+        out->reset();
+        CHECK(!parser.execute("expr eval later * 2", out.get(), nullptr));
+        CHECK(parser.execute("expr eval later = 4", out.get(), nullptr));
+        CHECK(parser.idents_.slots() == slots + 1);
+        out->reset();
+        CHECK(parser.execute("expr eval later * 2", out.get(), nullptr));
+        CHECK(out->view() == "      0x8\n");
+        CHECK(parser.execute("expr set other 6", out.get(), nullptr));
+        out->reset();
+        CHECK(parser.execute("expr eval other = other + later", out.get(), nullptr));
+        CHECK(out->view() == "      other = 0xa\n");
+        return true;
+    }
+};
+} // namespace {}
+
+test_base_t* init_test_expr()
+{
+    return new test_t();
+}
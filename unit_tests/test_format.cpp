@@ -0,0 +1,106 @@
+#include "runner.h"
+
+#include "../lib_cmd/cmd_expr.h"
+
+#include <cstdio>
+
+namespace {
+
+struct test_t : public test_base_t {
+
+    uint64_t seed_;
+
+    test_t()
+        : test_base_t(__FILE__)
+        , seed_(11)
+    {
+    }
+
+    uint64_t rand()
+    {
+        seed_ = seed_ * 6364136223846793005ull + 1442695040888963407ull;
+        return seed_;
+    }
+
+    // random value with a random number of significant bits
+    uint64_t value()
+    {
+        const uint32_t bits = uint32_t(rand() >> 58);
+        return rand() >> bits;
+    }
+
+    std::string expect(const char* fmt, ...)
+    {
+        char temp[128];
+        va_list args;
+        va_start(args, fmt);
+        const int len = vsnprintf(temp, sizeof(temp), fmt, args);
+        va_end(args);
+        return std::string(temp, size_t(len));
+    }
+
+    template <typename... args_t>
+    std::string format(const args_t&... args)
+    {
+        std::string out;
+        (cmd_format_t::append(out, args), ...);
+        return out;
+    }
+
+    virtual bool run() override
+    {
+        // edge values
+        CHECK(format(uint64_t(0)) == "0");
+        CHECK(format(int64_t(INT64_MIN)) == expect("%lld", (long long)INT64_MIN));
+        CHECK(format(UINT64_MAX) == expect("%llu", (unsigned long long)UINT64_MAX));
+        CHECK(format(cmd_format_t::hex(0)) == "0x0");
+        CHECK(format(cmd_format_t::hex(UINT64_MAX)) == "0xffffffffffffffff");
+        CHECK(format(cmd_format_t::dec(-5, 3, '0')) == expect("%03d", -5));
+        CHECK(format(cmd_format_t::pad("", 4)) == "    ");
+        CHECK(format(cmd_format_t::pad("abcdef", 3)) == "abcdef");
+        CHECK(format("a", 'b', std::string("c"), std::string_view("d"), 1, -2) == "abcd1-2");
+
+        // compare against printf for random values and widths
+        for (uint32_t i = 0; i < 10000; ++i) {
+            const uint64_t u = value();
+            const int64_t s = int64_t(value()) * ((rand() & 1) ? 1 : -1);
+            const uint32_t w = uint32_t(rand() % 24);
+            CHECK(format(u) == expect("%llu", (unsigned long long)u));
+            CHECK(format(s) == expect("%lld", (long long)s));
+            CHECK(format(cmd_format_t::hex(u)) == expect("0x%llx", (unsigned long long)u));
+            CHECK(format(cmd_format_t::hex(u, w)) == expect("0x%0*llx", int(w), (unsigned long long)u));
+            CHECK(format(cmd_format_t::dec(s, w)) == expect("%*lld", int(w), (long long)s));
+            CHECK(format(cmd_format_t::dec(s, w, '0')) == expect("%0*lld", int(w), (long long)s));
+            const std::string str(rand() % 12, 'x');
+            CHECK(format(cmd_format_t::pad(str, int32_t(w))) == expect("%*s", int(w), str.c_str()));
+            CHECK(format(cmd_format_t::pad(str, -int32_t(w))) == expect("%-*s", int(w), str.c_str()));
+        }
+
+        // whole lines through an output with indentation
+        std::unique_ptr<cmd_output_buffer_t> out(cmd_output_t::create_output_buffer());
+        {
+            auto indent = out->indent(2);
+            out->line(cmd_format_t::pad("x", 4), " ", cmd_format_t::hex(255));
+            out->line<false>("(-", cmd_format_t::dec(3, 2, '0'), ")");
+        }
+        CHECK(out->view() == "       x 0xff\n(-03)\n");
+
+        // same result as println for the ported listings
+        cmd_parser_t parser;
+        parser.add_command<cmd_expr_t>();
+        std::unique_ptr<cmd_output_buffer_t> ref(cmd_output_t::create_output_buffer());
+        out->reset();
+        CHECK(parser.execute("expr set abc 1234", out.get(), nullptr));
+        CHECK(parser.execute("expr list", out.get(), nullptr));
+        ref->println("  1 variables:");
+        ref->println("    %8s 0x%llx", "abc", 1234ull);
+        CHECK(out->view() == ref->view());
+        return true;
+    }
+};
+} // namespace {}
+
+test_base_t* init_test_format()
+{
+    return new test_t();
+}
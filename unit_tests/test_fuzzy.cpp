@@ -0,0 +1,133 @@
+#include "runner.h"
+
+#include <algorithm>
+
+namespace {
+
+struct cmd_named_t : public cmd_t {
+    cmd_named_t(cmd_parser_t& cli, cmd_t* parent, cmd_baton_t user)
+        : cmd_t((const char*)user, cli, parent, user)
+    {
+    }
+};
+
+struct test_t : public test_base_t {
+
+    uint64_t seed_;
+    std::vector<std::string> words_;
+
+    test_t()
+        : test_base_t(__FILE__)
+        , seed_(7)
+    {
+    }
+
+    uint32_t rand()
+    {
+        seed_ = seed_ * 6364136223846793005ull + 1442695040888963407ull;
+        return uint32_t(seed_ >> 33);
+    }
+
+    // random name over a small alphabet so that near misses are common
+    const char* word()
+    {
+        std::string out;
+        const uint32_t len = 2 + rand() % 5;
+        for (uint32_t i = 0; i < len; ++i) {
+            out.push_back(char('a' + rand() % 5));
+        }
+        words_.push_back(out);
+        return words_.back().c_str();
+    }
+
+    // collect every command path in depth first order
+    void paths(const cmd_t* cmd, std::string path, std::vector<std::pair<std::string, const cmd_t*>>& out)
+    {
+        path += (path.empty() ? "" : " ") + std::string(cmd->name_);
+        out.emplace_back(path, cmd);
+        for (const auto& sub : cmd->sub_) {
+            paths(sub.get(), path, out);
+        }
+    }
+
+    virtual bool run() override
+    {
+        // names must outlive the commands that point at them
+        words_.reserve(1024);
+        cmd_parser_t parser;
+        for (uint32_t i = 0; i < 16; ++i) {
+            cmd_t* root = parser.add_command<cmd_named_t>((cmd_baton_t)word());
+            for (uint32_t j = 0; j < 6; ++j) {
+                cmd_t* sub = root->add_sub_command<cmd_named_t>((cmd_baton_t)word());
+                for (uint32_t k = 0; k < 3; ++k) {
+                    sub->add_sub_command<cmd_named_t>((cmd_baton_t)word());
+                }
+            }
+        }
+        std::vector<std::pair<std::string, const cmd_t*>> keys;
+        for (const auto& cmd : parser.sub_) {
+            paths(cmd.get(), "", keys);
+        }
+        const cmd_fuzzy_t& fuzzy = parser.fuzzy();
+        CHECK(fuzzy.size() == keys.size());
+
+        for (uint32_t i = 0; i < 200; ++i) {
+            // query either a mutated path or a random string
+            std::string query = keys[rand() % keys.size()].first;
+            if (rand() % 4 == 0) {
+                query = word();
+            } else if (!query.empty()) {
+                query[rand() % query.size()] = char('a' + rand() % 5);
+            }
+            const uint32_t max = rand() % 4;
+
+            // radius queries must match a linear scan in insertion order
+            std::vector<const cmd_t*> expect;
+            std::vector<uint32_t> dist;
+            for (const auto& key : keys) {
+                const uint32_t d = cmd_util_t::levenshtein(key.first.c_str(), query.c_str());
+                dist.push_back(d);
+                if (d <= max) {
+                    expect.push_back(key.second);
+                }
+            }
+            std::vector<cmd_fuzzy_t::match_t> found;
+            CHECK(fuzzy.find(query, max, found) == expect.size());
+            for (size_t j = 0; j < found.size(); ++j) {
+                CHECK(found[j].cmd_ == expect[j]);
+                CHECK(found[j].distance_ == dist[found[j].ordinal_]);
+                CHECK(found[j].key_ == keys[found[j].ordinal_].first);
+            }
+
+            // nearest must return the k closest, ties broken by insertion order
+            std::vector<uint32_t> order;
+            for (uint32_t j = 0; j < keys.size(); ++j) {
+                if (dist[j] <= max) {
+                    order.push_back(j);
+                }
+            }
+            std::stable_sort(order.begin(), order.end(),
+                [&](uint32_t a, uint32_t b) { return dist[a] < dist[b]; });
+            const size_t k = 1 + rand() % 4;
+            order.resize(std::min(order.size(), k));
+            found.clear();
+            CHECK(fuzzy.nearest(query, k, max, found) == order.size());
+            for (size_t j = 0; j < found.size(); ++j) {
+                CHECK(found[j].ordinal_ == order[j]);
+            }
+        }
+
+        // aliases are indexed and the index follows tree changes
+        CHECK(parser.alias_add(parser.sub_.front().get(), "zzqq"));
+        std::vector<cmd_fuzzy_t::match_t> found;
+        CHECK(parser.fuzzy().find("zzqx", 1, found) == 1);
+        CHECK(found[0].alias_ && found[0].cmd_ == parser.sub_.front().get());
+        return true;
+    }
+};
+} // namespace {}
+
+test_base_t* init_test_fuzzy()
+{
+    return new test_t();
+}
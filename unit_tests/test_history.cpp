@@ -0,0 +1,279 @@
+#include "runner.h"
+
+#include "../lib_cmd/cmd_expr.h"
+#include "../lib_cmd/cmd_history.h"
+
+namespace {
+
+// counts allocations made through it
+struct counting_resource_t : public std::pmr::memory_resource {
+
+    counting_resource_t()
+        : allocs_(0)
+    {
+    }
+
+    uint64_t allocs_;
+
+protected:
+    virtual void* do_allocate(size_t bytes, size_t align) override
+    {
+        ++allocs_;
+        return std::pmr::new_delete_resource()->allocate(bytes, align);
+    }
+
+    virtual void do_deallocate(void* ptr, size_t bytes, size_t align) override
+    {
+        std::pmr::new_delete_resource()->deallocate(ptr, bytes, align);
+    }
+
+    virtual bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+        return this == &other;
+    }
+};
+
+struct test_t : public test_base_t {
+
+    test_t()
+        : test_base_t(__FILE__)
+    {
+    }
+
+    // the held lines are the most recent ones recorded, in order
+    bool recent(const cmd_history_list_t& list, const std::vector<std::string>& lines)
+    {
+        CHECK(list.size() <= lines.size());
+        const size_t skip = lines.size() - list.size();
+        size_t i = 0;
+        for (const std::string_view line : list) {
+            CHECK(line == lines[skip + i]);
+            CHECK(line.data()[line.size()] == '\0');
+            ++i;
+        }
+        CHECK(i == list.size());
+        return true;
+    }
+
+    bool list()
+    {
+        counting_resource_t resource;
+        std::string_view line;
+
+        // numbering, duplicates and recall
+        {
+            cmd_history_list_t list(&resource, 16, 1024);
+            CHECK(list.empty() && list.next_number() == 1);
+            CHECK(list.push("one"));
+            CHECK(list.push("two"));
+            CHECK(!list.push("two"));
+            CHECK(list.push("one"));
+            CHECK(list.size() == 3 && list.back() == "one");
+            CHECK(list.find(2, line) && line == "two");
+            CHECK(!list.find(0, line) && !list.find(4, line));
+            CHECK(list.recall("!!", line) && line == "one");
+            CHECK(list.recall(" !1 ", line) && line == "one");
+            CHECK(list.recall("!-2", line) && line == "two");
+            CHECK(list.recall("!9", line) && line.empty());
+            CHECK(list.recall("!-0", line) && line.empty());
+            CHECK(!list.recall("one", line));
+            CHECK(!list.recall("!x", line));
+            // a line held by the list can be recorded again
+            CHECK(list.push(list[1]));
+            CHECK(list.back() == "two" && list.size() == 4);
+        }
+
+        // the line limit drops the oldest
+        {
+            cmd_history_list_t list(&resource, 4, 1024);
+            std::vector<std::string> lines;
+            for (uint32_t i = 0; i < 10; ++i) {
+                lines.push_back("line " + std::to_string(i));
+                CHECK(list.push(lines.back()));
+            }
+            CHECK(list.size() == 4 && list.first_number() == 7);
+            CHECK(recent(list, lines));
+            CHECK(list.find(7, line) && line == "line 6");
+        }
+
+        // the byte limit wraps the text, of every length
+        {
+            cmd_history_list_t list(&resource, 1000, 64);
+            std::vector<std::string> lines;
+            CHECK(!list.push(std::string(64, 'x')));
+            for (uint32_t i = 0; i < 500; ++i) {
+                lines.push_back(std::string(1 + (i * 7) % 30, char('a' + i % 26)));
+                CHECK(list.push(lines.back()));
+                CHECK(!list.empty() && list.back() == lines.back());
+                CHECK(recent(list, lines));
+            }
+            CHECK(list.next_number() == 501);
+
+            // once wrapped recording reuses the rings
+            const uint64_t allocs = resource.allocs_;
+            for (uint32_t i = 0; i < 1000; ++i) {
+                list.push(list[0]);
+            }
+            CHECK(resource.allocs_ == allocs);
+        }
+
+        // limits can be changed, keeping the numbers
+        {
+            cmd_history_list_t list(&resource, 100, 4096);
+            std::vector<std::string> lines;
+            for (uint32_t i = 0; i < 50; ++i) {
+                lines.push_back("line " + std::to_string(i));
+                list.push(lines.back());
+            }
+            list.set_limit(10, 4096);
+            CHECK(list.size() == 10 && list.first_number() == 41);
+            CHECK(recent(list, lines));
+            list.set_limit(100, 24);
+            CHECK(list.size() == 3 && list.next_number() == 51);
+            CHECK(recent(list, lines));
+            CHECK(list.find(50, line) && line == "line 49");
+        }
+        return true;
+    }
+
+    bool session()
+    {
+        cmd_parser_t parser(nullptr, cmd_memory_t(std::pmr::get_default_resource(), 4096, 8));
+        parser.add_command<cmd_expr_t>();
+        parser.add_command<cmd_history_t>();
+        std::unique_ptr<cmd_output_buffer_t> out(cmd_output_t::create_output_buffer());
+
+        // nothing to repeat yet
+        parser.execute(" ", out.get(), nullptr);
+        CHECK(parser.last_cmd().empty() && parser.history_.empty());
+
+        CHECK(parser.execute("expr set x 1", out.get(), nullptr));
+        CHECK(parser.execute("expr eval x", out.get(), nullptr));
+        CHECK(parser.execute("expr set x 2", out.get(), nullptr));
+
+        // recalled lines are echoed and recorded unless they repeat the last
+        out->reset();
+        CHECK(parser.execute("!2", out.get(), nullptr));
+        CHECK(out->view() == "  > expr eval x\n      x = 0x2\n");
+        CHECK(parser.history_.size() == 4 && parser.last_cmd() == "expr eval x");
+        out->reset();
+        CHECK(parser.execute("expr set x 3;!!; ;!-3", out.get(), nullptr));
+        CHECK(out->view().find("> expr set x 2") != std::string_view::npos);
+        CHECK(parser.history_.size() == 6);
+        uint64_t value = 0;
+        CHECK(parser.idents_.get("x", value) && value == 2);
+
+        // unknown events fail
+        out->reset();
+        CHECK(!parser.execute("!99;expr set x 9", out.get(), nullptr));
+        CHECK(out->view().find("'!99' is not in the history") != std::string_view::npos);
+        CHECK(parser.history_.size() == 6);
+
+        // the history command lists the numbers to recall by
+        out->reset();
+        CHECK(parser.execute("history", out.get(), nullptr));
+        CHECK(out->view() == "    (01) expr set x 1\n    (02) expr eval x\n    (03) expr set x 2\n    (04) expr eval x\n    (05) expr set x 3\n    (06) expr set x 2\n");
+
+        // the session limit holds
+        for (uint32_t i = 0; i < 20; ++i) {
+            CHECK(parser.execute("expr set y " + std::to_string(i), out.get(), nullptr));
+        }
+        CHECK(parser.history_.size() == 8);
+        CHECK(parser.history_.first_number() == 20);
+        return true;
+    }
+
+    // lines holding sub before a number, most recent first, by checking each
+    void scan(const cmd_history_list_t& list, const std::string& sub, uint64_t before, size_t limit, std::vector<uint64_t>& out)
+    {
+        out.clear();
+        for (uint64_t num = std::min(before, list.next_number()); num-- > list.first_number() && out.size() < limit;) {
+            if (list[size_t(num - list.first_number())].find(sub) != std::string_view::npos) {
+                out.push_back(num);
+            }
+        }
+    }
+
+    bool search()
+    {
+        std::vector<uint64_t> found, expect;
+
+        // the index agrees with checking each line as lines come and go
+        {
+            cmd_history_list_t list(std::pmr::get_default_resource(), 3000, 1 << 20);
+            cmd_history_index_t index;
+            const std::vector<std::string> subs = { "expr", "set x1", "x12", "eval", "7", "x9 9", "zzz", "x1 1" };
+            for (uint32_t i = 0; i < 20000; ++i) {
+                list.push((i % 3 ? "expr set x" : "expr eval x") + std::to_string(i % 97) + " " + std::to_string(i));
+                if (i % 1000 != 999) {
+                    continue;
+                }
+                for (const std::string& sub : subs) {
+                    for (const uint64_t before : { list.next_number(), list.next_number() - 500, list.first_number() + 10 }) {
+                        index.search(list, sub, before, 25, found);
+                        scan(list, sub, before, 25, expect);
+                        CHECK(found == expect);
+                    }
+                }
+            }
+            // dropped lines are forgotten
+            CHECK(index.search(list, "x0 0", ~0ull, 10, found) == 0);
+            CHECK(index.search(list, "x", list.first_number(), 10, found) == 0);
+            CHECK(index.search(list, "expr", ~0ull, 0, found) == 0);
+        }
+
+        // reverse incremental search steps back from the last match
+        {
+            cmd_history_list_t list;
+            cmd_history_index_t index;
+            for (const char* line : { "alpha one", "beta", "alpha two", "gamma", "alpha three" }) {
+                list.push(line);
+            }
+            uint64_t before = ~0ull;
+            std::vector<std::string_view> steps;
+            while (index.search(list, "alpha", before, 1, found)) {
+                std::string_view line;
+                CHECK(list.find(found[0], line));
+                steps.push_back(line);
+                before = found[0];
+            }
+            CHECK((steps == std::vector<std::string_view>{ "alpha three", "alpha two", "alpha one" }));
+        }
+
+        // the command lists matches without its own line
+        {
+            cmd_parser_t parser;
+            parser.add_command<cmd_expr_t>();
+            parser.add_command<cmd_history_t>();
+            std::unique_ptr<cmd_output_buffer_t> out(cmd_output_t::create_output_buffer());
+            CHECK(parser.execute("expr set x 1", out.get(), nullptr));
+            CHECK(parser.execute("expr eval x", out.get(), nullptr));
+            CHECK(parser.execute("expr set y 2", out.get(), nullptr));
+            out->reset();
+            CHECK(parser.execute("history search set", out.get(), nullptr));
+            CHECK(out->view() == "    (03) expr set y 2\n    (01) expr set x 1\n");
+            out->reset();
+            CHECK(parser.execute("history search -n 1 -before 3 expr", out.get(), nullptr));
+            CHECK(out->view() == "    (02) expr eval x\n");
+            out->reset();
+            CHECK(parser.execute("history search set x", out.get(), nullptr));
+            CHECK(out->view() == "    (01) expr set x 1\n");
+            CHECK(!parser.execute("history search -n x set", out.get(), nullptr));
+        }
+        return true;
+    }
+
+    virtual bool run() override
+    {
+        CHECK(list());
+        CHECK(session());
+        CHECK(search());
+        return true;
+    }
+};
+} // namespace {}
+
+test_base_t* init_test_history()
+{
+    return new test_t();
+}
@@ -0,0 +1,94 @@
+#include "runner.h"
+
+namespace {
+
+struct test_t : public test_base_t {
+
+    test_t()
+        : test_base_t(__FILE__)
+    {
+    }
+
+    virtual bool run() override
+    {
+        cmd_idents_t idents;
+        CHECK(idents.empty() && idents.slot("a") == cmd_idents_t::npos);
+
+        // interning alone does not set a value
+        const uint32_t a = idents.intern("a");
+        uint64_t value = 0;
+        CHECK(!idents.get(a, value) && idents.size() == 0);
+
+        // slots remain stable while the table grows
+        for (uint32_t i = 0; i < 5000; ++i) {
+            idents.set("id" + std::to_string(i), i);
+        }
+        CHECK(idents.size() == 5000);
+        CHECK(idents.intern("a") == a);
+        CHECK(idents.get("id1234", value) && value == 1234);
+        idents.set(a, 7);
+        CHECK(idents.get("a", value) && value == 7);
+        CHECK(idents.name(a) == "a");
+
+        // erasing keeps the slot but unsets the value
+        CHECK(idents.erase("a") && !idents.erase("a"));
+        CHECK(!idents.get(a, value) && idents.slot("a") == a);
+        CHECK(idents.size() == 5000);
+
+        // ordered iteration on demand
+        std::vector<uint32_t> slots;
+        idents.sorted(slots);
+        CHECK(slots.size() == 5000);
+        for (size_t i = 1; i < slots.size(); ++i) {
+            CHECK(idents.name(slots[i - 1]) < idents.name(slots[i]));
+        }
+        CHECK(idents.name(slots.front()) == "id0");
+
+        // erased names are reclaimed once they outnumber the set ones
+        cmd_idents_t churn;
+        churn.set("kept", 1);
+        uint64_t epoch = churn.epoch();
+        for (uint32_t i = 0; i < 100000; ++i) {
+            const std::string name = "tmp" + std::to_string(i);
+            churn.set(name, i);
+            CHECK(churn.erase(name));
+        }
+        CHECK(churn.epoch() != epoch && churn.slots() <= 1026);
+        CHECK(churn.get("kept", value) && value == 1);
+        CHECK(churn.name(churn.slot("kept")) == "kept");
+
+        // but not while their erase is yet to be taken as a change
+        churn.compact();
+        CHECK(churn.slots() == 1);
+        churn.track_changes(true);
+        for (uint32_t i = 0; i < 2000; ++i) {
+            churn.set("t" + std::to_string(i), i);
+        }
+        std::vector<uint32_t> changed;
+        churn.changes(changed);
+        epoch = churn.epoch();
+        for (uint32_t i = 0; i < 2000; ++i) {
+            CHECK(churn.erase("t" + std::to_string(i)));
+        }
+        CHECK(churn.epoch() == epoch && churn.slots() == 2001);
+        churn.compact();
+        changed.clear();
+        churn.changes(changed);
+        CHECK(changed.size() == 2000 && churn.slots() == 2001);
+        CHECK(churn.name(changed.back()) == "t1999" && !churn.is_set(changed.back()));
+        churn.compact();
+        CHECK(churn.slots() == 1 && churn.get("kept", value) && value == 1);
+
+        // clearing invalidates every slot handed out
+        epoch = idents.epoch();
+        idents.clear();
+        CHECK(idents.epoch() != epoch && idents.slots() == 0);
+        return true;
+    }
+};
+} // namespace {}
+
+test_base_t* init_test_idents()
+{
+    return new test_t();
+}
@@ -0,0 +1,90 @@
+#include "runner.h"
+
+namespace {
+
+const char* names[] = {
+    "set", "setup", "select", "list", "lis", "settings", "remove", "set"
+};
+
+struct cmd_named_t : public cmd_t {
+    cmd_named_t(cmd_parser_t& cli, cmd_t* parent, cmd_baton_t user)
+        : cmd_t((const char*)user, cli, parent, user)
+    {
+    }
+};
+
+struct test_t : public test_base_t {
+
+    test_t()
+        : test_base_t(__FILE__)
+    {
+    }
+
+    // reference matcher using the linear str_match scan
+    void find_linear(const cmd_list_t& list, const char* sub, std::vector<cmd_t*>& vec)
+    {
+        int32_t score = 0;
+        for (auto& item : list) {
+            int32_t val = cmd_util_t::str_match(item->name_, sub);
+            if (val > score) {
+                vec.clear();
+                vec.push_back(item.get());
+                score = val;
+            } else if (val == score) {
+                vec.push_back(item.get());
+            }
+        }
+    }
+
+    virtual bool run() override
+    {
+        cmd_parser_t parser;
+        for (const char* name : names) {
+            parser.add_command<cmd_named_t>((cmd_baton_t)name);
+        }
+        const char* queries[] = {
+            "s", "se", "set", "setu", "setup", "setupx", "sel", "l", "li",
+            "lis", "list", "r", "x", "settings", "sett"
+        };
+        for (const char* query : queries) {
+            std::vector<cmd_t*> expect, found;
+            find_linear(parser.sub_, query, expect);
+            parser.index_.find(query, found);
+            CHECK(expect == found);
+        }
+        // the frozen tree must agree with the index
+        parser.sub_[0]->add_sub_command<cmd_named_t>((cmd_baton_t) "child");
+        parser.freeze();
+        const cmd_frozen_t* tree = parser.frozen();
+        CHECK(tree && tree->size() == 9);
+        for (const char* query : queries) {
+            std::vector<cmd_t*> expect, found;
+            parser.index_.find(query, expect);
+            std::vector<uint32_t> nodes;
+            tree->find(cmd_frozen_t::npos, query, nodes);
+            for (uint32_t node : nodes) {
+                found.push_back(tree->cmd(node));
+            }
+            CHECK(expect == found);
+        }
+        std::vector<uint32_t> nodes;
+        CHECK(tree->find(0, "ch", nodes) == 1 && tree->name(nodes[0]) == "child");
+        parser.alias_add(parser.sub_[0]->sub_[0].get(), "kid");
+        CHECK(tree->alias_find("kid") == nodes[0]);
+        CHECK(tree->alias_find("kidd") == cmd_frozen_t::npos);
+        // modifying the tree thaws the parser
+        parser.sub_[1]->add_sub_command<cmd_named_t>((cmd_baton_t) "child");
+        CHECK(parser.frozen() == nullptr);
+
+        CHECK(parser.index_.find_exact("lis") == parser.sub_[4].get());
+        CHECK(parser.index_.find_exact("set") == parser.sub_[0].get());
+        CHECK(parser.index_.find_exact("sel") == nullptr);
+        return true;
+    }
+};
+} // namespace {}
+
+test_base_t* init_test_index()
+{
+    return new test_t();
+}
@@ -0,0 +1,147 @@
+#include "runner.h"
+
+#include "../lib_cmd/cmd_expr.h"
+#include "../lib_cmd/cmd_jobs.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+namespace {
+
+// shared with the test commands through the user baton
+struct shared_t {
+    std::atomic<bool> release_;
+    std::atomic<uint32_t> started_;
+};
+
+// runs until killed or released through the user baton
+struct cmd_spin_t : public cmd_t {
+
+    cmd_spin_t(cmd_parser_t& cli, cmd_t* parent, cmd_baton_t user)
+        : cmd_t("spin", cli, parent, user)
+    {
+        parallel_ = true;
+    }
+
+    virtual bool on_execute(cmd_tokens_t& tok, cmd_output_t& out, cmd_baton_t user) override
+    {
+        (void)user;
+        shared_t& shared = *static_cast<shared_t*>(user_);
+        ++shared.started_;
+        const auto limit = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (!shared.release_) {
+            if (tok.cancelled()) {
+                out.println("cancelled");
+                return false;
+            }
+            if (std::chrono::steady_clock::now() > limit) {
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        out.println("released");
+        return true;
+    }
+};
+
+struct test_t : public test_base_t {
+
+    test_t()
+        : test_base_t(__FILE__)
+    {
+    }
+
+    virtual bool run() override
+    {
+        shared_t shared;
+        shared.release_ = false;
+        shared.started_ = 0;
+        std::atomic<bool>& release = shared.release_;
+        cmd_parser_t parser(&shared);
+        parser.add_command<cmd_spin_t>();
+        parser.add_command<cmd_expr_t>();
+        parser.add_command<cmd_jobs_t>();
+        parser.add_command<cmd_wait_t>();
+        parser.add_command<cmd_kill_t>();
+        parser.set_job_workers(2);
+        std::unique_ptr<cmd_output_buffer_t> out(cmd_output_t::create_output_buffer());
+
+        // the console stays usable while jobs run
+        CHECK(parser.execute("spin &", out.get(), nullptr));
+        CHECK(parser.execute("spin  & ", out.get(), nullptr));
+        CHECK(out->view() == "  [1] started\n  [2] started\n");
+        out->reset();
+        CHECK(parser.execute("expr eval 6 & 3", out.get(), nullptr));
+        CHECK(out->view().find("0x2") != std::string_view::npos);
+        out->reset();
+        CHECK(parser.execute("jobs", out.get(), nullptr));
+        CHECK(out->view() == "    [1] running spin\n    [2] running spin\n");
+
+        // a killed job sees the cancellation and its output is held for wait
+        while (shared.started_ < 2) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        out->reset();
+        CHECK(parser.execute("kill 1;wait 1", out.get(), nullptr));
+        CHECK(out->view() == "  cancelled\n    command failed: 'spin'\n");
+        out->reset();
+        release = true;
+        CHECK(parser.execute("wait", out.get(), nullptr));
+        CHECK(out->view() == "  released\n");
+        CHECK(parser.session_.jobs().list().empty());
+
+        // jobs that are never waited for are reported after the next line
+        release = false;
+        CHECK(parser.execute("spin &", out.get(), nullptr));
+        release = true;
+        while (!parser.session_.jobs().find(3)->done()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        out->reset();
+        CHECK(parser.execute("expr eval 1", out.get(), nullptr));
+        CHECK(out->view() == "      0x1\n  [3] done    spin\n  released\n");
+        CHECK(parser.session_.jobs().list().empty());
+
+        // unknown jobs and commands that are not parallel safe
+        out->reset();
+        CHECK(!parser.execute("wait 7", out.get(), nullptr));
+        CHECK(!parser.execute("kill 7", out.get(), nullptr));
+        CHECK(!parser.execute("expr set x 1 &", out.get(), nullptr));
+        CHECK(out->view().find("'expr set x 1' can not run in the background") != std::string_view::npos);
+        CHECK(parser.session_.jobs().list().empty());
+
+        // jobs wait for a free worker, and one killed while waiting never starts
+        parser.set_job_workers(1);
+        release = false;
+        shared.started_ = 0;
+        CHECK(parser.execute("spin &", out.get(), nullptr));
+        while (shared.started_ < 1) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        out->reset();
+        CHECK(parser.execute("spin &;kill 5;wait 5", out.get(), nullptr));
+        CHECK(out->view() == "  [5] started\n    command failed: 'spin'\n");
+        CHECK(shared.started_ == 1);
+        CHECK(!parser.session_.jobs().find(4)->done());
+        out->reset();
+        release = true;
+        CHECK(parser.execute("wait 4", out.get(), nullptr));
+        CHECK(out->view() == "  released\n");
+
+        // a session cancels its jobs when it goes away
+        release = false;
+        {
+            cmd_session_t session(parser);
+            CHECK(session.execute("spin &", out.get(), nullptr));
+            CHECK(session.jobs().list().size() == 1);
+        }
+        return true;
+    }
+};
+} // namespace {}
+
+test_base_t* init_test_jobs()
+{
+    return new test_t();
+}
@@ -0,0 +1,77 @@
+#include "runner.h"
+
+namespace {
+
+// reference dynamic programming edit distance
+uint32_t reference(const std::string& a, const std::string& b)
+{
+    std::vector<uint32_t> column(a.size() + 1);
+    for (uint32_t y = 0; y <= a.size(); ++y) {
+        column[y] = y;
+    }
+    for (uint32_t x = 1; x <= b.size(); ++x) {
+        uint32_t lastdiag = x - 1;
+        column[0] = x;
+        for (uint32_t y = 1; y <= a.size(); ++y) {
+            const uint32_t olddiag = column[y];
+            const uint32_t cost = lastdiag + (a[y - 1] == b[x - 1] ? 0 : 1);
+            column[y] = std::min(std::min(column[y] + 1, column[y - 1] + 1), cost);
+            lastdiag = olddiag;
+        }
+    }
+    return column[a.size()];
+}
+
+struct test_t : public test_base_t {
+
+    uint64_t seed_;
+
+    test_t()
+        : test_base_t(__FILE__)
+        , seed_(1)
+    {
+    }
+
+    uint32_t rand()
+    {
+        seed_ = seed_ * 6364136223846793005ull + 1442695040888963407ull;
+        return uint32_t(seed_ >> 33);
+    }
+
+    // random string over a small alphabet so that matches are common
+    std::string word(uint32_t len)
+    {
+        std::string out;
+        for (uint32_t i = 0; i < len; ++i) {
+            out.push_back(char('a' + rand() % 4));
+        }
+        return out;
+    }
+
+    virtual bool run() override
+    {
+        CHECK(cmd_util_t::levenshtein("", "") == 0);
+        CHECK(cmd_util_t::levenshtein("abc", "") == 3);
+        CHECK(cmd_util_t::levenshtein("kitten", "sitting") == 3);
+        CHECK(cmd_util_t::levenshtein("kitten", "sitting", 2) == 3);
+        CHECK(cmd_util_t::levenshtein("kitten", "sitting", 3) == 3);
+
+        // both the single word and multi word paths against the reference
+        for (uint32_t i = 0; i < 400; ++i) {
+            const std::string a = word(rand() % 150);
+            const std::string b = word(rand() % 150);
+            const uint32_t expect = reference(a, b);
+            CHECK(cmd_util_t::levenshtein(a.c_str(), b.c_str()) == expect);
+            const uint32_t max = rand() % 40;
+            const uint32_t bounded = cmd_util_t::levenshtein(a.c_str(), b.c_str(), max);
+            CHECK(bounded == (expect <= max ? expect : max + 1));
+        }
+        return true;
+    }
+};
+} // namespace {}
+
+test_base_t* init_test_levenshtein()
+{
+    return new test_t();
+}
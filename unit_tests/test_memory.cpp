@@ -0,0 +1,131 @@
+#include "runner.h"
+
+#include "../lib_cmd/cmd_expr.h"
+
+namespace {
+
+// forwards to new and delete while keeping count
+struct counting_resource_t : public std::pmr::memory_resource {
+
+    counting_resource_t()
+        : allocs_(0)
+        , live_(0)
+    {
+    }
+
+    uint64_t allocs_;
+    int64_t live_;
+
+protected:
+    virtual void* do_allocate(size_t bytes, size_t align) override
+    {
+        ++allocs_;
+        live_ += int64_t(bytes);
+        return std::pmr::new_delete_resource()->allocate(bytes, align);
+    }
+
+    virtual void do_deallocate(void* ptr, size_t bytes, size_t align) override
+    {
+        live_ -= int64_t(bytes);
+        std::pmr::new_delete_resource()->deallocate(ptr, bytes, align);
+    }
+
+    virtual bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+        return this == &other;
+    }
+};
+
+// executes a nested expression then prints its own arguments
+struct cmd_nest_t : public cmd_t {
+
+    cmd_nest_t(cmd_parser_t& cli, cmd_t* parent, cmd_baton_t user)
+        : cmd_t("nest", cli, parent, user)
+    {
+    }
+
+    virtual bool on_execute(cmd_tokens_t& tok, cmd_output_t& out, cmd_baton_t user) override
+    {
+        if (!tok.session().execute("expr set inner 1", &out, user)) {
+            return false;
+        }
+        for (const cmd_token_t& token : tok.tokens.tokens_) {
+            out.println("%s", token.c_str());
+        }
+        return true;
+    }
+};
+
+struct test_t : public test_base_t {
+
+    test_t()
+        : test_base_t(__FILE__)
+    {
+    }
+
+    virtual bool run() override
+    {
+        counting_resource_t upstream, fallback;
+        std::unique_ptr<cmd_output_buffer_t> out(cmd_output_t::create_output_buffer());
+        {
+            cmd_parser_t parser(nullptr, cmd_memory_t(&upstream, 1024));
+            parser.add_command<cmd_expr_t>();
+            parser.add_command<cmd_nest_t>();
+            // the arena is set aside up front
+            CHECK(upstream.live_ >= 1024);
+
+            // identifiers and history come from the session pool
+            std::pmr::memory_resource* prev = std::pmr::set_default_resource(&fallback);
+            const uint64_t before = upstream.allocs_;
+            for (uint32_t i = 0; i < 1000; ++i) {
+                CHECK(parser.execute("expr set ident" + std::to_string(i) + " " + std::to_string(i), out.get(), nullptr));
+            }
+            CHECK(upstream.allocs_ > before);
+            CHECK(parser.idents_.size() == 1000);
+            CHECK(parser.history_.size() == 1000);
+
+            // per command tokens never touch the default resource
+            CHECK(fallback.allocs_ == 0);
+            std::pmr::set_default_resource(prev);
+
+            // a command larger than the arena spills into the pool, which
+            // holds on to the memory once the arena is released
+            std::string wide = "expr eval 0";
+            for (uint32_t i = 0; i < 100; ++i) {
+                wide += " + $ident" + std::to_string(i);
+            }
+            CHECK(parser.execute(wide, out.get(), nullptr));
+            const uint64_t warm = upstream.allocs_;
+            parser.session_.set_history_limit(1);
+            for (uint32_t i = 0; i < 10; ++i) {
+                CHECK(parser.execute(wide, out.get(), nullptr));
+            }
+            CHECK(upstream.allocs_ == warm);
+
+            // the arena is only released once the outermost execute returns
+            out->reset();
+            CHECK(parser.execute("nest first second", out.get(), nullptr));
+            CHECK(out->view() == "  first\n  second\n");
+            uint64_t value = 0;
+            CHECK(parser.idents_.get("inner", value) && value == 1);
+
+            // other sessions draw on the same upstream
+            const int64_t live = upstream.live_;
+            {
+                cmd_session_t session(parser);
+                CHECK(session.execute("expr set y 2", out.get(), nullptr));
+                CHECK(upstream.live_ > live);
+            }
+            CHECK(upstream.live_ == live);
+        }
+        // everything is handed back when the parser goes away
+        CHECK(upstream.live_ == 0);
+        return true;
+    }
+};
+} // namespace {}
+
+test_base_t* init_test_memory()
+{
+    return new test_t();
+}
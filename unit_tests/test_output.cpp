@@ -0,0 +1,70 @@
+#include "runner.h"
+
+namespace {
+
+struct test_t : public test_base_t {
+
+    test_t()
+        : test_base_t(__FILE__)
+    {
+    }
+
+    // read back everything written to a file
+    std::string contents(FILE* fd)
+    {
+        std::string out;
+        rewind(fd);
+        char buffer[4096];
+        size_t len;
+        while ((len = fread(buffer, 1, sizeof(buffer), fd)) > 0) {
+            out.append(buffer, len);
+        }
+        return out;
+    }
+
+    virtual bool run() override
+    {
+        FILE* fd = tmpfile();
+        CHECK(fd);
+        std::string expect;
+        {
+            std::unique_ptr<cmd_output_t> out(cmd_output_t::create_output_stdio(fd));
+            out->println("hello %d", 1);
+            expect += "  hello 1\n";
+            {
+                auto indent = out->indent(4);
+                out->print("a");
+                out->print<false>("%s", "b");
+                out->eol();
+                expect += "      ab\n";
+            }
+            out->println<false>("%s", "flat");
+            expect += "flat\n";
+            // nothing reaches the file until a flush
+            CHECK(contents(fd).empty());
+            out->flush();
+            CHECK(contents(fd) == expect);
+
+            // a line larger than the buffer
+            const std::string big(200000, 'x');
+            out->println("%s", big.c_str());
+            expect += "  " + big + "\n";
+
+            // many lines spanning several buffer writes
+            for (uint32_t i = 0; i < 20000; ++i) {
+                out->println("line %u", i);
+                expect += "  line " + std::to_string(i) + "\n";
+            }
+        }
+        // destruction flushes the remainder
+        CHECK(contents(fd) == expect);
+        fclose(fd);
+        return true;
+    }
+};
+} // namespace {}
+
+test_base_t* init_test_output()
+{
+    return new test_t();
+}
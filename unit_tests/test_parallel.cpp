@@ -0,0 +1,173 @@
+#include "runner.h"
+
+#include "../lib_cmd/cmd_expr.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+namespace {
+
+// shared between the test commands through the user baton
+struct shared_t {
+    std::atomic<uint32_t> arrived_;
+    std::atomic<uint32_t> inside_;
+    std::atomic<uint32_t> overlap_;
+};
+
+// waits until a number of instances are running at once
+struct cmd_meet_t : public cmd_t {
+
+    cmd_meet_t(cmd_parser_t& cli, cmd_t* parent, cmd_baton_t user)
+        : cmd_t("meet", cli, parent, user)
+    {
+        parallel_ = true;
+    }
+
+    virtual bool on_execute(cmd_tokens_t& tok, cmd_output_t& out, cmd_baton_t user) override
+    {
+        (void)user;
+        shared_t& shared = *static_cast<shared_t*>(user_);
+        uint64_t count = 0;
+        cmd_token_t name;
+        if (!tok.tokens.get(count) || !tok.tokens.get(name)) {
+            return false;
+        }
+        ++shared.arrived_;
+        const auto limit = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (shared.arrived_ < count) {
+            if (std::chrono::steady_clock::now() > limit) {
+                return false;
+            }
+            std::this_thread::yield();
+        }
+        out.println("%s", name.c_str());
+        return true;
+    }
+};
+
+// sleeps then prints its name, so later commands finish first
+struct cmd_nap_t : public cmd_t {
+
+    cmd_nap_t(cmd_parser_t& cli, cmd_t* parent, cmd_baton_t user)
+        : cmd_t("nap", cli, parent, user)
+    {
+        parallel_ = true;
+    }
+
+    virtual bool on_execute(cmd_tokens_t& tok, cmd_output_t& out, cmd_baton_t user) override
+    {
+        (void)user;
+        uint64_t ms = 0;
+        cmd_token_t name;
+        if (!tok.tokens.get(ms) || !tok.tokens.get(name)) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+        out.println("%s", name.c_str());
+        return true;
+    }
+};
+
+// not parallel safe, notes if it ever overlaps another instance
+struct cmd_serial_t : public cmd_t {
+
+    cmd_serial_t(cmd_parser_t& cli, cmd_t* parent, cmd_baton_t user)
+        : cmd_t("serial", cli, parent, user)
+    {
+    }
+
+    virtual bool on_execute(cmd_tokens_t& tok, cmd_output_t& out, cmd_baton_t user) override
+    {
+        (void)tok, (void)user;
+        shared_t& shared = *static_cast<shared_t*>(user_);
+        if (shared.inside_++ != 0) {
+            ++shared.overlap_;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        --shared.inside_;
+        out.println("serial");
+        return true;
+    }
+};
+
+struct test_t : public test_base_t {
+
+    test_t()
+        : test_base_t(__FILE__)
+    {
+    }
+
+    virtual bool run() override
+    {
+        shared_t shared;
+        shared.arrived_ = 0;
+        shared.inside_ = 0;
+        shared.overlap_ = 0;
+        cmd_parser_t parser(&shared);
+        parser.add_command<cmd_meet_t>();
+        parser.add_command<cmd_nap_t>();
+        parser.add_command<cmd_serial_t>();
+        parser.add_command<cmd_expr_t>();
+        parser.set_workers(2);
+        std::unique_ptr<cmd_output_buffer_t> out(cmd_output_t::create_output_buffer());
+
+        // both halves must be running at the same time to complete
+        CHECK(parser.execute("meet 2 a && meet 2 b", out.get(), nullptr));
+        CHECK(out->view() == "  a\n  b\n");
+
+        // output keeps the order given even when later commands finish first
+        for (uint32_t i = 0; i < 4; ++i) {
+            out->reset();
+            CHECK(parser.execute("nap 20 x && nap 0 y && nap 5 z", out.get(), nullptr));
+            CHECK(out->view() == "  x\n  y\n  z\n");
+        }
+
+        // commands that are not parallel safe never overlap
+        out->reset();
+        CHECK(parser.execute("serial && serial && nap 1 n && serial", out.get(), nullptr));
+        CHECK(shared.overlap_ == 0);
+        CHECK(out->view() == "  serial\n  serial\n  n\n  serial\n");
+
+        // ';' stays sequential around groups and each command joins the history
+        out->reset();
+        const size_t history = parser.history_.size();
+        CHECK(parser.execute("expr set x 3;nap 0 p && expr eval x;nap 0 q", out.get(), nullptr));
+        CHECK(out->view() == "  p\n      x = 0x3\n  q\n");
+        CHECK(parser.history_.size() == history + 4);
+
+        // later commands see identifiers set by a command before them
+        out->reset();
+        CHECK(parser.execute("expr set x 5 && nap 0 $x && expr set y 2 && nap 0 $y", out.get(), nullptr));
+        CHECK(out->view() == "  5\n  2\n");
+
+        // failures are reported in order and stop the rest of the group and
+        // the following expressions
+        out->reset();
+        CHECK(!parser.execute("nap 0 a && bogus && nap 0 b;nap 0 c", out.get(), nullptr));
+        std::string_view text = out->view();
+        CHECK(text.find("  a\n") < text.find("invalid command"));
+        CHECK(text.find("invalid command") < text.find("command failed: ' bogus '"));
+        CHECK(text.find("  b\n") == std::string_view::npos);
+        CHECK(text.find("  c\n") == std::string_view::npos);
+
+        out->reset();
+        CHECK(!parser.execute("nap x a && nap 0 b && serial", out.get(), nullptr));
+        text = out->view();
+        CHECK(text.find("command failed: 'nap x a '") != std::string_view::npos);
+        CHECK(text.find("  b\n") != std::string_view::npos);
+        CHECK(text.find("serial") == std::string_view::npos);
+
+        // a single '&' is still the expression and operator
+        out->reset();
+        CHECK(parser.execute("expr eval 6 & 3", out.get(), nullptr));
+        CHECK(out->view().find("0x2") != std::string_view::npos);
+        return true;
+    }
+};
+} // namespace {}
+
+test_base_t* init_test_parallel()
+{
+    return new test_t();
+}
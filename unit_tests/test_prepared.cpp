@@ -0,0 +1,150 @@
+#include "runner.h"
+
+namespace {
+
+struct cmd_store_t : public cmd_t {
+
+    static uint64_t value;
+    static std::string name;
+    static uint32_t calls;
+    static cmd_session_t* session;
+
+    cmd_store_t(cmd_parser_t& cli, cmd_t* parent, cmd_baton_t user)
+        : cmd_t("store", cli, parent, user)
+    {
+    }
+
+    virtual bool on_execute(cmd_tokens_t& tok, cmd_output_t& out, cmd_baton_t user) override
+    {
+        (void)out, (void)user;
+        ++calls;
+        session = &tok.session();
+        if (!tok.tokens.get(name)) {
+            return false;
+        }
+        return tok.tokens.get(value);
+    }
+};
+
+uint64_t cmd_store_t::value;
+std::string cmd_store_t::name;
+uint32_t cmd_store_t::calls;
+cmd_session_t* cmd_store_t::session;
+
+struct cmd_root_t : public cmd_t {
+    cmd_root_t(cmd_parser_t& cli, cmd_t* parent, cmd_baton_t user)
+        : cmd_t("root", cli, parent, user)
+    {
+        add_sub_command<cmd_store_t>();
+    }
+};
+
+struct cmd_other_t : public cmd_t {
+    cmd_other_t(cmd_parser_t& cli, cmd_t* parent, cmd_baton_t user)
+        : cmd_t("other", cli, parent, user)
+    {
+    }
+};
+
+struct test_t : public test_base_t {
+
+    test_t()
+        : test_base_t(__FILE__)
+    {
+    }
+
+    virtual bool run() override
+    {
+        cmd_parser_t parser;
+        parser.add_command<cmd_root_t>();
+        std::unique_ptr<cmd_output_t> out(cmd_output_t::create_output_dummy());
+
+        CHECK(parser.prepare("missing ?") == nullptr);
+
+        auto stmt = parser.prepare("ro st counter ?");
+        CHECK(stmt && stmt->size() == 1);
+
+        // unbound placeholders fail
+        CHECK(!stmt->execute(out.get(), nullptr));
+
+        for (uint64_t i = 0; i < 10; ++i) {
+            CHECK(stmt->bind(0, i * 3));
+            CHECK(stmt->execute(out.get(), nullptr));
+            CHECK(cmd_store_t::name == "counter" && cmd_store_t::value == i * 3);
+        }
+        CHECK(!stmt->bind(1, 0));
+
+        // identifiers are substituted at execution time
+        auto ident = parser.prepare("root store ident $x");
+        CHECK(ident && ident->size() == 0);
+        parser.idents_["x"] = 77;
+        CHECK(ident->execute(out.get(), nullptr) && cmd_store_t::value == 77);
+
+        // and found again once the identifiers are cleared
+        parser.idents_.clear();
+        parser.idents_["y"] = 1;
+        parser.idents_["x"] = 78;
+        CHECK(ident->execute(out.get(), nullptr) && cmd_store_t::value == 78);
+
+        // names that are only read are not given a slot
+        auto read = parser.prepare("root store read $z");
+        CHECK(read && !read->execute(out.get(), nullptr));
+        CHECK(parser.idents_.slot("z") == cmd_idents_t::npos);
+        parser.idents_["z"] = 5;
+        CHECK(read->execute(out.get(), nullptr) && cmd_store_t::value == 5);
+
+        // statements run in any session, with its identifiers
+        {
+            cmd_session_t session(parser);
+            session.idents_["x"] = 99;
+            CHECK(ident->execute(session, out.get(), nullptr) && cmd_store_t::value == 99);
+            CHECK(cmd_store_t::session == &session);
+            CHECK(parser.idents_.slot("x") != cmd_idents_t::npos);
+        }
+        CHECK(ident->execute(out.get(), nullptr) && cmd_store_t::value == 78);
+        CHECK(cmd_store_t::session == &parser.session_);
+
+        // tree changes mark statements as stale but they still resolve
+        parser.add_command<cmd_other_t>();
+        CHECK(!stmt->valid());
+        CHECK(stmt->bind(0, "0x10"));
+        CHECK(stmt->execute(out.get(), nullptr) && cmd_store_t::value == 16);
+        CHECK(stmt->valid());
+
+        // removing an alias invalidates statements that used it
+        parser.alias_add(parser.sub_[0]->sub_[0].get(), "st");
+        auto alias = parser.prepare("st name ?");
+        CHECK(alias && alias->bind(0, 5));
+        CHECK(alias->execute(out.get(), nullptr) && cmd_store_t::value == 5);
+        parser.alias_remove("st");
+        CHECK(!alias->valid());
+        const uint32_t calls = cmd_store_t::calls;
+        CHECK(!alias->execute(out.get(), nullptr));
+        CHECK(cmd_store_t::calls == calls);
+
+        // frozen trees resolve the same way
+        parser.freeze();
+        auto frozen = parser.prepare("root store frozen ?");
+        CHECK(frozen && frozen->bind(0, 9));
+        CHECK(frozen->execute(out.get(), nullptr) && cmd_store_t::name == "frozen");
+
+        // prepared runs are invoked like executed ones
+        cmd_t* store = parser.sub_[0]->sub_[0].get();
+#if CMD_STATS
+        const uint64_t recorded = store->metrics_.calls();
+        CHECK(frozen->execute(out.get(), nullptr));
+        CHECK(store->metrics_.calls() == recorded + 1);
+#endif
+        const uint32_t before = cmd_store_t::calls;
+        CHECK(frozen->bind(0, "?") && frozen->execute(out.get(), nullptr));
+        CHECK(cmd_store_t::calls == before);
+        (void)store;
+        return true;
+    }
+};
+} // namespace {}
+
+test_base_t* init_test_prepared()
+{
+    return new test_t();
+}
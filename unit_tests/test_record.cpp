@@ -0,0 +1,116 @@
+#include "runner.h"
+
+#include "../lib_cmd/cmd_expr.h"
+
+namespace {
+
+struct test_t : public test_base_t {
+
+    test_t()
+        : test_base_t(__FILE__)
+    {
+    }
+
+    // minimal reader for the binary encoding
+    struct reader_t {
+        const uint8_t* ptr_;
+        const uint8_t* end_;
+
+        uint64_t varint()
+        {
+            uint64_t out = 0;
+            for (uint32_t shift = 0; ptr_ < end_; shift += 7) {
+                const uint8_t byte = *ptr_++;
+                out |= uint64_t(byte & 0x7f) << shift;
+                if ((byte & 0x80) == 0) {
+                    break;
+                }
+            }
+            return out;
+        }
+
+        std::string str()
+        {
+            const size_t len = size_t(varint());
+            std::string out((const char*)ptr_, len);
+            ptr_ += len;
+            return out;
+        }
+    };
+
+    bool test_jsonl()
+    {
+        std::unique_ptr<cmd_output_buffer_t> out(cmd_output_t::create_output_buffer());
+        out->set_record_format(cmd_output_t::e_jsonl);
+        CHECK(out->structured());
+        {
+            cmd_record_t rec(*out, "test");
+            rec.field("u", 42u).field("i", -7).field("s", "a\"b\\c\n");
+            rec.list("l").item(1).item(std::string_view("x")).list_end();
+            rec.field("z", uint64_t(~0ull));
+        }
+        CHECK(out->view() == "{\"type\":\"test\",\"u\":42,\"i\":-7,\"s\":\"a\\\"b\\\\c\\n\","
+                             "\"l\":[1,\"x\"],\"z\":18446744073709551615}\n");
+        out->reset();
+        // text written to a structured output becomes a record
+        out->println("%d items", 3);
+        CHECK(out->view() == "{\"type\":\"text\",\"text\":\"3 items\"}\n");
+        return true;
+    }
+
+    bool test_binary()
+    {
+        std::unique_ptr<cmd_output_buffer_t> out(cmd_output_t::create_output_buffer());
+        out->set_record_format(cmd_output_t::e_binary);
+        {
+            cmd_record_t rec(*out, "bin");
+            rec.field("u", 300u).field("i", -2).field("s", "hi");
+            rec.list("l").item(5u).list_end();
+        }
+        const std::string_view data = out->view();
+        CHECK(data.size() > 4);
+        const uint8_t* ptr = (const uint8_t*)data.data();
+        const uint32_t size = ptr[0] | (ptr[1] << 8) | (ptr[2] << 16) | (uint32_t(ptr[3]) << 24);
+        CHECK(size + 4 == data.size());
+        reader_t rd{ ptr + 4, ptr + data.size() };
+        CHECK(rd.str() == "bin");
+        CHECK(*rd.ptr_++ == cmd_record_t::e_tag_uint && rd.str() == "u" && rd.varint() == 300);
+        // zigzag encoding of -2
+        CHECK(*rd.ptr_++ == cmd_record_t::e_tag_int && rd.str() == "i" && rd.varint() == 3);
+        CHECK(*rd.ptr_++ == cmd_record_t::e_tag_str && rd.str() == "s" && rd.str() == "hi");
+        CHECK(*rd.ptr_++ == cmd_record_t::e_tag_list && rd.str() == "l");
+        CHECK(*rd.ptr_++ == cmd_record_t::e_tag_uint && rd.varint() == 5);
+        CHECK(*rd.ptr_++ == cmd_record_t::e_tag_list_end);
+        CHECK(rd.ptr_ == rd.end_);
+        return true;
+    }
+
+    bool test_builtin()
+    {
+        cmd_parser_t parser;
+        parser.add_command<cmd_expr_t>();
+        std::unique_ptr<cmd_output_buffer_t> out(cmd_output_t::create_output_buffer());
+        out->set_record_format(cmd_output_t::e_jsonl);
+        CHECK(parser.execute("expr set b 2", out.get(), nullptr));
+        CHECK(parser.execute("expr set a 1", out.get(), nullptr));
+        out->reset();
+        CHECK(parser.execute("expr list", out.get(), nullptr));
+        CHECK(out->view() == "{\"type\":\"ident\",\"name\":\"b\",\"value\":2}\n"
+                             "{\"type\":\"ident\",\"name\":\"a\",\"value\":1}\n");
+        out->reset();
+        CHECK(parser.execute("expr eval a+b", out.get(), nullptr));
+        CHECK(out->view() == "{\"type\":\"value\",\"value\":3}\n");
+        return true;
+    }
+
+    virtual bool run() override
+    {
+        return test_jsonl() && test_binary() && test_builtin();
+    }
+};
+} // namespace {}
+
+test_base_t* init_test_record()
+{
+    return new test_t();
+}
@@ -0,0 +1,149 @@
+#include "runner.h"
+
+#if defined(__linux__)
+
+#include "../lib_cmd/cmd_expr.h"
+#include "../lib_cmd/cmd_server.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+struct test_t : public test_base_t {
+
+    test_t()
+        : test_base_t(__FILE__)
+    {
+    }
+
+    int connect_unix(const std::string& path)
+    {
+        const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        memcpy(addr.sun_path, path.data(), path.size());
+        if (fd >= 0 && connect(fd, (const sockaddr*)&addr, sizeof(addr)) != 0) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    int connect_tcp(uint16_t port)
+    {
+        const int fd = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (fd >= 0 && connect(fd, (const sockaddr*)&addr, sizeof(addr)) != 0) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    bool send_all(int fd, const std::string& data)
+    {
+        return write(fd, data.data(), data.size()) == ssize_t(data.size());
+    }
+
+    // read until a number of prompts have been received
+    std::string receive(int fd, uint32_t prompts)
+    {
+        std::string out;
+        char temp[1024];
+        while (prompts) {
+            const ssize_t got = read(fd, temp, sizeof(temp));
+            if (got <= 0) {
+                break;
+            }
+            for (ssize_t i = 0; i < got; ++i) {
+                prompts -= (temp[i] == '#') ? 1 : 0;
+            }
+            out.append(temp, size_t(got));
+        }
+        return out;
+    }
+
+    virtual bool run() override
+    {
+        cmd_parser_t parser;
+        parser.add_command<cmd_expr_t>();
+        parser.freeze();
+        cmd_server_t server(parser);
+        server.set_prompt("#");
+        const std::string path = "/tmp/cmd_test_" + std::to_string(getpid()) + ".sock";
+        CHECK(server.listen_unix(path));
+        CHECK(server.start(2));
+
+        const int a = connect_unix(path);
+        const int b = connect_unix(path);
+        CHECK(a >= 0 && b >= 0);
+        CHECK(receive(a, 1) == "#");
+        CHECK(receive(b, 1) == "#");
+
+        // a line split over several writes is only executed once complete
+        CHECK(send_all(a, "expr se"));
+        CHECK(send_all(a, "t x 5"));
+        CHECK(send_all(a, "\r\n"));
+        CHECK(receive(a, 1) == "#");
+
+        // pipelined lines in a single write, each session has its own idents
+        CHECK(send_all(a, "expr eval x\nexpr eval x + 1\n"));
+        CHECK(receive(a, 2) == "      x = 0x5\n#      0x6\n#");
+        CHECK(send_all(b, "expr eval x\n"));
+        const std::string unknown = receive(b, 1);
+        CHECK(unknown.find("0x5") == std::string::npos);
+        CHECK(server.sessions() == 2);
+
+        // over tcp, queue far more output than the pending limit allows
+        cmd_server_t tcp(parser);
+        tcp.set_prompt("#");
+        tcp.set_limits(64, 256);
+        CHECK(tcp.listen_tcp(0) && tcp.port() != 0);
+        CHECK(tcp.start(1));
+        const int c = connect_tcp(tcp.port());
+        CHECK(c >= 0);
+        const uint32_t lines = 2000;
+        std::string batch;
+        for (uint32_t i = 0; i < lines; ++i) {
+            batch.append("expr eval 1\n");
+        }
+        CHECK(send_all(c, batch));
+        const std::string result = receive(c, lines + 1);
+        size_t found = 0;
+        for (size_t at = result.find("0x1"); at != std::string::npos; at = result.find("0x1", at + 1)) {
+            ++found;
+        }
+        CHECK(found == lines);
+
+        // a line over the limit disconnects the client
+        CHECK(send_all(c, std::string(100, 'x')));
+        char temp[16];
+        CHECK(read(c, temp, sizeof(temp)) == 0);
+
+        close(a);
+        close(b);
+        close(c);
+        server.stop();
+        CHECK(server.sessions() == 0);
+        CHECK(access(path.c_str(), F_OK) != 0);
+        tcp.stop();
+        return true;
+    }
+};
+} // namespace {}
+
+test_base_t* init_test_server()
+{
+    return new test_t();
+}
+
+#endif // defined(__linux__)
@@ -0,0 +1,99 @@
+#include "runner.h"
+
+#include "../lib_cmd/cmd_alias.h"
+#include "../lib_cmd/cmd_expr.h"
+#include "../lib_cmd/cmd_history.h"
+
+#include <atomic>
+#include <thread>
+
+namespace {
+
+struct test_t : public test_base_t {
+
+    test_t()
+        : test_base_t(__FILE__)
+    {
+    }
+
+    // sessions do not see each others identifiers or history
+    bool isolated(cmd_parser_t& parser)
+    {
+        std::unique_ptr<cmd_output_buffer_t> out(cmd_output_t::create_output_buffer());
+        cmd_session_t a(parser), b(parser);
+        CHECK(a.execute("expr set x 1", out.get(), nullptr));
+        CHECK(b.execute("expr set x 2;expr set y 3", out.get(), nullptr));
+        uint64_t value = 0;
+        CHECK(a.idents_.get("x", value) && value == 1);
+        CHECK(b.idents_.get("x", value) && value == 2);
+        CHECK(!a.idents_.get("y", value));
+        CHECK(!parser.idents_.get("x", value));
+        CHECK(b.history_.size() == a.history_.size() + 1);
+        CHECK(a.history_.back() == "expr set x 1" && b.history_.back() == "expr set y 3");
+        // the same expression compiles against each sessions identifiers
+        out->reset();
+        CHECK(a.execute("expr eval y = x + 1", out.get(), nullptr));
+        CHECK(b.execute("expr eval y", out.get(), nullptr));
+        CHECK(a.idents_.get("y", value) && value == 2);
+        CHECK(b.idents_.get("y", value) && value == 3);
+        return true;
+    }
+
+    // many sessions executing against one tree while aliases change
+    bool concurrent(cmd_parser_t& parser)
+    {
+        const uint32_t threads = 4, count = 2000;
+        std::atomic<uint32_t> failed(0);
+        std::atomic<bool> done(false);
+        std::vector<std::thread> workers;
+        for (uint32_t t = 0; t < threads; ++t) {
+            workers.emplace_back([&, t]() {
+                std::unique_ptr<cmd_output_buffer_t> out(cmd_output_t::create_output_buffer());
+                cmd_session_t session(parser);
+                const std::string set = "expr set x " + std::to_string(t);
+                for (uint32_t i = 0; i < count; ++i) {
+                    out->reset();
+                    bool ok = session.execute(set, out.get(), nullptr);
+                    ok &= session.execute("expr eval x + 1", out.get(), nullptr);
+                    ok &= out->view().find("0x" + std::to_string(t + 1)) != std::string_view::npos;
+                    ok &= session.history_.back() == "expr eval x + 1";
+                    failed += ok ? 0 : 1;
+                }
+            });
+        }
+        std::thread aliases([&]() {
+            std::unique_ptr<cmd_output_t> out(cmd_output_t::create_output_dummy());
+            cmd_session_t session(parser);
+            while (!done) {
+                session.execute("alias add e expr eval", out.get(), nullptr);
+                session.execute("alias remove e", out.get(), nullptr);
+            }
+        });
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        done = true;
+        aliases.join();
+        CHECK(failed == 0);
+        return true;
+    }
+
+    virtual bool run() override
+    {
+        cmd_parser_t parser;
+        parser.add_command<cmd_expr_t>();
+        parser.add_command<cmd_history_t>();
+        parser.add_command<cmd_alias_t>();
+        CHECK(isolated(parser));
+        CHECK(concurrent(parser));
+        parser.freeze();
+        CHECK(concurrent(parser));
+        return true;
+    }
+};
+} // namespace {}
+
+test_base_t* init_test_session()
+{
+    return new test_t();
+}
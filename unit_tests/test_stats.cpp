@@ -0,0 +1,115 @@
+#include "runner.h"
+
+namespace {
+
+struct cmd_pass_t : public cmd_t {
+    cmd_pass_t(cmd_parser_t& cli, cmd_t* parent, cmd_baton_t user)
+        : cmd_t("pass", cli, parent, user)
+    {
+    }
+
+    virtual bool on_execute(cmd_tokens_t& tok, cmd_output_t& out, cmd_baton_t user) override
+    {
+        (void)tok, (void)out, (void)user;
+        return true;
+    }
+};
+
+struct cmd_fail_t : public cmd_t {
+    cmd_fail_t(cmd_parser_t& cli, cmd_t* parent, cmd_baton_t user)
+        : cmd_t("fail", cli, parent, user)
+    {
+    }
+
+    virtual bool on_execute(cmd_tokens_t& tok, cmd_output_t& out, cmd_baton_t user) override
+    {
+        (void)tok, (void)out, (void)user;
+        return false;
+    }
+};
+
+struct cmd_root_t : public cmd_t {
+    cmd_root_t(cmd_parser_t& cli, cmd_t* parent, cmd_baton_t user)
+        : cmd_t("root", cli, parent, user)
+    {
+        add_sub_command<cmd_pass_t>();
+        add_sub_command<cmd_fail_t>();
+    }
+};
+
+struct test_t : public test_base_t {
+
+    test_t()
+        : test_base_t(__FILE__)
+    {
+    }
+
+    bool test_histogram()
+    {
+        CHECK(cmd_histogram_t::bucket(0) == 0);
+        CHECK(cmd_histogram_t::bucket(1) == 0);
+        CHECK(cmd_histogram_t::bucket(2) == 1);
+        CHECK(cmd_histogram_t::bucket(3) == 1);
+        CHECK(cmd_histogram_t::bucket(1024) == 10);
+        CHECK(cmd_histogram_t::bucket(~0ull) == cmd_histogram_t::buckets - 1);
+
+        cmd_histogram_t hist;
+        CHECK(hist.percentile(0.99) == 0);
+        for (uint32_t i = 0; i < 99; ++i) {
+            hist.add(100);
+        }
+        hist.add(5000);
+        CHECK(hist.count() == 100);
+        CHECK(hist.total() == 99 * 100 + 5000);
+        // 100ns lands in [64, 128) and 5000ns in [4096, 8192)
+        CHECK(hist.percentile(0.5) == 128);
+        CHECK(hist.percentile(0.99) == 128);
+        CHECK(hist.percentile(1.0) == 8192);
+        hist.clear();
+        CHECK(hist.count() == 0 && hist.total() == 0);
+        return true;
+    }
+
+    virtual bool run() override
+    {
+        if (!test_histogram()) {
+            return false;
+        }
+        cmd_parser_t parser;
+        parser.add_command<cmd_root_t>();
+        std::unique_ptr<cmd_output_t> out(cmd_output_t::create_output_dummy());
+
+        std::vector<const cmd_t*> list;
+        CHECK(parser.stats_collect(list) == 0);
+#if CMD_STATS
+        for (uint32_t i = 0; i < 3; ++i) {
+            CHECK(parser.execute("root pass", out.get(), nullptr));
+        }
+        CHECK(!parser.execute("root fail", out.get(), nullptr));
+        CHECK(!parser.execute("nothing", out.get(), nullptr));
+
+        CHECK(parser.stats_collect(list) == 2);
+        const cmd_metrics_t& pass = list[0]->metrics_;
+        const cmd_metrics_t& fail = list[1]->metrics_;
+        CHECK(strcmp(list[0]->name_, "pass") == 0);
+        CHECK(pass.calls() == 3 && pass.fails() == 0);
+        CHECK(fail.calls() == 1 && fail.fails() == 1);
+        CHECK(pass.latency().count() == 3);
+        CHECK(pass.phase(cmd_metrics_t::e_dispatch).count() == 3);
+        CHECK(pass.total() >= pass.phase(cmd_metrics_t::e_execute).total());
+        CHECK(parser.unmatched_.calls() == 1);
+
+        parser.stats_clear();
+        list.clear();
+        CHECK(parser.stats_collect(list) == 0);
+        CHECK(parser.unmatched_.calls() == 0);
+#endif
+        return true;
+    }
+};
+} // namespace {}
+
+test_base_t* init_test_stats()
+{
+    return new test_t();
+}
@@ -0,0 +1,258 @@
+#include "runner.h"
+
+#if defined(__linux__)
+
+#include "../lib_cmd/cmd_alias.h"
+#include "../lib_cmd/cmd_expr.h"
+#include "../lib_cmd/cmd_store.h"
+
+#include <csignal>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+// a parser with the commands whose state is kept
+struct app_t {
+
+    app_t()
+        : out_(cmd_output_t::create_output_buffer())
+        , store_(parser_.session_)
+    {
+        parser_.add_command<cmd_expr_t>();
+        parser_.add_command<cmd_alias_t>();
+    }
+
+    bool execute(const std::string& expr)
+    {
+        out_->reset();
+        return parser_.execute(expr, out_.get(), nullptr) && store_.sync();
+    }
+
+    uint64_t value(const char* name)
+    {
+        uint64_t value = ~0ull;
+        parser_.idents_.get(name, value);
+        return value;
+    }
+
+    cmd_parser_t parser_;
+    std::unique_ptr<cmd_output_buffer_t> out_;
+    cmd_store_t store_;
+};
+
+uint64_t file_size(const std::string& path)
+{
+    struct stat info;
+    return stat(path.c_str(), &info) == 0 ? uint64_t(info.st_size) : 0;
+}
+
+struct test_t : public test_base_t {
+
+    test_t()
+        : test_base_t(__FILE__)
+    {
+    }
+
+    virtual bool run() override
+    {
+        const std::string path = "/tmp/cmd_test_" + std::to_string(getpid()) + ".store";
+        unlink(path.c_str());
+
+        // changes are appended as they are synced
+        {
+            app_t app;
+            CHECK(app.store_.open(path.c_str()));
+            CHECK(app.store_.journal_size() == 0);
+            CHECK(app.execute("expr set a 1"));
+            CHECK(app.execute("expr set b 2;expr set c 3;expr remove c"));
+            CHECK(app.execute("alias add e expr eval"));
+            const uint64_t journal = app.store_.journal_size();
+            CHECK(journal > 0);
+            CHECK(app.store_.sync());
+            CHECK(app.store_.journal_size() == journal);
+            // not synced so not kept
+            app.parser_.idents_.set("d", 4);
+        }
+
+        // and read back on open
+        {
+            app_t app;
+            CHECK(app.store_.open(path.c_str()));
+            CHECK(app.value("a") == 1 && app.value("b") == 2);
+            CHECK(app.value("c") == ~0ull && app.value("d") == ~0ull);
+            CHECK(app.parser_.history_.size() == 5);
+            CHECK(app.parser_.last_cmd() == "alias add e expr eval");
+            CHECK(app.execute("e a + b"));
+            CHECK(app.out_->view().find("0x3") != std::string_view::npos);
+
+            // a snapshot replaces the journal
+            CHECK(app.execute("expr set a 10"));
+            CHECK(app.store_.compact());
+            CHECK(app.store_.journal_size() == 0);
+            CHECK(app.execute("expr set b 20"));
+            CHECK(app.execute("alias remove e"));
+        }
+        {
+            app_t app;
+            CHECK(app.store_.open(path.c_str()));
+            CHECK(app.value("a") == 10 && app.value("b") == 20);
+            CHECK(app.parser_.alias_.count("e") == 0);
+            CHECK(app.parser_.last_cmd() == "alias remove e");
+        }
+
+        // a record torn by a crash is dropped
+        const uint64_t good = file_size(path);
+        {
+            const int fd = open(path.c_str(), O_WRONLY | O_APPEND);
+            CHECK(fd >= 0);
+            const char torn[] = { 2, 0, 0, 0, 40, 0, 0, 0, 1, 2, 3, 4, 'x' };
+            CHECK(write(fd, torn, sizeof(torn)) == ssize_t(sizeof(torn)));
+            close(fd);
+        }
+        {
+            app_t app;
+            CHECK(app.store_.open(path.c_str()));
+            CHECK(file_size(path) == good);
+            CHECK(app.value("b") == 20);
+            CHECK(app.execute("expr set f 6"));
+        }
+        {
+            app_t app;
+            CHECK(app.store_.open(path.c_str()));
+            CHECK(app.value("f") == 6);
+
+            // many identifiers survive a snapshot
+            for (uint32_t i = 0; i < 100000; ++i) {
+                app.parser_.idents_.set("ident" + std::to_string(i), i);
+            }
+            CHECK(app.store_.compact());
+        }
+        {
+            app_t app;
+            CHECK(app.store_.open(path.c_str()));
+            CHECK(app.parser_.idents_.size() == 100003);
+            bool same = true;
+            for (uint32_t i = 0; i < 100000; ++i) {
+                uint64_t value = 0;
+                same &= app.parser_.idents_.get("ident" + std::to_string(i), value) && value == i;
+            }
+            CHECK(same);
+            // new identifiers still hash into the loaded table
+            CHECK(app.execute("expr set g 7"));
+            CHECK(app.value("g") == 7 && app.value("ident99999") == 99999);
+        }
+        unlink(path.c_str());
+
+        // slots cached before a smaller store is opened are not used after
+        {
+            app_t small;
+            CHECK(small.store_.open(path.c_str()));
+            CHECK(small.execute("expr set s 1"));
+        }
+        {
+            app_t app;
+            for (uint32_t i = 0; i < 64; ++i) {
+                app.parser_.idents_.set("v" + std::to_string(i), i);
+            }
+            CHECK(app.parser_.execute("expr eval v63 = 63", app.out_.get(), nullptr));
+            CHECK(app.store_.open(path.c_str()));
+            CHECK(app.parser_.idents_.slots() == 1);
+            CHECK(app.execute("expr eval v63 = 63"));
+            CHECK(app.value("v63") == 63 && app.value("s") == 1);
+        }
+        unlink(path.c_str());
+
+        // erased identifiers are left out of a snapshot
+        {
+            app_t app;
+            CHECK(app.store_.open(path.c_str()));
+            CHECK(app.execute("expr set a 1;expr set b 2;expr remove a"));
+            CHECK(app.store_.compact());
+        }
+        {
+            app_t app;
+            CHECK(app.store_.open(path.c_str()));
+            CHECK(app.parser_.idents_.slots() == 1 && app.value("b") == 2);
+        }
+        unlink(path.c_str());
+
+        // a snapshot whose tables do not hold together is refused
+        {
+            app_t app;
+            CHECK(app.store_.open(path.c_str()));
+            CHECK(app.execute("expr set a 1;expr set b 2"));
+            CHECK(app.store_.compact());
+        }
+        for (const off_t at : { off_t(40), off_t(64) }) {
+            // the set count, then the name offset of the first slot
+            const int fd = open(path.c_str(), O_RDWR);
+            CHECK(fd >= 0);
+            uint32_t word = 0;
+            CHECK(pread(fd, &word, sizeof(word), at) == ssize_t(sizeof(word)));
+            word += 1000;
+            CHECK(pwrite(fd, &word, sizeof(word), at) == ssize_t(sizeof(word)));
+            app_t app;
+            app.parser_.idents_.set("kept", 1);
+            CHECK(!app.store_.open(path.c_str()));
+            CHECK(app.value("kept") == 1 && app.value("a") == ~0ull);
+            word -= 1000;
+            CHECK(pwrite(fd, &word, sizeof(word), at) == ssize_t(sizeof(word)));
+            close(fd);
+            CHECK(app.store_.open(path.c_str()));
+            CHECK(app.value("a") == 1 && app.value("b") == 2);
+        }
+        unlink(path.c_str());
+
+        // changes are kept for the next sync when a write fails
+        {
+            app_t app;
+            CHECK(app.store_.open(path.c_str()));
+            CHECK(app.execute("expr set a 1;alias add e expr eval"));
+            const uint64_t size = file_size(path);
+            // writes past the file size limit fail with EFBIG
+            struct rlimit limit;
+            CHECK(getrlimit(RLIMIT_FSIZE, &limit) == 0);
+            const struct rlimit full = limit;
+            const auto handler = signal(SIGXFSZ, SIG_IGN);
+            limit.rlim_cur = rlim_t(size);
+            CHECK(setrlimit(RLIMIT_FSIZE, &limit) == 0);
+            CHECK(!app.execute("expr set b 2;expr remove a;alias remove e"));
+            CHECK(file_size(path) == size);
+            CHECK(setrlimit(RLIMIT_FSIZE, &full) == 0);
+            signal(SIGXFSZ, handler);
+            CHECK(app.store_.sync());
+        }
+        {
+            app_t app;
+            CHECK(app.store_.open(path.c_str()));
+            CHECK(app.value("a") == ~0ull && app.value("b") == 2);
+            CHECK(app.parser_.alias_.count("e") == 0);
+            CHECK(app.parser_.last_cmd() == "alias remove e");
+        }
+        unlink(path.c_str());
+
+        // other files are not taken for a store
+        {
+            const int fd = open(path.c_str(), O_WRONLY | O_CREAT, 0644);
+            CHECK(fd >= 0);
+            CHECK(write(fd, "not a store at all, just some text\n", 35) == 35);
+            close(fd);
+            app_t app;
+            CHECK(!app.store_.open(path.c_str()));
+            CHECK(!app.store_.is_open() && !app.store_.sync());
+        }
+        unlink(path.c_str());
+        return true;
+    }
+};
+} // namespace {}
+
+test_base_t* init_test_store()
+{
+    return new test_t();
+}
+
+#endif // defined(__linux__)
@@ -0,0 +1,67 @@
+#include "runner.h"
+
+namespace {
+
+struct test_t : public test_base_t {
+
+    test_t()
+        : test_base_t(__FILE__)
+    {
+    }
+
+    virtual bool run() override
+    {
+        cmd_idents_t idents;
+        idents["x"] = 1234;
+
+        cmd_tokens_t tok(&idents);
+        CHECK(tok.tokenize("  alpha -f -k value\tbeta $x $y  ") == 4);
+
+        // raw tokens include flags and pairs
+        CHECK(tok.tokens.raw_.size() == 7);
+
+        // tokens are views into the line buffer, except substitutions
+        CHECK(tok.tokens.front() == "alpha");
+        CHECK(!tok.tokens.front().owned());
+        CHECK(tok.tokens.back() == "$y");
+        CHECK(tok.tokens.tokens_[2] == "1234");
+        CHECK(tok.tokens.tokens_[2].owned());
+
+        // flags and pairs
+        CHECK(tok.flags.get("-f"));
+        CHECK(!tok.flags.get("-k"));
+        cmd_token_t value;
+        CHECK(tok.pairs.get("-k", value));
+        CHECK(value == "value");
+        CHECK(strcmp(value.c_str(), "value") == 0);
+
+        // get() still serves code written for a const std::string&
+        const std::string copy = value.get();
+        const std::string& bound = value.get();
+        CHECK(copy == "value" && bound == "value");
+        CHECK(strcmp(value.get().c_str(), "value") == 0);
+        CHECK(value.view() == "value" && value.get().size() == 5);
+
+        // integer conversion of a view token
+        uint64_t num = 0;
+        CHECK(tok.tokens.tokens_[2].get(num) && num == 1234);
+
+        // pop through the list
+        std::string str;
+        CHECK(tok.tokens.pop());
+        CHECK(tok.tokens.get(str) && str == "beta");
+
+        // retokenizing resets all state
+        CHECK(tok.tokenize("gamma -z") == 1);
+        CHECK(tok.tokens.front() == "gamma");
+        CHECK(tok.flags.get("-z"));
+        CHECK(tok.pairs.empty());
+        return true;
+    }
+};
+} // namespace {}
+
+test_base_t* init_test_tokens()
+{
+    return new test_t();
+}